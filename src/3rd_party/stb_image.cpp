@@ -1,2 +1,7 @@
+#include "../image_decode.h"
+
+#define STBI_MALLOC(size) imageDecodeMalloc(size)
+#define STBI_REALLOC_SIZED(memory, oldSize, newSize) imageDecodeRealloc(memory, oldSize, newSize)
+#define STBI_FREE(memory) imageDecodeFree(memory)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -0,0 +1,62 @@
+#include "asset_pack.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+bool AssetPack::open(const std::string &path) {
+    m_entries = nullptr;
+    m_entryCount = 0;
+    if (!m_file.open(path)) {
+        return false;
+    }
+    if (!parse(m_file.data(), m_file.size())) {
+        std::cout << "Asset pack " << path << " is malformed." << std::endl;
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool AssetPack::parse(const uint8_t *data, size_t size) {
+    if (size < sizeof(AssetPackHeader)) {
+        return false;
+    }
+    AssetPackHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != ASSET_PACK_MAGIC || header.version != ASSET_PACK_VERSION ||
+        header.entryCount > (size - sizeof(header)) / sizeof(AssetPackEntry)) {
+        return false;
+    }
+
+    //Check every entry once here, so find() can hand out pointers without further checks
+    auto entries = reinterpret_cast<const AssetPackEntry *>(data + sizeof(header));
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const AssetPackEntry & entry = entries[i];
+        bool terminated = memchr(entry.path, '\0', ASSET_PACK_MAX_PATH) != nullptr;
+        bool sorted = i == 0 || (terminated && strcmp(entries[i - 1].path, entry.path) < 0);
+        if (!terminated || !sorted || entry.offset % ASSET_PACK_ALIGNMENT != 0 || entry.offset > size || entry.size > size - entry.offset) {
+            return false;
+        }
+    }
+    m_entries = entries;
+    m_entryCount = header.entryCount;
+    return true;
+}
+
+AssetBlob AssetPack::find(const std::string &path, AssetType type) const {
+    if (!isOpen()) {
+        return {};
+    }
+    const AssetPackEntry * end = m_entries + m_entryCount;
+    auto it = std::lower_bound(m_entries, end, path, [](const AssetPackEntry & entry, const std::string & key) {
+        return strcmp(entry.path, key.c_str()) < 0;
+    });
+    if (it == end || path != it->path || it->type != type) {
+        return {};
+    }
+    AssetBlob blob;
+    blob.data = m_file.data() + it->offset;
+    blob.size = static_cast<size_t>(it->size);
+    return blob;
+}
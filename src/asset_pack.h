@@ -0,0 +1,74 @@
+#ifndef VKENG_ASSET_PACK_H
+#define VKENG_ASSET_PACK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "mapped_file.h"
+
+/*
+ * Assets cooked into one file by tools/cook_assets.cpp at build time, so loading one is finding it in the mapped
+ * file and copying its payload into staging memory as it is, with nothing parsed. Layout:
+ *   AssetPackHeader
+ *   AssetPackEntry[entryCount], sorted by path
+ *   the payloads, each at an ASSET_PACK_ALIGNMENT aligned offset from the start of the file
+ * Entries are named by the path the engine would otherwise load the asset from, e.g. "data/assets/monkey_smooth.obj",
+ * so every asset can still be loaded from its source when the pack doesn't have it.
+ */
+constexpr uint32_t ASSET_PACK_MAGIC = 0x4b415041; //"APAK"
+constexpr uint32_t ASSET_PACK_VERSION = 2;
+constexpr size_t ASSET_PACK_MAX_PATH = 40;
+constexpr uint64_t ASSET_PACK_ALIGNMENT = 16;
+
+enum class AssetType : uint32_t {
+    Mesh = 1, //a mesh cache, see mesh_cache.h
+    Texture = 2, //a KTX2 file, see ktx_texture.h
+    ShaderArchive = 3, //a shader archive, see shader_archive.h
+};
+
+struct AssetPackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct AssetPackEntry {
+    char path[ASSET_PACK_MAX_PATH]; //null terminated
+    AssetType type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size; //in bytes
+};
+
+static_assert(sizeof(AssetPackHeader) == 16 && sizeof(AssetPackEntry) == 64, "The pack layout is fixed");
+
+//An asset's payload. Points into the pack's memory, so it's only valid while the pack is open.
+struct AssetBlob {
+    const uint8_t * data = nullptr;
+    size_t size = 0;
+
+    explicit operator bool() const { return data != nullptr; }
+};
+
+class AssetPack {
+public:
+    //Maps a pack file. Returns false if it's missing, or, printing why, if it's malformed.
+    bool open(const std::string & path);
+
+    //Binary search by path. Returns an empty blob if the pack doesn't have an asset of that type there.
+    AssetBlob find(const std::string & path, AssetType type) const;
+
+    bool isOpen() const { return m_entries != nullptr; }
+    uint32_t getAssetCount() const { return m_entryCount; }
+    size_t getSize() const { return m_file.size(); }
+
+private:
+    MappedFile m_file;
+    const AssetPackEntry * m_entries = nullptr;
+    uint32_t m_entryCount = 0;
+
+    bool parse(const uint8_t * data, size_t size);
+};
+
+#endif //VKENG_ASSET_PACK_H
@@ -82,6 +82,14 @@ public:
         m_position += direction;
     }
 
+    //Places the camera at an exact pose, e.g. from a scripted camera path
+    void setPose(glm::vec3 position, float yaw, float pitch) {
+        m_position = position;
+        m_yaw = yaw;
+        m_pitch = pitch;
+        updateCameraVectors();
+    }
+
     void processMouseMovement(float xoffset, float yoffset) {
         xoffset *= m_sensitivity;
         yoffset *= m_sensitivity;
@@ -0,0 +1,192 @@
+#include "cpu_profiler.h"
+
+#ifdef VKENG_ENABLE_PROFILER
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define VKENG_PROFILER_USE_TSC
+#endif
+
+std::atomic<bool> CpuProfiler::s_capturing{false};
+
+namespace {
+    constexpr uint64_t RING_CAPACITY = 1 << 16; //zones per thread between two collect() calls, must be a power of two
+    constexpr size_t MAX_COLLECTED_EVENTS = 1 << 22; //upper bound on the size of a capture
+
+    struct ZoneEvent {
+        const char * name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    //Single-producer single-consumer ring. Only the owning thread writes head, only the collecting thread writes tail.
+    struct ThreadBuffer {
+        ZoneEvent events[RING_CAPACITY];
+        std::atomic<uint64_t> head{0};
+        std::atomic<uint64_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        uint32_t threadId = 0;
+        std::string name; //guarded by the registry mutex
+    };
+
+    struct CollectedEvent {
+        const char * name;
+        uint64_t start;
+        uint64_t end;
+        uint32_t threadId;
+    };
+
+    //The mutex is only taken when a thread records its first zone and when collecting, never per zone
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers; //never freed, so zones of exited threads can still be collected
+        std::vector<CollectedEvent> collected;
+        uint64_t droppedEvents = 0;
+        uint64_t epochTicks = 0;
+        std::chrono::steady_clock::time_point epochTime;
+    };
+
+    Registry & registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    thread_local ThreadBuffer * t_buffer = nullptr;
+
+    ThreadBuffer * threadBuffer() {
+        if (t_buffer == nullptr) {
+            auto & reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.buffers.push_back(std::make_unique<ThreadBuffer>());
+            t_buffer = reg.buffers.back().get();
+            t_buffer->threadId = static_cast<uint32_t>(reg.buffers.size());
+            t_buffer->name = "thread " + std::to_string(t_buffer->threadId);
+        }
+        return t_buffer;
+    }
+
+    //Moves everything out of the ring buffers. Caller must hold the registry mutex.
+    void drainBuffers(Registry & reg, bool keep) {
+        for (auto & buffer : reg.buffers) {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+            for (; tail != head; tail++) {
+                const auto & e = buffer->events[tail & (RING_CAPACITY - 1)];
+                if (keep && reg.collected.size() < MAX_COLLECTED_EVENTS) {
+                    reg.collected.push_back({e.name, e.start, e.end, buffer->threadId});
+                }
+            }
+            buffer->tail.store(tail, std::memory_order_release);
+            reg.droppedEvents += buffer->dropped.exchange(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t CpuProfiler::now() {
+#ifdef VKENG_PROFILER_USE_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+void CpuProfiler::startCapture() {
+    auto & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    drainBuffers(reg, false);
+    reg.collected.clear();
+    reg.droppedEvents = 0;
+    reg.epochTicks = now();
+    reg.epochTime = std::chrono::steady_clock::now();
+    s_capturing.store(true, std::memory_order_relaxed);
+}
+
+void CpuProfiler::stopCapture() {
+    s_capturing.store(false, std::memory_order_relaxed);
+    collect();
+}
+
+void CpuProfiler::record(const char *name, uint64_t start, uint64_t end) {
+    ThreadBuffer * buffer = threadBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    uint64_t tail = buffer->tail.load(std::memory_order_acquire);
+    if (head - tail >= RING_CAPACITY) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[head & (RING_CAPACITY - 1)] = {name, start, end};
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const char *name) {
+    ThreadBuffer * buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer->name = name;
+}
+
+void CpuProfiler::collect() {
+    auto & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    drainBuffers(reg, true);
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string &filename) {
+    collect();
+
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    auto & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    //Work out how many ticks make a microsecond by comparing against the clock the capture started with
+    double ticksPerUs = 1000.0;
+#ifdef VKENG_PROFILER_USE_TSC
+    double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reg.epochTime).count();
+    if (elapsedUs > 0.0) {
+        ticksPerUs = static_cast<double>(now() - reg.epochTicks) / elapsedUs;
+    }
+#endif
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    bool first = true;
+    for (const auto & buffer : reg.buffers) {
+        file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << buffer->threadId
+             << ", \"args\": {\"name\": \"" << buffer->name << "\"}}";
+        first = false;
+    }
+    for (const auto & e : reg.collected) {
+        //Zones that started before the capture did would get negative timestamps, skip them
+        if (e.start < reg.epochTicks) {
+            continue;
+        }
+        double ts = static_cast<double>(e.start - reg.epochTicks) / ticksPerUs;
+        double dur = static_cast<double>(e.end - e.start) / ticksPerUs;
+        file << (first ? "" : ",\n") << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << e.threadId
+             << ", \"ts\": " << ts << ", \"dur\": " << dur << "}";
+        first = false;
+    }
+    file << std::endl << "]}" << std::endl;
+
+    std::cout << "Wrote " << reg.collected.size() << " CPU zones to " << filename;
+    if (reg.droppedEvents > 0) {
+        std::cout << " (" << reg.droppedEvents << " dropped, collect more often)";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+#endif //VKENG_ENABLE_PROFILER
@@ -0,0 +1,78 @@
+/*
+ * Low-overhead CPU zone profiler. Zones are recorded into per-thread lock-free ring buffers and can be exported to
+ * the Chrome/Perfetto trace JSON format (load it in chrome://tracing or ui.perfetto.dev).
+ *
+ * Everything compiles out unless VKENG_ENABLE_PROFILER is defined (CMake option of the same name), so use the macros
+ * rather than the classes directly:
+ *   PROFILE_FUNCTION();            - time the enclosing function
+ *   PROFILE_ZONE("name");          - time the enclosing scope; the name must be a string literal
+ *   PROFILE_THREAD_NAME("name");   - name the calling thread in the trace
+ *   PROFILE_COLLECT();             - drain the ring buffers, call once per frame from one thread
+ */
+
+#ifndef VKENG_CPU_PROFILER_H
+#define VKENG_CPU_PROFILER_H
+
+#ifdef VKENG_ENABLE_PROFILER
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+class CpuProfiler {
+public:
+    //Current timestamp in profiler ticks (TSC on x86, steady_clock nanoseconds elsewhere)
+    static uint64_t now();
+
+    //Zones are only recorded while capturing. Starting a capture discards anything collected before.
+    static void startCapture();
+    static void stopCapture();
+    static bool isCapturing() { return s_capturing.load(std::memory_order_relaxed); }
+
+    static void record(const char * name, uint64_t start, uint64_t end);
+    static void setThreadName(const char * name);
+
+    //Moves recorded zones from the per-thread ring buffers into the capture. Call regularly, e.g. once per frame.
+    static void collect();
+
+    static bool writeChromeTrace(const std::string & filename);
+
+private:
+    static std::atomic<bool> s_capturing;
+};
+
+class CpuProfileScope {
+public:
+    explicit CpuProfileScope(const char * name) : m_name(name), m_start(CpuProfiler::isCapturing() ? CpuProfiler::now() : 0) {}
+
+    ~CpuProfileScope() {
+        if (m_start != 0) {
+            CpuProfiler::record(m_name, m_start, CpuProfiler::now());
+        }
+    }
+
+    CpuProfileScope(const CpuProfileScope &) = delete;
+    CpuProfileScope & operator=(const CpuProfileScope &) = delete;
+
+private:
+    const char * m_name;
+    uint64_t m_start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) CpuProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_THREAD_NAME(name) CpuProfiler::setThreadName(name)
+#define PROFILE_COLLECT() CpuProfiler::collect()
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_COLLECT() ((void)0)
+
+#endif //VKENG_ENABLE_PROFILER
+
+#endif //VKENG_CPU_PROFILER_H
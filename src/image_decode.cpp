@@ -0,0 +1,60 @@
+#include "image_decode.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stb_image.h>
+
+namespace {
+    struct DecodeTarget {
+        unsigned char * memory = nullptr;
+        size_t size = 0;
+        bool handedOut = false;
+    };
+
+    //Every worker decodes its own image, so the target is per thread
+    thread_local DecodeTarget t_target;
+}
+
+void * imageDecodeMalloc(size_t size) {
+    if (t_target.memory && !t_target.handedOut && size == t_target.size) {
+        t_target.handedOut = true;
+        return t_target.memory;
+    }
+    return malloc(size);
+}
+
+void * imageDecodeRealloc(void * memory, size_t oldSize, size_t newSize) {
+    //The target can't grow, so whatever was in it moves to the heap
+    if (memory && memory == t_target.memory) {
+        void * moved = malloc(newSize);
+        if (moved) {
+            memcpy(moved, memory, std::min(oldSize, newSize));
+        }
+        return moved;
+    }
+    return realloc(memory, newSize);
+}
+
+void imageDecodeFree(void * memory) {
+    if (memory && memory == t_target.memory) {
+        return;
+    }
+    free(memory);
+}
+
+bool decodeImageInto(const std::string &filename, uint32_t width, uint32_t height, unsigned char * destination) {
+    t_target = {destination, static_cast<size_t>(width) * height * 4, false};
+    int decodedWidth, decodedHeight, channels;
+    unsigned char * pixels = stbi_load(filename.c_str(), &decodedWidth, &decodedHeight, &channels, STBI_rgb_alpha);
+    t_target = {};
+
+    bool fits = pixels && static_cast<uint32_t>(decodedWidth) == width && static_cast<uint32_t>(decodedHeight) == height;
+    if (pixels && pixels != destination) {
+        if (fits) {
+            memcpy(destination, pixels, static_cast<size_t>(width) * height * 4);
+        }
+        stbi_image_free(pixels);
+    }
+    return fits;
+}
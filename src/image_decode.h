@@ -0,0 +1,24 @@
+#ifndef VKENG_IMAGE_DECODE_H
+#define VKENG_IMAGE_DECODE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/*
+ * Decoding images straight into memory the caller already owns, usually mapped staging memory. stb_image can't be
+ * told where to put its output, so its allocations go through the hooks below: while a decode is running on a thread,
+ * the first allocation exactly as big as the RGBA8 image is handed the caller's memory instead of the heap. PNGs that
+ * are RGB or RGBA write their output there directly. Any other image falls back to one copy at the end.
+ */
+
+//Decodes an image as RGBA8 into destination, which must hold width * height * 4 bytes. Returns false if the image
+//can't be read or isn't exactly width x height.
+bool decodeImageInto(const std::string & filename, uint32_t width, uint32_t height, unsigned char * destination);
+
+//Allocation hooks for stb_image, see src/3rd_party/stb_image.cpp
+void * imageDecodeMalloc(size_t size);
+void * imageDecodeRealloc(void * memory, size_t oldSize, size_t newSize);
+void imageDecodeFree(void * memory);
+
+#endif //VKENG_IMAGE_DECODE_H
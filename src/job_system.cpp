@@ -0,0 +1,99 @@
+#include "job_system.h"
+#include "cpu_profiler.h"
+
+#include <atomic>
+#include <algorithm>
+#include <string>
+
+void JobSystem::init(uint32_t threadCount) {
+    if (threadCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    m_stopping = false;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeWorker.notify_all();
+    for (auto & worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void JobSystem::push(std::function<void()> &&job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(job));
+    }
+    m_wakeWorker.notify_one();
+}
+
+void JobSystem::parallelFor(size_t count, const std::function<void(size_t)> &job) {
+    if (count == 0) {
+        return;
+    }
+    //Indices are handed out one at a time, so uneven jobs still balance. The calling thread helps instead of waiting.
+    struct Shared {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto shared = std::make_shared<Shared>();
+    auto runJobs = [shared, count, &job]() {
+        size_t completed = 0;
+        for (size_t i = shared->next++; i < count; i = shared->next++) {
+            job(i);
+            completed++;
+        }
+        if (completed > 0 && shared->done.fetch_add(completed) + completed == count) {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->finished.notify_all();
+        }
+    };
+
+    size_t helpers = std::min<size_t>(m_workers.size(), count - 1);
+    for (size_t i = 0; i < helpers; i++) {
+        push(runJobs);
+    }
+    runJobs();
+
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->finished.wait(lock, [&]() { return shared->done.load() == count; });
+}
+
+void JobSystem::waitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&]() { return m_queue.empty() && m_runningJobs == 0; });
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    PROFILE_THREAD_NAME(("worker " + std::to_string(index)).c_str());
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wakeWorker.wait(lock, [&]() { return m_stopping || !m_queue.empty(); });
+        if (m_queue.empty()) {
+            return;
+        }
+        auto job = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_runningJobs++;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        m_runningJobs--;
+        if (m_queue.empty() && m_runningJobs == 0) {
+            m_idle.notify_all();
+        }
+    }
+}
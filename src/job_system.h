@@ -0,0 +1,56 @@
+#ifndef VKENG_JOB_SYSTEM_H
+#define VKENG_JOB_SYSTEM_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/*
+ * Fixed-size pool of worker threads running jobs from a shared FIFO queue. Used for work that can happen off the
+ * main thread and doesn't touch the command buffers being recorded, like pipeline compilation and asset decoding.
+ */
+class JobSystem {
+public:
+    //0 threads = one per hardware thread, minus one for the main thread
+    void init(uint32_t threadCount = 0);
+    //Finishes the queued jobs and joins the workers
+    void shutdown();
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    //Queues a job. The future holds its result, or the exception it threw.
+    template<typename F>
+    auto submit(F && job) -> std::future<decltype(job())> {
+        using Result = decltype(job());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        std::future<Result> future = task->get_future();
+        push([task]() { (*task)(); });
+        return future;
+    }
+
+    //Runs job(i) for every i in [0, count) on the workers and the calling thread, and returns when all are done
+    void parallelFor(size_t count, const std::function<void(size_t)> & job);
+
+    //Blocks until the queue is empty and no job is running
+    void waitIdle();
+
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeWorker;
+    std::condition_variable m_idle;
+    uint32_t m_runningJobs = 0;
+    bool m_stopping = false;
+
+    void push(std::function<void()> && job);
+    void workerLoop(uint32_t index);
+};
+
+#endif //VKENG_JOB_SYSTEM_H
@@ -0,0 +1,98 @@
+#include "ktx_texture.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+uint32_t getBlockSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t getBlockCompressedLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t level) {
+    //Levels smaller than a block still take up a whole one
+    size_t blocksX = (std::max(width >> level, 1u) + 3) / 4;
+    size_t blocksY = (std::max(height >> level, 1u) + 3) / 4;
+    return blocksX * blocksY * getBlockSize(format) * layers;
+}
+
+bool KtxTexture::open(const std::string &path) {
+    m_levels.clear();
+    if (!m_file.open(path)) {
+        return false;
+    }
+    if (!parse(m_file.data(), m_file.size())) {
+        std::cout << "Texture " << path << " isn't a KTX2 file with uncompressed BC data." << std::endl;
+        m_file.close();
+        m_levels.clear();
+        return false;
+    }
+    m_data = m_file.data();
+    return true;
+}
+
+bool KtxTexture::openMemory(const void *data, size_t size) {
+    m_file.close();
+    m_levels.clear();
+    if (!parse(static_cast<const uint8_t *>(data), size)) {
+        std::cout << "Texture in memory isn't a KTX2 file with uncompressed BC data." << std::endl;
+        m_levels.clear();
+        return false;
+    }
+    m_data = static_cast<const uint8_t *>(data);
+    return true;
+}
+
+bool KtxTexture::parse(const uint8_t *data, size_t size) {
+    if (size < sizeof(Ktx2Header) + sizeof(Ktx2Index)) {
+        return false;
+    }
+    Ktx2Header header;
+    memcpy(&header, data, sizeof(header));
+    //Cube maps, 3D textures and textures that want their mips generated aren't used here
+    if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 || getBlockSize(header.vkFormat) == 0 ||
+        header.supercompressionScheme != 0 || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 ||
+        header.faceCount != 1 || header.levelCount == 0 || header.levelCount > 32) {
+        return false;
+    }
+    m_format = header.vkFormat;
+    m_width = header.pixelWidth;
+    m_height = header.pixelHeight;
+    m_layerCount = std::max(header.layerCount, 1u);
+
+    size_t levelIndexOffset = sizeof(Ktx2Header) + sizeof(Ktx2Index);
+    if (size - levelIndexOffset < header.levelCount * sizeof(Ktx2LevelIndex)) {
+        return false;
+    }
+    m_levels.resize(header.levelCount);
+    memcpy(m_levels.data(), data + levelIndexOffset, header.levelCount * sizeof(Ktx2LevelIndex));
+    //Every level has to be in the file and exactly as big as its blocks, so it can be copied to an image without checks
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        const Ktx2LevelIndex & level = m_levels[i];
+        if (level.byteOffset > size || level.byteLength > size - level.byteOffset ||
+            level.byteLength != getBlockCompressedLevelSize(m_format, m_width, m_height, m_layerCount, i)) {
+            return false;
+        }
+    }
+    return true;
+}
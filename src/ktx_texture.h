@@ -0,0 +1,85 @@
+#ifndef VKENG_KTX_TEXTURE_H
+#define VKENG_KTX_TEXTURE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+#include "mapped_file.h"
+
+/*
+ * KTX2 textures holding block compressed (BC1-BC7) data, as written by tools/compress_textures.cpp. Layout:
+ *   the identifier, Ktx2Header and Ktx2Index
+ *   Ktx2LevelIndex[levelCount], largest level first
+ *   the data format descriptor and key/value data, which aren't needed here
+ *   the level data, every level holding all array layers one after another
+ * Only files without supercompression are handled, so the levels can be copied to the GPU as they are.
+ */
+constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+struct Ktx2Header {
+    uint8_t identifier[12];
+    VkFormat vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount; //0 for textures that aren't arrays
+    uint32_t faceCount;
+    uint32_t levelCount; //0 asks the loader to generate mips, which isn't supported
+    uint32_t supercompressionScheme;
+};
+
+struct Ktx2Index {
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 48 && sizeof(Ktx2Index) == 32 && sizeof(Ktx2LevelIndex) == 24, "The KTX2 layout is fixed");
+
+//Bytes per 4x4 block of a BC format, or 0 if the format isn't block compressed
+uint32_t getBlockSize(VkFormat format);
+
+//Bytes of one level of a BC texture with all its array layers
+size_t getBlockCompressedLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t level);
+
+class KtxTexture {
+public:
+    //Maps a KTX2 file. Returns false if it's missing, or, printing why, if it's malformed or not block compressed.
+    bool open(const std::string & path);
+    //Uses a KTX2 file that's already in memory, like one in the asset pack. The memory has to outlive this.
+    bool openMemory(const void * data, size_t size);
+
+    VkFormat getFormat() const { return m_format; }
+    uint32_t getWidth() const { return m_width; }
+    uint32_t getHeight() const { return m_height; }
+    uint32_t getLayerCount() const { return m_layerCount; }
+    uint32_t getLevelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+    //Points into the file's memory, so it's only valid while this is open
+    const uint8_t * getLevelData(uint32_t level) const { return m_data + m_levels[level].byteOffset; }
+    size_t getLevelSize(uint32_t level) const { return static_cast<size_t>(m_levels[level].byteLength); }
+
+private:
+    MappedFile m_file;
+    const uint8_t * m_data = nullptr;
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_layerCount = 0;
+    std::vector<Ktx2LevelIndex> m_levels;
+
+    bool parse(const uint8_t * data, size_t size);
+};
+
+#endif //VKENG_KTX_TEXTURE_H
@@ -0,0 +1,108 @@
+#include "light_clusters.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+void LightClusterBuilder::build(const std::vector<PointLightData> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                                float nearPlane, float farPlane, uint32_t width, uint32_t height) {
+    width = std::max(width, 1u);
+    height = std::max(height, 1u);
+    float tileWidth = std::ceil(static_cast<float>(width) / CLUSTER_GRID_X);
+    float tileHeight = std::ceil(static_cast<float>(height) / CLUSTER_GRID_Y);
+    //slice = log(depth) * scale + bias, so slice 0 starts at the near plane and the last one ends at the far plane
+    float sliceScale = CLUSTER_GRID_Z / std::log(farPlane / nearPlane);
+    float sliceBias = -std::log(nearPlane) * sliceScale;
+    m_grid.size = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, static_cast<uint32_t>(lights.size()));
+    m_grid.params = glm::vec4(tileWidth, tileHeight, sliceScale, sliceBias);
+
+    auto getSlice = [&](float depth) {
+        float slice = std::floor(std::log(depth) * sliceScale + sliceBias);
+        return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(CLUSTER_GRID_Z - 1)));
+    };
+    auto getSliceStart = [&](uint32_t slice) {
+        return nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / CLUSTER_GRID_Z);
+    };
+    //From view space x or y over depth to pixels. The projection's y scale is negative, so y points down like in the framebuffer.
+    float pixelScaleX = projection[0][0] * 0.5f * static_cast<float>(width);
+    float pixelScaleY = projection[1][1] * 0.5f * static_cast<float>(height);
+    //The range of tiles the pixel range [min, max] covers, or false if it's off screen
+    auto getTiles = [](float min, float max, float tileSize, uint32_t tileCount, uint32_t & first, uint32_t & last) {
+        float firstTile = std::floor(min / tileSize);
+        float lastTile = std::floor(max / tileSize);
+        if (lastTile < 0.0f || firstTile >= static_cast<float>(tileCount)) {
+            return false;
+        }
+        first = static_cast<uint32_t>(std::max(firstTile, 0.0f));
+        last = static_cast<uint32_t>(std::min(lastTile, static_cast<float>(tileCount - 1)));
+        return true;
+    };
+
+    //First find every light's clusters and count the lights per cluster...
+    m_spans.clear();
+    m_clusters.assign(CLUSTER_COUNT, {0, 0});
+    for (size_t i = 0; i < lights.size(); i++) {
+        glm::vec4 center = view * glm::vec4(glm::vec3(lights[i].worldPosition), 1.0f);
+        float radius = lights[i].worldPosition.w;
+        float depth = -center.z;
+        float minDepth = std::max(depth - radius, nearPlane);
+        float maxDepth = std::min(depth + radius, farPlane);
+        if (radius <= 0.0f || minDepth > maxDepth) {
+            continue;
+        }
+
+        uint32_t lastSlice = getSlice(maxDepth);
+        for (uint32_t slice = getSlice(minDepth); slice <= lastSlice; slice++) {
+            float sliceNear = std::max(minDepth, getSliceStart(slice));
+            float sliceFar = std::min(maxDepth, getSliceStart(slice + 1));
+            //The sphere is narrower in slices that don't contain its center, which keeps far-off tiles out
+            float closest = std::clamp(depth, sliceNear, sliceFar) - depth;
+            float sliceRadius = std::sqrt(std::max(radius * radius - closest * closest, 0.0f));
+
+            //Project the corners of the box around the sphere's part in this slice. x / depth is monotonic in
+            //depth, so the corners bound the whole box on screen.
+            float minPixel[2] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+            float maxPixel[2] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+            for (float cornerDepth : {sliceNear, sliceFar}) {
+                for (float side : {-sliceRadius, sliceRadius}) {
+                    float pixelX = (center.x + side) / cornerDepth * pixelScaleX + 0.5f * static_cast<float>(width);
+                    float pixelY = (center.y + side) / cornerDepth * pixelScaleY + 0.5f * static_cast<float>(height);
+                    minPixel[0] = std::min(minPixel[0], pixelX);
+                    maxPixel[0] = std::max(maxPixel[0], pixelX);
+                    minPixel[1] = std::min(minPixel[1], pixelY);
+                    maxPixel[1] = std::max(maxPixel[1], pixelY);
+                }
+            }
+            LightSpan span = {};
+            span.light = static_cast<uint32_t>(i);
+            span.slice = slice;
+            if (!getTiles(minPixel[0], maxPixel[0], tileWidth, CLUSTER_GRID_X, span.minX, span.maxX) ||
+                !getTiles(minPixel[1], maxPixel[1], tileHeight, CLUSTER_GRID_Y, span.minY, span.maxY)) {
+                continue;
+            }
+            for (uint32_t y = span.minY; y <= span.maxY; y++) {
+                for (uint32_t x = span.minX; x <= span.maxX; x++) {
+                    m_clusters[x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * slice)].count++;
+                }
+            }
+            m_spans.push_back(span);
+        }
+    }
+
+    //...then give each cluster its range of the index list and fill them in
+    uint32_t offset = 0;
+    for (auto & cluster : m_clusters) {
+        cluster.offset = offset;
+        offset += cluster.count;
+        cluster.count = 0;
+    }
+    m_lightIndices.resize(offset);
+    for (const auto & span : m_spans) {
+        for (uint32_t y = span.minY; y <= span.maxY; y++) {
+            for (uint32_t x = span.minX; x <= span.maxX; x++) {
+                LightCluster & cluster = m_clusters[x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * span.slice)];
+                m_lightIndices[cluster.offset + cluster.count++] = span.light;
+            }
+        }
+    }
+}
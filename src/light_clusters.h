@@ -0,0 +1,63 @@
+#ifndef VKENG_LIGHT_CLUSTERS_H
+#define VKENG_LIGHT_CLUSTERS_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/*
+ * Clustered forward shading: the view frustum is split into a grid of clusters ("froxels"), screen tiles that are
+ * each cut into depth slices getting exponentially thicker with distance. Every frame the point lights are binned
+ * into the clusters their sphere of influence touches, and a fragment only shades the lights of its own cluster,
+ * so the cost per fragment depends on how many lights are nearby rather than how many there are.
+ */
+constexpr uint32_t CLUSTER_GRID_X = 16;
+constexpr uint32_t CLUSTER_GRID_Y = 9;
+constexpr uint32_t CLUSTER_GRID_Z = 24;
+constexpr uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+struct PointLightData {
+    glm::vec4 worldPosition; //w is the radius, where the light fades out completely
+    glm::vec4 lightColor; //w is shininess
+};
+
+//Start of the cluster buffer, followed by CLUSTER_COUNT LightClusters. Matches ClusterBuffer in the shaders.
+struct GPUClusterGrid {
+    glm::uvec4 size; //clusters in x, y and z; w is the number of lights
+    glm::vec4 params; //tile width and height in pixels, then scale and bias turning log(view depth) into a slice
+};
+
+//A cluster's lights are lightIndices[offset] to lightIndices[offset + count - 1]
+struct LightCluster {
+    uint32_t offset;
+    uint32_t count;
+};
+
+class LightClusterBuilder {
+public:
+    //Bins the lights for a camera. The projection is a symmetric perspective one like glm::perspective makes, for a
+    //framebuffer of width x height.
+    void build(const std::vector<PointLightData> & lights, const glm::mat4 & view, const glm::mat4 & projection,
+               float nearPlane, float farPlane, uint32_t width, uint32_t height);
+
+    const GPUClusterGrid & getGrid() const { return m_grid; }
+    const std::vector<LightCluster> & getClusters() const { return m_clusters; }
+    const std::vector<uint32_t> & getLightIndices() const { return m_lightIndices; }
+
+private:
+    //The clusters one light touches in one depth slice
+    struct LightSpan {
+        uint32_t light;
+        uint32_t slice;
+        uint32_t minX, maxX;
+        uint32_t minY, maxY;
+    };
+
+    GPUClusterGrid m_grid = {};
+    std::vector<LightCluster> m_clusters;
+    std::vector<uint32_t> m_lightIndices;
+    std::vector<LightSpan> m_spans; //kept between frames to reuse the memory
+};
+
+#endif //VKENG_LIGHT_CLUSTERS_H
@@ -1,14 +1,150 @@
 #include <iostream>
+#include <cstring>
+#include <string>
 #include "vk_engine.h"
 
+static void printUsage(const char * exe) {
+    std::cout << "Usage: " << exe << " [options]" << std::endl
+              << "  --benchmark [path.txt]    replay a camera path (or the built-in flythrough) with a fixed timestep" << std::endl
+              << "  --benchmark-out <prefix>  write results to <prefix>.csv and <prefix>.json (default: benchmark)" << std::endl
+              << "  --timestep <seconds>      fixed simulation timestep in benchmark mode (default: 1/60)" << std::endl
+              << "  --warmup <frames>         frames excluded from the benchmark summary (default: 0)" << std::endl
+              << "  --record-path <file>      record the live camera into a path file for later replay" << std::endl
+              << "  --gpu-stats               collect GPU pipeline statistics per material batch" << std::endl
+              << "  --cpu-trace <file>        write a Chrome trace of CPU zones for the whole run" << std::endl
+              << "  --memory-stats <file>     write periodic memory usage snapshots to a JSON file" << std::endl
+              << "  --memory-interval <n>     frames between memory snapshots (default: 60)" << std::endl
+              << "  --pipeline-cache <file>   pipeline cache to load and save (default: pipeline_cache.bin)" << std::endl
+              << "  --no-pipeline-cache       always compile pipelines from scratch" << std::endl
+              << "  --no-hot-reload           don't watch the shaders for changes" << std::endl
+              << "  --render-pass             render with a render pass and framebuffers instead of dynamic rendering" << std::endl
+              << "  --lights <n>              point lights scattered over the terrain (default: 256)" << std::endl
+              << "  --no-mipmaps              load textures with a single mip level" << std::endl
+              << "  --anisotropy <n>          maximum anisotropic filtering of textures, 1 = off (default: 16)" << std::endl
+              << "  --no-compressed-textures  load textures from the PNGs instead of the BC compressed versions" << std::endl
+              << "  --no-texture-streaming    load every texture at full resolution up front" << std::endl
+              << "  --texture-budget <MiB>    memory streamed textures may use, 0 = no limit (default: 256)" << std::endl
+              << "  --no-transfer-queue       upload streamed texture levels on the graphics queue" << std::endl
+              << "  --no-mesh-optimization    draw meshes in the order they were loaded or generated in" << std::endl
+              << "  --no-mesh-cache           parse mesh sources on every start instead of using .meshcache files" << std::endl
+              << "  --asset-pack <file>       load cooked assets from <file> (default: assets.pak)" << std::endl
+              << "  --no-asset-pack           load every asset from its source file" << std::endl
+              << "  --capture <dir>           write rendered frames to <dir> as PNGs" << std::endl
+              << "  --capture-interval <n>    capture every n-th frame (default: 1)" << std::endl
+              << "  --capture-reference <dir> compare captured frames against reference PNGs, exits with 1 on mismatch" << std::endl
+              << "  --capture-tolerance <n>   per-channel difference allowed by the comparison (default: 2)" << std::endl;
+}
+
 int main(int argc, char ** argv) {
+    BenchmarkSettings benchmarkSettings;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--benchmark") == 0) {
+            benchmarkSettings.enabled = true;
+            //The path file is optional
+            if (hasValue && strncmp(argv[i + 1], "--", 2) != 0) {
+                benchmarkSettings.cameraPathFile = argv[++i];
+            }
+        }
+        else if (strcmp(argv[i], "--benchmark-out") == 0 && hasValue) {
+            benchmarkSettings.outputPrefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--timestep") == 0 && hasValue) {
+            benchmarkSettings.fixedTimestep = std::stof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            benchmarkSettings.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--record-path") == 0 && hasValue) {
+            benchmarkSettings.recordPathFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gpu-stats") == 0) {
+            benchmarkSettings.gpuPipelineStatistics = true;
+        }
+        else if (strcmp(argv[i], "--cpu-trace") == 0 && hasValue) {
+            benchmarkSettings.cpuTraceFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--memory-stats") == 0 && hasValue) {
+            benchmarkSettings.memoryStatsFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--memory-interval") == 0 && hasValue) {
+            benchmarkSettings.memoryStatsInterval = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--pipeline-cache") == 0 && hasValue) {
+            benchmarkSettings.pipelineCacheFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-pipeline-cache") == 0) {
+            benchmarkSettings.pipelineCacheFile.clear();
+        }
+        else if (strcmp(argv[i], "--no-hot-reload") == 0) {
+            benchmarkSettings.hotReloadShaders = false;
+        }
+        else if (strcmp(argv[i], "--render-pass") == 0) {
+            benchmarkSettings.dynamicRendering = false;
+        }
+        else if (strcmp(argv[i], "--lights") == 0 && hasValue) {
+            benchmarkSettings.pointLightCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--no-mipmaps") == 0) {
+            benchmarkSettings.mipmaps = false;
+        }
+        else if (strcmp(argv[i], "--anisotropy") == 0 && hasValue) {
+            benchmarkSettings.maxAnisotropy = std::stof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--no-compressed-textures") == 0) {
+            benchmarkSettings.compressedTextures = false;
+        }
+        else if (strcmp(argv[i], "--no-texture-streaming") == 0) {
+            benchmarkSettings.textureStreaming = false;
+        }
+        else if (strcmp(argv[i], "--texture-budget") == 0 && hasValue) {
+            benchmarkSettings.textureBudgetMiB = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--no-transfer-queue") == 0) {
+            benchmarkSettings.transferQueue = false;
+        }
+        else if (strcmp(argv[i], "--no-mesh-optimization") == 0) {
+            benchmarkSettings.optimizeMeshes = false;
+        }
+        else if (strcmp(argv[i], "--no-mesh-cache") == 0) {
+            benchmarkSettings.meshCache = false;
+        }
+        else if (strcmp(argv[i], "--asset-pack") == 0 && hasValue) {
+            benchmarkSettings.assetPackFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-asset-pack") == 0) {
+            benchmarkSettings.assetPackFile.clear();
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && hasValue) {
+            benchmarkSettings.captureDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--capture-interval") == 0 && hasValue) {
+            benchmarkSettings.captureInterval = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--capture-reference") == 0 && hasValue) {
+            benchmarkSettings.captureReferenceDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--capture-tolerance") == 0 && hasValue) {
+            benchmarkSettings.captureTolerance = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
     VulkanEngine engine;
 
+    engine.configureBenchmark(benchmarkSettings);
+
     engine.init();
 
     engine.run();
 
+    //Captures that didn't match their reference images fail the run, so this can be used as a regression test
+    uint32_t captureFailures = engine.getCaptureFailures();
+
     engine.cleanup();
 
-    return 0;
+    return captureFailures > 0 ? 1 : 0;
 }
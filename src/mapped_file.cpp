@@ -0,0 +1,104 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+#ifdef _WIN32
+        std::swap(m_mapping, other.m_mapping);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string &path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    //The mapping keeps the file open, so the file handle itself isn't needed afterwards
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+    void * data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_data = static_cast<const uint8_t *>(data);
+    m_size = static_cast<size_t>(size.QuadPart);
+    m_mapping = mapping;
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+}
+#else
+bool MappedFile::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    //The mapping keeps its own reference to the file, so the descriptor can go straight away
+    void * data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const uint8_t *>(data);
+    m_size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_data != nullptr) {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+#endif
@@ -0,0 +1,37 @@
+#ifndef VKENG_MAPPED_FILE_H
+#define VKENG_MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/*
+ * A whole file mapped read-only into memory. Pages are read in by the OS when first touched, so nothing is copied
+ * and a file that's already in the page cache costs no I/O at all. The data stays valid until close() or destruction.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile && other) noexcept;
+    MappedFile & operator=(MappedFile && other) noexcept;
+
+    //Returns false if the file doesn't exist, is empty or can't be mapped
+    bool open(const std::string & path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const uint8_t * data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t * m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void * m_mapping = nullptr; //HANDLE of the file mapping object
+#endif
+};
+
+#endif //VKENG_MAPPED_FILE_H
@@ -0,0 +1,141 @@
+#include "mesh_cache.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+
+namespace {
+
+uint64_t alignCacheOffset(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+//The current Vertex layout, as it's stored in a header
+void describeVertexLayout(MeshCacheHeader & header) {
+    VertexInputDescription description = Vertex::getVertexDescription();
+    header.vertexStride = sizeof(Vertex);
+    header.attributeCount = static_cast<uint32_t>(std::min<size_t>(description.attributes.size(), MESH_CACHE_MAX_ATTRIBUTES));
+    for (uint32_t i = 0; i < header.attributeCount; i++) {
+        const auto & attribute = description.attributes[i];
+        header.attributes[i].location = attribute.location;
+        header.attributes[i].format = static_cast<uint32_t>(attribute.format);
+        header.attributes[i].offset = attribute.offset;
+    }
+}
+
+}
+
+uint64_t hashMeshSource(const uint8_t *data, size_t size) {
+    //FNV-1a over 8 byte words, with the high bits folded back in after each multiply since they'd never reach the
+    //low ones otherwise
+    uint64_t h = 0xcbf29ce484222325ull ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ word) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for (; i < size; i++) {
+        h = (h ^ data[i]) * 0x100000001b3ull;
+    }
+    h ^= h >> 32;
+    return h;
+}
+
+std::string getMeshCachePath(const std::string &sourcePath) {
+    return sourcePath + ".meshcache";
+}
+
+std::vector<uint8_t> buildMeshCache(const Mesh &mesh, uint64_t sourceHash, uint32_t flags) {
+    MeshCacheHeader header = {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.flags = flags;
+    header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    header.indexSize = sizeof(uint16_t);
+    describeVertexLayout(header);
+
+    glm::vec3 boundsMin(0.0f);
+    glm::vec3 boundsMax(0.0f);
+    if (!mesh.vertices.empty()) {
+        boundsMin = boundsMax = mesh.vertices[0].position;
+    }
+    for (const auto & vertex : mesh.vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+        header.boundingRadius = std::max(header.boundingRadius, glm::length(vertex.position));
+    }
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+    }
+
+    size_t vertexBytes = mesh.vertices.size() * sizeof(Vertex);
+    size_t indexBytes = mesh.indices.size() * sizeof(uint16_t);
+    header.vertexOffset = alignCacheOffset(sizeof(header));
+    header.indexOffset = alignCacheOffset(header.vertexOffset + vertexBytes);
+    std::vector<uint8_t> data(static_cast<size_t>(header.indexOffset + indexBytes), 0);
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + header.vertexOffset, mesh.vertices.data(), vertexBytes);
+    memcpy(data.data() + header.indexOffset, mesh.indices.data(), indexBytes);
+    return data;
+}
+
+bool writeMeshCache(const std::string &path, const std::vector<uint8_t> &data) {
+    //Write to a temporary file first and rename it over the old cache, so a crash never leaves half a cache behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Failed to open " << tempPath << " for writing." << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            std::cout << "Failed to write mesh cache to " << tempPath << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cout << "Failed to replace " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool parseMeshCache(const uint8_t *data, size_t size, MeshCacheView &view) {
+    if (size < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+    MeshCacheHeader & header = view.header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.indexSize != sizeof(uint16_t)) {
+        return false;
+    }
+    //A cache written before Vertex changed would be misread, so it's rebuilt instead
+    MeshCacheHeader current = {};
+    describeVertexLayout(current);
+    if (header.vertexStride != current.vertexStride || header.attributeCount != current.attributeCount ||
+        memcmp(header.attributes, current.attributes, current.attributeCount * sizeof(MeshCacheAttribute)) != 0) {
+        return false;
+    }
+    uint64_t vertexBytes = static_cast<uint64_t>(header.vertexCount) * header.vertexStride;
+    uint64_t indexBytes = static_cast<uint64_t>(header.indexCount) * header.indexSize;
+    if (header.vertexOffset % MESH_CACHE_ALIGNMENT != 0 || header.indexOffset % MESH_CACHE_ALIGNMENT != 0 ||
+        header.vertexOffset < sizeof(header) || header.vertexOffset > size || vertexBytes > size - header.vertexOffset ||
+        header.indexOffset > size || indexBytes > size - header.indexOffset) {
+        return false;
+    }
+    view.vertices = data + header.vertexOffset;
+    view.indices = data + header.indexOffset;
+    return true;
+}
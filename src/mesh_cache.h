@@ -0,0 +1,81 @@
+#ifndef VKENG_MESH_CACHE_H
+#define VKENG_MESH_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "vk_mesh.h"
+
+/*
+ * Meshes as they're uploaded, so loading one is mapping the file and copying its blobs into staging memory. The
+ * engine writes one next to each mesh source the first time it loads it (see getMeshCachePath()), and
+ * tools/cook_assets.cpp stores them as the asset pack's mesh payloads. Layout:
+ *   MeshCacheHeader
+ *   the vertices, in the layout the header describes, at vertexOffset
+ *   the 16-bit indices at indexOffset
+ * Both offsets are MESH_CACHE_ALIGNMENT aligned. A cache is only used if its version, vertex layout, flags and, for
+ * caches next to their source, the hash of the source's contents all still match, and is rebuilt otherwise.
+ */
+constexpr uint32_t MESH_CACHE_MAGIC = 0x4853454d; //"MESH"
+//Bumped whenever the loaders or the optimizer change what they make of a source, so older caches get rebuilt
+constexpr uint32_t MESH_CACHE_VERSION = 1;
+constexpr uint64_t MESH_CACHE_ALIGNMENT = 16;
+constexpr uint32_t MESH_CACHE_MAX_ATTRIBUTES = 8;
+
+enum MeshCacheFlags : uint32_t {
+    MESH_CACHE_OPTIMIZED = 1, //went through Mesh::optimize()
+};
+
+struct MeshCacheAttribute {
+    uint32_t location;
+    uint32_t format; //VkFormat
+    uint32_t offset;
+    uint32_t reserved;
+};
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash; //hashMeshSource() of the file the mesh was loaded from
+    uint32_t flags; //MeshCacheFlags
+    uint32_t vertexCount;
+    uint32_t indexCount; //0 if the mesh isn't indexed
+    uint32_t indexSize; //in bytes
+    float boundsMin[3];
+    float boundingRadius; //distance of the farthest vertex from the origin
+    float boundsMax[3];
+    uint32_t vertexStride;
+    uint32_t attributeCount;
+    uint32_t reserved[3];
+    MeshCacheAttribute attributes[MESH_CACHE_MAX_ATTRIBUTES];
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+};
+
+static_assert(sizeof(MeshCacheAttribute) == 16 && sizeof(MeshCacheHeader) == 224, "The mesh cache layout is fixed");
+
+//A parsed cache. The blobs point into the memory it was parsed from.
+struct MeshCacheView {
+    MeshCacheHeader header;
+    const uint8_t * vertices = nullptr;
+    const uint8_t * indices = nullptr;
+};
+
+//Cheap content hash for telling whether a source changed. Not FNV-1a per byte like the pipeline cache's: sources can
+//be big, and this runs on every load.
+uint64_t hashMeshSource(const uint8_t * data, size_t size);
+
+//Where the cache of a mesh source goes: next to it, with .meshcache appended
+std::string getMeshCachePath(const std::string & sourcePath);
+
+//Serializes the mesh's vectors with the current Vertex layout
+std::vector<uint8_t> buildMeshCache(const Mesh & mesh, uint64_t sourceHash, uint32_t flags);
+
+//Writes through a temporary file renamed over the old cache. Returns false, printing why, if it can't.
+bool writeMeshCache(const std::string & path, const std::vector<uint8_t> & data);
+
+//Returns false if data isn't a cache of this version for the current Vertex layout, or its blobs don't fit in size
+bool parseMeshCache(const uint8_t * data, size_t size, MeshCacheView & view);
+
+#endif //VKENG_MESH_CACHE_H
@@ -0,0 +1,282 @@
+#include "mesh_optimizer.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+//The LRU cache Forsyth's scores model. Three more entries hold the vertices pushed out by the latest triangle.
+constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+constexpr uint32_t FORSYTH_MAX_VALENCE = 32;
+
+namespace {
+
+struct ForsythScores {
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE + 1];
+
+    ForsythScores() {
+        for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+            //The latest triangle's vertices get a fixed score, so its neighbours aren't favoured over each other
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+        valence[0] = 0.0f;
+        for (uint32_t i = 1; i <= FORSYTH_MAX_VALENCE; i++) {
+            //Vertices with few triangles left are finished off first, so they don't linger
+            valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+        }
+    }
+
+    float vertex(int32_t cachePosition, uint32_t remainingTriangles) const {
+        if (remainingTriangles == 0) {
+            return -1.0f;
+        }
+        float score = cachePosition >= 0 && cachePosition < static_cast<int32_t>(FORSYTH_CACHE_SIZE) ? cache[cachePosition] : 0.0f;
+        return score + valence[std::min(remainingTriangles, FORSYTH_MAX_VALENCE)];
+    }
+};
+
+}
+
+VertexCacheStats analyzeVertexCache(const uint16_t * indices, size_t indexCount, size_t vertexCount) {
+    VertexCacheStats stats;
+    if (indexCount == 0 || vertexCount == 0) {
+        return stats;
+    }
+    //A vertex is in the FIFO if fewer than its size vertices were added after it
+    std::vector<uint32_t> addedAt(vertexCount, 0);
+    uint32_t time = VERTEX_CACHE_STATS_SIZE + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (time - addedAt[indices[i]] > VERTEX_CACHE_STATS_SIZE) {
+            addedAt[indices[i]] = time++;
+            misses++;
+        }
+    }
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+void optimizeVertexCache(uint16_t * indices, size_t indexCount, size_t vertexCount) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+    static const ForsythScores scores;
+
+    //Triangles of each vertex, the ones not drawn yet at the front of its range
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        remaining[indices[i]]++;
+    }
+    std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    }
+    std::vector<uint32_t> vertexTriangles(indexCount);
+    {
+        std::vector<uint32_t> filled(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; i++) {
+            uint16_t v = indices[i];
+            vertexTriangles[firstTriangle[v] + filled[v]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = scores.vertex(-1, remaining[v]);
+    }
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+    std::vector<bool> drawn(triangleCount, false);
+    std::vector<uint16_t> output;
+    output.reserve(indexCount);
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t cacheSize = 0;
+    size_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    size_t nextUndrawn = 0;
+    for (size_t drawnCount = 0; drawnCount < triangleCount; drawnCount++) {
+        //Nothing in the cache has triangles left, so the next one starts over somewhere else
+        if (best == triangleCount) {
+            while (drawn[nextUndrawn]) {
+                nextUndrawn++;
+            }
+            best = nextUndrawn;
+        }
+        drawn[best] = true;
+        const uint16_t * triangle = &indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+
+        //Move the triangle's vertices to the front of the cache and take it off their lists
+        uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+        uint32_t newCacheSize = 0;
+        for (int i = 0; i < 3; i++) {
+            uint16_t v = triangle[i];
+            newCache[newCacheSize++] = v;
+            uint32_t * begin = &vertexTriangles[firstTriangle[v]];
+            uint32_t * end = begin + remaining[v];
+            *std::find(begin, end, static_cast<uint32_t>(best)) = *(end - 1);
+            remaining[v]--;
+        }
+        for (uint32_t i = 0; i < cacheSize; i++) {
+            uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                newCache[newCacheSize++] = v;
+            }
+        }
+        //Rescore everything that was or is in the cache, and their triangles, looking for the best one to draw next
+        for (uint32_t i = 0; i < newCacheSize; i++) {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+            float score = scores.vertex(cachePosition[v], remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                triangleScore[vertexTriangles[firstTriangle[v] + j]] += delta;
+            }
+        }
+        cacheSize = std::min(newCacheSize, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheSize, cache);
+
+        best = triangleCount;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < cacheSize; i++) {
+            uint32_t v = cache[i];
+            for (uint32_t j = 0; j < remaining[v]; j++) {
+                uint32_t t = vertexTriangles[firstTriangle[v] + j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint16_t * indices, size_t indexCount, const Vertex * vertices, size_t vertexCount, float threshold) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+    //FIFO simulation like analyzeVertexCache(), restartable at any triangle
+    std::vector<uint32_t> addedAt(vertexCount, 0);
+    uint32_t time = 0;
+    auto restartCache = [&]() {
+        time += VERTEX_CACHE_STATS_SIZE + 1;
+    };
+    auto triangleMisses = [&](size_t t) {
+        uint32_t misses = 0;
+        for (size_t i = t * 3; i < t * 3 + 3; i++) {
+            if (time - addedAt[indices[i]] > VERTEX_CACHE_STATS_SIZE) {
+                addedAt[indices[i]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+
+    //The cache order starts over, with every vertex a miss, wherever it ran out of neighbouring triangles. Those
+    //runs are hard cluster boundaries.
+    restartCache();
+    std::vector<size_t> hardBoundaries;
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (triangleMisses(t) == 3) {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    //Runs are split further wherever starting over with an empty cache keeps their ACMR within threshold
+    std::vector<size_t> clusters;
+    for (size_t i = 0; i + 1 < hardBoundaries.size(); i++) {
+        size_t start = hardBoundaries[i];
+        size_t end = hardBoundaries[i + 1];
+        restartCache();
+        uint32_t runMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            runMisses += triangleMisses(t);
+        }
+        float target = static_cast<float>(runMisses) / static_cast<float>(end - start) * threshold;
+
+        clusters.push_back(start);
+        restartCache();
+        uint32_t clusterMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            clusterMisses += triangleMisses(t);
+            size_t clusterSize = t - clusters.back() + 1;
+            if (t + 1 < end && static_cast<float>(clusterMisses) <= target * static_cast<float>(clusterSize)) {
+                clusters.push_back(t + 1);
+                restartCache();
+                clusterMisses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    //Clusters facing away from the middle of the mesh are in front of the others from where they can be seen
+    glm::vec3 meshCenter(0.0f);
+    for (size_t v = 0; v < vertexCount; v++) {
+        meshCenter += vertices[v].position;
+    }
+    meshCenter *= 1.0f / static_cast<float>(std::max<size_t>(vertexCount, 1));
+    struct Cluster {
+        size_t start;
+        size_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted;
+    for (size_t i = 0; i + 1 < clusters.size(); i++) {
+        glm::vec3 center(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[i]; t < clusters[i + 1]; t++) {
+            glm::vec3 a = vertices[indices[t * 3]].position;
+            glm::vec3 b = vertices[indices[t * 3 + 1]].position;
+            glm::vec3 c = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 cross = glm::cross(b - a, c - a); //twice the area, pointing out of the front face
+            float triangleArea = std::sqrt(glm::dot(cross, cross));
+            center += (a + b + c) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        float sortKey = 0.0f;
+        float normalLength = std::sqrt(glm::dot(normal, normal));
+        if (area > 0.0f && normalLength > 0.0f) {
+            sortKey = glm::dot(center * (1.0f / area) - meshCenter, normal * (1.0f / normalLength));
+        }
+        sorted.push_back({clusters[i], clusters[i + 1], sortKey});
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster & a, const Cluster & b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint16_t> output;
+    output.reserve(indexCount);
+    for (const Cluster & cluster : sorted) {
+        output.insert(output.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t optimizeVertexFetch(Vertex * vertices, uint16_t * indices, size_t indexCount, size_t vertexCount) {
+    constexpr uint32_t UNUSED = UINT32_MAX;
+    std::vector<uint32_t> remap(vertexCount, UNUSED);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t & newIndex = remap[indices[i]];
+        if (newIndex == UNUSED) {
+            newIndex = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = static_cast<uint16_t>(newIndex);
+    }
+    std::copy(reordered.begin(), reordered.end(), vertices);
+    return reordered.size();
+}
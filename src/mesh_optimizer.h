@@ -0,0 +1,38 @@
+#ifndef VKENG_MESH_OPTIMIZER_H
+#define VKENG_MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <cstddef>
+#include "vk_mesh.h"
+
+/*
+ * Reordering of indexed triangle lists for the GPU, run on meshes before they're uploaded:
+ *   optimizeVertexCache() orders triangles so their vertices are still in the post-transform cache, with Tom Forsyth's
+ *   "Linear-speed vertex cache optimisation"
+ *   optimizeOverdraw() then splits that order into clusters where the cache starts over anyway and draws the clusters
+ *   facing out from the mesh first, so they hide the ones behind them (Sander et al., "Fast triangle reordering for
+ *   vertex locality and reduced overdraw")
+ *   optimizeVertexFetch() puts the vertices in the order the indices first use them, so vertex fetches are sequential
+ */
+
+//Size of the FIFO cache the stats are measured with, the classic hardware size
+constexpr uint32_t VERTEX_CACHE_STATS_SIZE = 16;
+
+struct VertexCacheStats {
+    float acmr = 0.0f; //vertices transformed per triangle: 3 at worst, about 0.5 for big regular meshes
+    float atvr = 0.0f; //vertices transformed per vertex in the mesh: 1 at best
+};
+
+VertexCacheStats analyzeVertexCache(const uint16_t * indices, size_t indexCount, size_t vertexCount);
+
+void optimizeVertexCache(uint16_t * indices, size_t indexCount, size_t vertexCount);
+
+//Expects indices already ordered by optimizeVertexCache(). threshold is how much worse than the cache order's own
+//ACMR a cluster may get for the sake of splitting it off.
+void optimizeOverdraw(uint16_t * indices, size_t indexCount, const Vertex * vertices, size_t vertexCount, float threshold = 1.05f);
+
+//Reorders vertices in place and rewrites the indices to match. Vertices no triangle uses are dropped from the end,
+//and the number left is returned.
+size_t optimizeVertexFetch(Vertex * vertices, uint16_t * indices, size_t indexCount, size_t vertexCount);
+
+#endif //VKENG_MESH_OPTIMIZER_H
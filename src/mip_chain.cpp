@@ -0,0 +1,66 @@
+#include "mip_chain.h"
+
+#include <cmath>
+#include <algorithm>
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+size_t getMipLevelSize(uint32_t width, uint32_t height, uint32_t layers, uint32_t level) {
+    return static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4 * layers;
+}
+
+std::vector<unsigned char> buildMipChain(const unsigned char * pixels, uint32_t width, uint32_t height, uint32_t layers,
+                                         uint32_t levels, bool srgb) {
+    float toLinear[256];
+    for (int i = 0; i < 256; i++) {
+        float value = static_cast<float>(i) / 255.0f;
+        toLinear[i] = srgb ? (value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f)) : value;
+    }
+    auto fromLinear = [&](float value) {
+        if (srgb) {
+            value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        }
+        return static_cast<unsigned char>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+    };
+
+    std::vector<unsigned char> mips;
+    for (uint32_t level = 1; level < levels; level++) {
+        uint32_t mipWidth = std::max(width / 2, 1u);
+        uint32_t mipHeight = std::max(height / 2, 1u);
+        size_t start = mips.size();
+        mips.resize(start + static_cast<size_t>(mipWidth) * mipHeight * 4 * layers);
+        //The previous level may have just moved if the vector grew, so it's found again by offset
+        const unsigned char * previous = level == 1 ? pixels : mips.data() + (start - static_cast<size_t>(width) * height * 4 * layers);
+        unsigned char * destination = mips.data() + start;
+        for (uint32_t layer = 0; layer < layers; layer++) {
+            const unsigned char * layerSource = previous + static_cast<size_t>(width) * height * 4 * layer;
+            for (uint32_t y = 0; y < mipHeight; y++) {
+                for (uint32_t x = 0; x < mipWidth; x++) {
+                    //Odd sizes repeat the last row or column
+                    uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                    uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                    const unsigned char * texels[4] = {
+                            layerSource + (static_cast<size_t>(y0) * width + x0) * 4, layerSource + (static_cast<size_t>(y0) * width + x1) * 4,
+                            layerSource + (static_cast<size_t>(y1) * width + x0) * 4, layerSource + (static_cast<size_t>(y1) * width + x1) * 4,
+                    };
+                    for (int channel = 0; channel < 4; channel++) {
+                        float sum = 0.0f;
+                        for (const unsigned char * texel : texels) {
+                            sum += channel == 3 ? static_cast<float>(texel[channel]) / 255.0f : toLinear[texel[channel]];
+                        }
+                        *destination++ = channel == 3 ? static_cast<unsigned char>(sum / 4.0f * 255.0f + 0.5f) : fromLinear(sum / 4.0f);
+                    }
+                }
+            }
+        }
+        width = mipWidth;
+        height = mipHeight;
+    }
+    return mips;
+}
@@ -0,0 +1,19 @@
+#ifndef VKENG_MIP_CHAIN_H
+#define VKENG_MIP_CHAIN_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//The number of levels in a full mip chain down to 1x1
+uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+//Bytes of one RGBA8 mip level with all its array layers
+size_t getMipLevelSize(uint32_t width, uint32_t height, uint32_t layers, uint32_t level);
+
+//Builds mip levels 1 and up of an RGBA8 image with a 2x2 box filter. Every level holds all array layers one after
+//another, and the levels follow each other without padding. sRGB images are averaged in linear space.
+std::vector<unsigned char> buildMipChain(const unsigned char * pixels, uint32_t width, uint32_t height, uint32_t layers,
+                                         uint32_t levels, bool srgb);
+
+#endif //VKENG_MIP_CHAIN_H
@@ -0,0 +1,375 @@
+#include "obj_loader.h"
+#include "mapped_file.h"
+#include "job_system.h"
+#include "cpu_profiler.h"
+
+#include <iostream>
+#include <cstring>
+#include <charconv>
+#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <mapbox/earcut.hpp>
+
+namespace {
+
+//Files smaller than this are parsed in one piece, as splitting them costs more than it saves
+constexpr size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+//Indices into the attribute arrays, -1 if the corner doesn't have that attribute
+struct ObjCorner {
+    int32_t position;
+    int32_t uv;
+    int32_t normal;
+
+    bool operator==(const ObjCorner & other) const {
+        return position == other.position && uv == other.uv && normal == other.normal;
+    }
+};
+
+struct ObjCornerHash {
+    size_t operator()(const ObjCorner & corner) const {
+        uint64_t key = static_cast<uint64_t>(static_cast<uint32_t>(corner.position)) * 0x9E3779B97F4A7C15ull;
+        key ^= (static_cast<uint64_t>(static_cast<uint32_t>(corner.uv)) + 0x632BE59BD9B4E019ull) * 0xBF58476D1CE4E5B9ull;
+        key ^= (static_cast<uint64_t>(static_cast<uint32_t>(corner.normal)) + 0x85157AF5ull) * 0x94D049BB133111EBull;
+        return static_cast<size_t>(key ^ (key >> 31));
+    }
+};
+
+struct ObjChunk {
+    const char * begin;
+    const char * end;
+    //Attributes in the chunks before this one, so its own go after them
+    size_t positionBase = 0;
+    size_t uvBase = 0;
+    size_t normalBase = 0;
+    size_t positionCount = 0;
+    size_t uvCount = 0;
+    size_t normalCount = 0;
+
+    std::vector<ObjCorner> corners; //of every face, one face after another
+    std::vector<uint32_t> faceSizes;
+    std::vector<ObjCorner> triangles; //corners of the triangulated faces
+    size_t errorLine = 0; //offset of the line that couldn't be parsed from the start of the chunk
+    bool failed = false;
+};
+
+const char * skipSpaces(const char * p, const char * end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+const char * nextLine(const char * p, const char * end) {
+    const char * newline = static_cast<const char *>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+//Parses up to count floats, leaving the rest of values alone. Returns how many were read.
+size_t parseFloats(const char * p, const char * end, float * values, size_t count) {
+    size_t read = 0;
+    for (; read < count; read++) {
+        p = skipSpaces(p, end);
+        if (p < end && *p == '+') {
+            p++;
+        }
+        auto result = std::from_chars(p, end, values[read]);
+        if (result.ec != std::errc()) {
+            break;
+        }
+        p = result.ptr;
+    }
+    return read;
+}
+
+//Turns a 1-based OBJ index, or a negative one counting back from the last attribute so far, into a 0-based one
+int32_t resolveIndex(int64_t index, size_t countSoFar) {
+    if (index > 0) {
+        return static_cast<int32_t>(index - 1);
+    }
+    if (index < 0 && static_cast<int64_t>(countSoFar) + index >= 0) {
+        return static_cast<int32_t>(static_cast<int64_t>(countSoFar) + index);
+    }
+    return INT32_MAX; //out of range, caught when the indices are checked
+}
+
+//Parses "v", "v/vt", "v//vn" or "v/vt/vn". Returns null if there's no corner at p.
+const char * parseCorner(const char * p, const char * end, const ObjChunk & chunk, size_t positions, size_t uvs, size_t normals, ObjCorner & corner) {
+    int64_t values[3] = {0, 0, 0};
+    for (int i = 0; i < 3; i++) {
+        if (p < end && *p != '/' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            auto result = std::from_chars(p, end, values[i]);
+            if (result.ec != std::errc()) {
+                return nullptr;
+            }
+            p = result.ptr;
+        }
+        if (i < 2 && p < end && *p == '/') {
+            p++;
+        }
+        else {
+            break;
+        }
+    }
+    if (values[0] == 0) {
+        return nullptr;
+    }
+    corner.position = resolveIndex(values[0], chunk.positionBase + positions);
+    corner.uv = values[1] != 0 ? resolveIndex(values[1], chunk.uvBase + uvs) : -1;
+    corner.normal = values[2] != 0 ? resolveIndex(values[2], chunk.normalBase + normals) : -1;
+    return p;
+}
+
+//Counts the chunk's attribute lines, so the chunks after it know where theirs start
+void countAttributes(ObjChunk & chunk) {
+    for (const char * p = chunk.begin; p < chunk.end; p = nextLine(p, chunk.end)) {
+        p = skipSpaces(p, chunk.end);
+        if (chunk.end - p < 2 || p[0] != 'v') {
+            continue;
+        }
+        if (p[1] == ' ' || p[1] == '\t') {
+            chunk.positionCount++;
+        }
+        else if (p[1] == 't') {
+            chunk.uvCount++;
+        }
+        else if (p[1] == 'n') {
+            chunk.normalCount++;
+        }
+    }
+}
+
+void parseChunk(ObjChunk & chunk, std::vector<float> & positions, std::vector<float> & uvs, std::vector<float> & normals) {
+    PROFILE_FUNCTION();
+    size_t positionCount = 0;
+    size_t uvCount = 0;
+    size_t normalCount = 0;
+    for (const char * line = chunk.begin; line < chunk.end && !chunk.failed; line = nextLine(line, chunk.end)) {
+        const char * p = skipSpaces(line, chunk.end);
+        if (chunk.end - p < 2 || p[0] == '#') {
+            continue;
+        }
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            //Colors after the position are ignored
+            float * position = &positions[3 * (chunk.positionBase + positionCount++)];
+            chunk.failed = parseFloats(p + 2, chunk.end, position, 3) != 3;
+        }
+        else if (p[0] == 'v' && p[1] == 't') {
+            float * uv = &uvs[2 * (chunk.uvBase + uvCount++)];
+            uv[1] = 0.0f;
+            chunk.failed = parseFloats(p + 2, chunk.end, uv, 2) == 0;
+        }
+        else if (p[0] == 'v' && p[1] == 'n') {
+            float * normal = &normals[3 * (chunk.normalBase + normalCount++)];
+            chunk.failed = parseFloats(p + 2, chunk.end, normal, 3) != 3;
+        }
+        else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            uint32_t faceSize = 0;
+            p += 2;
+            while (true) {
+                p = skipSpaces(p, chunk.end);
+                ObjCorner corner;
+                const char * next = parseCorner(p, chunk.end, chunk, positionCount, uvCount, normalCount, corner);
+                if (!next) {
+                    break;
+                }
+                chunk.corners.push_back(corner);
+                faceSize++;
+                p = next;
+            }
+            //Anything left on the line other than a comment or line break means a corner couldn't be read
+            bool trailing = p < chunk.end && *p != '\r' && *p != '\n' && *p != '#';
+            if (faceSize < 3 || trailing) {
+                chunk.corners.resize(chunk.corners.size() - faceSize);
+                chunk.failed = true;
+            }
+            else {
+                chunk.faceSizes.push_back(faceSize);
+            }
+        }
+        if (chunk.failed) {
+            chunk.errorLine = static_cast<size_t>(line - chunk.begin);
+        }
+    }
+}
+
+void triangulateChunk(ObjChunk & chunk, const std::vector<float> & positions) {
+    PROFILE_FUNCTION();
+    auto position = [&](const ObjCorner & corner) {
+        const float * p = &positions[3 * static_cast<size_t>(corner.position)];
+        return std::array<float, 3>{p[0], p[1], p[2]};
+    };
+    chunk.triangles.reserve(chunk.corners.size() * 3 / 2);
+    std::vector<std::vector<std::array<float, 2>>> polygon(1);
+    size_t first = 0;
+    for (uint32_t faceSize : chunk.faceSizes) {
+        const ObjCorner * face = &chunk.corners[first];
+        first += faceSize;
+        if (faceSize == 3) {
+            chunk.triangles.insert(chunk.triangles.end(), face, face + 3);
+            continue;
+        }
+
+        //Polygons are flattened onto the axis plane closest to their own, using the normal from Newell's method
+        float normal[3] = {0.0f, 0.0f, 0.0f};
+        for (uint32_t i = 0; i < faceSize; i++) {
+            auto a = position(face[i]);
+            auto b = position(face[(i + 1) % faceSize]);
+            normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+            normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+            normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+        }
+        int dropped = 0;
+        if (std::abs(normal[1]) > std::abs(normal[dropped])) {
+            dropped = 1;
+        }
+        if (std::abs(normal[2]) > std::abs(normal[dropped])) {
+            dropped = 2;
+        }
+        int u = (dropped + 1) % 3;
+        int v = (dropped + 2) % 3;
+        polygon[0].clear();
+        for (uint32_t i = 0; i < faceSize; i++) {
+            auto p = position(face[i]);
+            polygon[0].push_back({p[u], p[v]});
+        }
+        std::vector<uint32_t> triangles = mapbox::earcut<uint32_t>(polygon);
+        //Degenerate polygons earcut gives up on are fanned instead
+        if (triangles.size() != (faceSize - 2) * 3) {
+            triangles.clear();
+            for (uint32_t i = 1; i + 1 < faceSize; i++) {
+                triangles.insert(triangles.end(), {0, i, i + 1});
+            }
+        }
+        //earcut picks its own winding, so each triangle is turned to face the same way as the polygon
+        for (size_t i = 0; i < triangles.size(); i += 3) {
+            auto a = position(face[triangles[i]]);
+            auto b = position(face[triangles[i + 1]]);
+            auto c = position(face[triangles[i + 2]]);
+            float cross[3] = {
+                    (b[1] - a[1]) * (c[2] - a[2]) - (b[2] - a[2]) * (c[1] - a[1]),
+                    (b[2] - a[2]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[2] - a[2]),
+                    (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]),
+            };
+            bool flipped = cross[0] * normal[0] + cross[1] * normal[1] + cross[2] * normal[2] < 0.0f;
+            chunk.triangles.push_back(face[triangles[i]]);
+            chunk.triangles.push_back(face[triangles[i + (flipped ? 2 : 1)]]);
+            chunk.triangles.push_back(face[triangles[i + (flipped ? 1 : 2)]]);
+        }
+    }
+    std::vector<ObjCorner>().swap(chunk.corners);
+}
+
+}
+
+bool loadObj(const char * filename, ObjMesh & mesh, JobSystem * jobs) {
+    PROFILE_FUNCTION();
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "[ERR] OBJ loader: can't read " << filename << std::endl;
+        return false;
+    }
+    const char * data = reinterpret_cast<const char *>(file.data());
+    const char * dataEnd = data + file.size();
+
+    //A few chunks per thread, so one full of long face lines doesn't hold up the rest
+    size_t chunkCount = 1;
+    if (jobs) {
+        chunkCount = std::clamp<size_t>(file.size() / OBJ_MIN_CHUNK_SIZE, 1, (jobs->getThreadCount() + 1) * 4);
+    }
+    std::vector<ObjChunk> chunks;
+    const char * chunkBegin = data;
+    for (size_t i = 1; i <= chunkCount && chunkBegin < dataEnd; i++) {
+        const char * chunkEnd = i == chunkCount ? dataEnd : nextLine(std::max(chunkBegin, data + file.size() * i / chunkCount), dataEnd);
+        ObjChunk chunk = {};
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunks.push_back(chunk);
+        chunkBegin = chunkEnd;
+    }
+    auto forEachChunk = [&](const std::function<void(size_t)> & job) {
+        if (jobs && chunks.size() > 1) {
+            jobs->parallelFor(chunks.size(), job);
+        }
+        else {
+            for (size_t i = 0; i < chunks.size(); i++) {
+                job(i);
+            }
+        }
+    };
+
+    forEachChunk([&](size_t i) {
+        countAttributes(chunks[i]);
+    });
+    size_t positionCount = 0, uvCount = 0, normalCount = 0;
+    for (auto & chunk : chunks) {
+        chunk.positionBase = positionCount;
+        chunk.uvBase = uvCount;
+        chunk.normalBase = normalCount;
+        positionCount += chunk.positionCount;
+        uvCount += chunk.uvCount;
+        normalCount += chunk.normalCount;
+    }
+    std::vector<float> positions(positionCount * 3);
+    std::vector<float> uvs(uvCount * 2);
+    std::vector<float> normals(normalCount * 3);
+    forEachChunk([&](size_t i) {
+        parseChunk(chunks[i], positions, uvs, normals);
+    });
+
+    size_t cornerCount = 0;
+    for (const auto & chunk : chunks) {
+        if (chunk.failed) {
+            size_t lineNumber = 1 + std::count(data, chunk.begin + chunk.errorLine, '\n');
+            std::cerr << "[ERR] OBJ loader: can't parse line " << lineNumber << " of " << filename << std::endl;
+            return false;
+        }
+        for (const ObjCorner & corner : chunk.corners) {
+            if (static_cast<size_t>(corner.position) >= positionCount || (corner.uv >= 0 && static_cast<size_t>(corner.uv) >= uvCount) ||
+                (corner.normal >= 0 && static_cast<size_t>(corner.normal) >= normalCount)) {
+                std::cerr << "[ERR] OBJ loader: a face in " << filename << " refers to an attribute the file doesn't have" << std::endl;
+                return false;
+            }
+        }
+        cornerCount += chunk.corners.size();
+    }
+    forEachChunk([&](size_t i) {
+        triangulateChunk(chunks[i], positions);
+    });
+
+    //Corners are deduplicated by their attribute indices, in file order so the result doesn't depend on the chunking
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.cornerCount = 0;
+    for (const auto & chunk : chunks) {
+        mesh.cornerCount += chunk.triangles.size();
+    }
+    mesh.indices.reserve(mesh.cornerCount);
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> vertexIndices;
+    vertexIndices.reserve(std::min(cornerCount, positionCount * 2));
+    for (const auto & chunk : chunks) {
+        for (const ObjCorner & corner : chunk.triangles) {
+            auto [it, inserted] = vertexIndices.try_emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+            if (inserted) {
+                Vertex vertex = {};
+                const float * position = &positions[3 * static_cast<size_t>(corner.position)];
+                vertex.position = glm::vec3(position[0], position[1], position[2]);
+                if (corner.normal >= 0) {
+                    const float * normal = &normals[3 * static_cast<size_t>(corner.normal)];
+                    vertex.normal = glm::vec3(normal[0], normal[1], normal[2]);
+                    //Set the vertex color to normal coords for visualization purposes
+                    vertex.color = vertex.normal;
+                }
+                if (corner.uv >= 0) {
+                    const float * uv = &uvs[2 * static_cast<size_t>(corner.uv)];
+                    vertex.uv = glm::vec2(uv[0], 1.0f - uv[1]);
+                }
+                mesh.vertices.push_back(vertex);
+            }
+            mesh.indices.push_back(it->second);
+        }
+    }
+    return true;
+}
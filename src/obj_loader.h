@@ -0,0 +1,27 @@
+#ifndef VKENG_OBJ_LOADER_H
+#define VKENG_OBJ_LOADER_H
+
+#include <vector>
+#include <cstdint>
+#include "vk_mesh.h"
+
+class JobSystem;
+
+//An OBJ file as an indexed triangle list
+struct ObjMesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    size_t cornerCount = 0; //triangle corners before deduplication, the vertex count without an index buffer
+};
+
+/*
+ * Wavefront OBJ import. The file is mapped and split at line breaks into chunks that the job system parses in
+ * parallel: a first pass counts each chunk's v, vt and vn lines so every chunk knows where its attributes go, the
+ * second parses them and the faces. Polygons are triangulated with earcut, and corners with the same position, uv and
+ * normal become one vertex. Only v, vt, vn and f lines are read; materials, groups and smoothing groups are ignored.
+ * Returns false, printing why, if the file can't be read or a face refers to an attribute the file doesn't have.
+ * Without a job system the file is parsed on the calling thread.
+ */
+bool loadObj(const char * filename, ObjMesh & mesh, JobSystem * jobs = nullptr);
+
+#endif //VKENG_OBJ_LOADER_H
@@ -0,0 +1,129 @@
+#include "png_writer.h"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+namespace {
+    //Max payload of a stored deflate block
+    constexpr size_t MAX_STORED_BLOCK = 65535;
+
+    struct Crc32Table {
+        uint32_t values[256];
+
+        Crc32Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                values[i] = c;
+            }
+        }
+    };
+
+    uint32_t crc32(uint32_t crc, const uint8_t * data, size_t size) {
+        static const Crc32Table table;
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    struct Adler32 {
+        uint32_t a = 1;
+        uint32_t b = 0;
+
+        void update(const uint8_t * data, size_t size) {
+            //5552 is the most bytes that can be summed before b can overflow 32 bits
+            while (size > 0) {
+                size_t n = std::min<size_t>(size, 5552);
+                for (size_t i = 0; i < n; i++) {
+                    a += data[i];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+                data += n;
+                size -= n;
+            }
+        }
+
+        uint32_t value() const { return (b << 16) | a; }
+    };
+
+    void putBigEndian(std::vector<uint8_t> & out, uint32_t value) {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void writeChunk(std::ofstream & file, const char * type, const std::vector<uint8_t> & data) {
+        std::vector<uint8_t> chunk;
+        chunk.reserve(data.size() + 12);
+        putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        //The CRC covers the type and the data but not the length
+        putBigEndian(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+        file.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+    }
+}
+
+bool writePng(const std::string &filename, uint32_t width, uint32_t height, const uint8_t *rgba) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    header.push_back(8); //bit depth
+    header.push_back(6); //colour type RGBA
+    header.push_back(0); //deflate
+    header.push_back(0); //adaptive filtering
+    header.push_back(0); //no interlacing
+    writeChunk(file, "IHDR", header);
+
+    //Every scanline starts with its filter type byte, 0 = no filter
+    const size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> raw;
+    raw.reserve((rowSize + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * rowSize, rgba + (y + 1) * rowSize);
+    }
+
+    //zlib stream made of stored blocks
+    std::vector<uint8_t> idat;
+    idat.reserve(raw.size() + raw.size() / MAX_STORED_BLOCK * 5 + 16);
+    idat.push_back(0x78); //deflate, 32K window
+    idat.push_back(0x01); //no preset dictionary, fastest level, header checksum
+    size_t offset = 0;
+    do {
+        size_t blockSize = std::min(raw.size() - offset, MAX_STORED_BLOCK);
+        bool last = offset + blockSize == raw.size();
+        idat.push_back(last ? 1 : 0);
+        idat.push_back(static_cast<uint8_t>(blockSize));
+        idat.push_back(static_cast<uint8_t>(blockSize >> 8));
+        idat.push_back(static_cast<uint8_t>(~blockSize));
+        idat.push_back(static_cast<uint8_t>(~blockSize >> 8));
+        idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < raw.size());
+    Adler32 adler;
+    adler.update(raw.data(), raw.size());
+    putBigEndian(idat, adler.value());
+    writeChunk(file, "IDAT", idat);
+
+    writeChunk(file, "IEND", {});
+    return file.good();
+}
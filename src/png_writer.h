@@ -0,0 +1,14 @@
+#ifndef VKENG_PNG_WRITER_H
+#define VKENG_PNG_WRITER_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Minimal PNG encoder for frame captures. Writes 8-bit RGBA with no filtering and stored (uncompressed) deflate
+ * blocks, so files are large but encoding is little more than a memcpy and two checksums. Any PNG reader, including
+ * stb_image, can load the result.
+ */
+bool writePng(const std::string & filename, uint32_t width, uint32_t height, const uint8_t * rgba);
+
+#endif //VKENG_PNG_WRITER_H
@@ -0,0 +1,76 @@
+#include "shader_archive.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+bool ShaderArchive::open(const std::string &path) {
+    m_entries = nullptr;
+    m_entryCount = 0;
+    if (!m_file.open(path)) {
+        return false;
+    }
+    if (!parse(m_file.data(), m_file.size())) {
+        std::cout << "Shader archive " << path << " is malformed." << std::endl;
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool ShaderArchive::openMemory(const void *data, size_t size) {
+    m_file.close();
+    m_entries = nullptr;
+    m_entryCount = 0;
+    if (!parse(static_cast<const uint8_t *>(data), size)) {
+        std::cout << "Embedded shader archive is malformed." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ShaderArchive::parse(const uint8_t *data, size_t size) {
+    //SPIR-V is read in place as 32-bit words
+    if (size < sizeof(ShaderArchiveHeader) || reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+        return false;
+    }
+    ShaderArchiveHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != SHADER_ARCHIVE_MAGIC || header.version != SHADER_ARCHIVE_VERSION ||
+        header.entryCount > (size - sizeof(header)) / sizeof(ShaderArchiveEntry)) {
+        return false;
+    }
+
+    //Check every entry once here, so find() can hand out pointers without further checks
+    auto entries = reinterpret_cast<const ShaderArchiveEntry *>(data + sizeof(header));
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const ShaderArchiveEntry & entry = entries[i];
+        bool terminated = memchr(entry.path, '\0', SHADER_ARCHIVE_MAX_PATH) != nullptr;
+        bool sorted = i == 0 || (terminated && strcmp(entries[i - 1].path, entry.path) < 0);
+        if (!terminated || !sorted || entry.offset % 4 != 0 || entry.size % 4 != 0 ||
+            entry.offset > size || entry.size > size - entry.offset) {
+            return false;
+        }
+    }
+    m_data = data;
+    m_entries = entries;
+    m_entryCount = header.entryCount;
+    return true;
+}
+
+ShaderBlob ShaderArchive::find(const std::string &path) const {
+    if (!isOpen()) {
+        return {};
+    }
+    const ShaderArchiveEntry * end = m_entries + m_entryCount;
+    auto it = std::lower_bound(m_entries, end, path, [](const ShaderArchiveEntry & entry, const std::string & key) {
+        return strcmp(entry.path, key.c_str()) < 0;
+    });
+    if (it == end || path != it->path) {
+        return {};
+    }
+    ShaderBlob blob;
+    blob.code = reinterpret_cast<const uint32_t *>(m_data + it->offset);
+    blob.wordCount = it->size / sizeof(uint32_t);
+    return blob;
+}
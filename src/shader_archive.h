@@ -0,0 +1,65 @@
+#ifndef VKENG_SHADER_ARCHIVE_H
+#define VKENG_SHADER_ARCHIVE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "mapped_file.h"
+
+/*
+ * The compiled shaders packed into one file by tools/pack_shaders.cpp at build time. Layout:
+ *   ShaderArchiveHeader
+ *   ShaderArchiveEntry[entryCount], sorted by path
+ *   the SPIR-V of each entry, at a 4-byte aligned offset from the start of the file
+ * Everything is little endian, like SPIR-V written by glslc on the machines we build on.
+ */
+constexpr uint32_t SHADER_ARCHIVE_MAGIC = 0x4b415053; //"SPAK"
+constexpr uint32_t SHADER_ARCHIVE_VERSION = 1;
+constexpr size_t SHADER_ARCHIVE_MAX_PATH = 56;
+
+struct ShaderArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct ShaderArchiveEntry {
+    char path[SHADER_ARCHIVE_MAX_PATH]; //e.g. "shaders/water.frag.spv", the path the engine would load it from. Null terminated.
+    uint32_t offset;
+    uint32_t size; //in bytes
+};
+
+static_assert(sizeof(ShaderArchiveHeader) == 16 && sizeof(ShaderArchiveEntry) == 64, "The archive layout is fixed");
+
+//SPIR-V inside an archive. Points into the archive's memory, so it's only valid while the archive is open.
+struct ShaderBlob {
+    const uint32_t * code = nullptr;
+    size_t wordCount = 0;
+
+    explicit operator bool() const { return code != nullptr; }
+};
+
+class ShaderArchive {
+public:
+    //Maps an archive file. Returns false, printing why, if it's missing or malformed.
+    bool open(const std::string & path);
+    //Uses an archive that's already in memory, like one embedded in the executable. The memory has to outlive this.
+    bool openMemory(const void * data, size_t size);
+
+    //Binary search by path. Returns an empty blob if the archive doesn't have it.
+    ShaderBlob find(const std::string & path) const;
+
+    bool isOpen() const { return m_entries != nullptr; }
+    uint32_t getShaderCount() const { return m_entryCount; }
+
+private:
+    MappedFile m_file;
+    const uint8_t * m_data = nullptr;
+    const ShaderArchiveEntry * m_entries = nullptr;
+    uint32_t m_entryCount = 0;
+
+    bool parse(const uint8_t * data, size_t size);
+};
+
+#endif //VKENG_SHADER_ARCHIVE_H
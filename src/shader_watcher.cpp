@@ -0,0 +1,165 @@
+#include "shader_watcher.h"
+#include "cpu_profiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <chrono>
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+//How often the directories are polled. File system notifications would be faster but aren't portable.
+static const auto POLL_INTERVAL = std::chrono::milliseconds(250);
+
+void ShaderWatcher::start(const std::string &sourceDirectory, const std::string &spirvDirectory, const std::string &glslc) {
+    m_sourceDirectory = sourceDirectory;
+    m_spirvDirectory = spirvDirectory;
+    m_glslc = glslc;
+    m_stopping = false;
+    m_thread = std::thread(&ShaderWatcher::watchLoop, this);
+    std::cout << "Watching " << (m_sourceDirectory.empty() ? "" : m_sourceDirectory + " and ") << m_spirvDirectory
+              << " for shader changes." << std::endl;
+}
+
+void ShaderWatcher::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+std::vector<ShaderChange> ShaderWatcher::takeChanges() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<ShaderChange> changes;
+    changes.swap(m_changes);
+    return changes;
+}
+
+void ShaderWatcher::watchLoop() {
+    PROFILE_THREAD_NAME("shader watcher");
+    bool firstScan = true;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!firstScan) {
+                m_wake.wait_for(lock, POLL_INTERVAL, [&]() { return m_stopping; });
+            }
+            if (m_stopping) {
+                return;
+            }
+        }
+
+        //Recompile changed sources first, so their output is picked up by the SPIR-V scan below in the same pass
+        if (!m_sourceDirectory.empty()) {
+            auto sources = scan(m_sourceDirectory, {".vert", ".frag", ".comp"}, m_sourceTimes, !firstScan);
+            for (const auto & source : sources) {
+                compile(source);
+            }
+        }
+
+        auto spirvFiles = scan(m_spirvDirectory, {".spv"}, m_spirvTimes, !firstScan);
+        for (const auto & path : spirvFiles) {
+            ShaderChange change;
+            //Use the same form of path the engine loads shaders with, "shaders/foo.spv", regardless of how the
+            //directory was given
+            change.path = m_spirvDirectory + "/" + std::filesystem::path(path).filename().string();
+            if (!readSpirv(path, change.code)) {
+                std::cout << "Ignoring " << path << ", it isn't valid SPIR-V (yet?)" << std::endl;
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            //A file changed twice before the main thread got to it only needs loading once
+            bool replaced = false;
+            for (auto & pending : m_changes) {
+                if (pending.path == change.path) {
+                    pending.code = std::move(change.code);
+                    replaced = true;
+                    break;
+                }
+            }
+            if (!replaced) {
+                m_changes.push_back(std::move(change));
+            }
+        }
+        firstScan = false;
+    }
+}
+
+std::vector<std::string> ShaderWatcher::scan(const std::string &directory, const std::vector<std::string> &extensions,
+                                             std::unordered_map<std::string, std::filesystem::file_time_type> &times, bool report) {
+    std::vector<std::string> changed;
+    std::error_code error;
+    for (const auto & entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string extension = entry.path().extension().string();
+        bool watched = false;
+        for (const auto & watchedExtension : extensions) {
+            watched |= extension == watchedExtension;
+        }
+        if (!watched || !entry.is_regular_file(error)) {
+            continue;
+        }
+
+        auto time = entry.last_write_time(error);
+        if (error) {
+            continue;
+        }
+        std::string path = entry.path().string();
+        auto it = times.find(path);
+        if (it == times.end() || it->second != time) {
+            times[path] = time;
+            if (report) {
+                changed.push_back(path);
+            }
+        }
+    }
+    return changed;
+}
+
+bool ShaderWatcher::compile(const std::string &source) {
+    PROFILE_FUNCTION();
+    if (m_glslc.empty()) {
+        return false;
+    }
+    //Same naming as the build: foo.frag -> foo.frag.spv. glslc writes to a temporary file that is renamed into
+    //place, so the SPIR-V scan never sees a half-written shader.
+    std::filesystem::path output = std::filesystem::path(m_spirvDirectory) / (std::filesystem::path(source).filename().string() + ".spv");
+    std::string tempOutput = output.string() + ".tmp";
+    std::string command = "\"" + m_glslc + "\" -O \"" + source + "\" -o \"" + tempOutput + "\"";
+
+    std::cout << "Recompiling " << source << std::endl;
+    if (std::system(command.c_str()) != 0) {
+        //glslc has already printed the errors. Keep running with the old shader.
+        std::cout << "Failed to compile " << source << ", keeping the previous version." << std::endl;
+        std::error_code error;
+        std::filesystem::remove(tempOutput, error);
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempOutput, output, error);
+    if (error) {
+        std::cout << "Failed to replace " << output.string() << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ShaderWatcher::readSpirv(const std::string &path, std::vector<uint32_t> &code) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    size_t fileSize = file.tellg();
+    if (fileSize < 5 * sizeof(uint32_t) || fileSize % sizeof(uint32_t) != 0) {
+        return false;
+    }
+    code.resize(fileSize / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(code.data()), static_cast<std::streamsize>(fileSize));
+    return file && code[0] == SPIRV_MAGIC;
+}
@@ -0,0 +1,54 @@
+#ifndef VKENG_SHADER_WATCHER_H
+#define VKENG_SHADER_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+
+struct ShaderChange {
+    std::string path; //e.g. "shaders/water.frag.spv", the same path the engine loads the shader from
+    std::vector<uint32_t> code;
+};
+
+/*
+ * Watches shader sources and compiled SPIR-V from a background thread. A changed GLSL source is recompiled with
+ * glslc on that thread; a changed .spv file (ours or from an external build) is read and queued for the main
+ * thread, which only has to create the shader module and hand the pipelines to the compiler.
+ */
+class ShaderWatcher {
+public:
+    //sourceDirectory may be empty to only watch the SPIR-V. glslc is only needed to recompile sources.
+    void start(const std::string & sourceDirectory, const std::string & spirvDirectory, const std::string & glslc);
+    void stop();
+
+    //SPIR-V that changed since the last call. The most recent version of each file only.
+    std::vector<ShaderChange> takeChanges();
+
+private:
+    std::string m_sourceDirectory;
+    std::string m_spirvDirectory;
+    std::string m_glslc;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+    std::vector<ShaderChange> m_changes; //guarded by m_mutex
+
+    //Only touched by the watcher thread
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_sourceTimes;
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_spirvTimes;
+
+    void watchLoop();
+    //Returns the files in directory that changed since the last scan. The first scan only records times.
+    static std::vector<std::string> scan(const std::string & directory, const std::vector<std::string> & extensions,
+                                         std::unordered_map<std::string, std::filesystem::file_time_type> & times, bool report);
+    bool compile(const std::string & source);
+    static bool readSpirv(const std::string & path, std::vector<uint32_t> & code);
+};
+
+#endif //VKENG_SHADER_WATCHER_H
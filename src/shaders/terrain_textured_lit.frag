@@ -6,9 +6,18 @@ layout (location=2) in vec3 fragPos;
 layout (location=3) in vec3 normal;
 layout (location=4) in vec3 viewPos;
 layout (location=5) in float worldHeight;
+layout (location=6) in float viewDepth;
 
 layout (location=0) out vec4 outColor;
 
+//Specialization constants, see SpecializationConstant in vk_engine.h. The defaults are only used if a pipeline
+//doesn't set them.
+layout (constant_id = 2) const bool ENABLE_SPECULAR = true;
+//The heights the blend lookup covers
+layout (constant_id = 3) const float BLEND_HEIGHT_MIN = 30.0f;
+layout (constant_id = 4) const float BLEND_HEIGHT_MAX = 90.0f;
+layout (constant_id = 5) const bool ENABLE_BAND_BLENDING = true;
+
 layout (set=0, binding=1) uniform SceneData{
     vec4 fogColor;
     vec4 fogDistances;
@@ -22,20 +31,34 @@ struct ObjectData{
 };
 
 struct PointLightData{
-    vec4 lightPosition;
+    vec4 lightPosition; //w is the radius
     vec4 lightColor;
 };
 
-//All light matrices
-layout(std140, set = 1, binding = 1) readonly buffer LightBuffer{
+//All point lights
+layout(std430, set = 1, binding = 1) readonly buffer LightBuffer{
     PointLightData lights[];
 } lightBuffer;
 
+//The lights binned into view space clusters, see light_clusters.h
+layout(std430, set = 1, binding = 2) readonly buffer ClusterBuffer{
+    uvec4 gridSize; //clusters in x, y and z; w is the light count
+    vec4 gridParams; //tile width and height in pixels, scale and bias from log(view depth) to a depth slice
+    uvec2 clusters[]; //offset and count in lightIndices
+} clusterBuffer;
+
+layout(std430, set = 1, binding = 3) readonly buffer LightIndexBuffer{
+    uint lightIndices[];
+} lightIndexBuffer;
+
 layout(push_constant) uniform per_object {
     layout(offset=80) int texIdx;
 } texData;
 
-layout (set=2, binding=0) uniform sampler2D tex1[3];
+//Terrain layers from the lowest to the highest, see TERRAIN_LAYERS in vk_engine.cpp
+layout (set=2, binding=0) uniform sampler2DArray terrainLayers;
+//Layer coordinate by height: the integer part is the lower layer, the fraction how far it has blended into the next
+layout (set=2, binding=1) uniform sampler1D terrainBlend;
 
 //Returns the specular component only
 //lightColor.w = exponent
@@ -50,30 +73,24 @@ vec3 blinnPhong(vec3 lightDir, vec3 normal, vec4 lightColor) {
 
 const float tilingFactor = 8.0f; //repeat texture 8 times for each "chunk"
 
+//The same work for every height, so neighbouring fragments on either side of a band boundary don't diverge.
+//Without blending, switches from the lower to the upper layer halfway and only samples one of them.
+vec3 sampleLayers(vec2 uv) {
+    float layer = texture(terrainBlend, (worldHeight - BLEND_HEIGHT_MIN) / (BLEND_HEIGHT_MAX - BLEND_HEIGHT_MIN)).r;
+    if (!ENABLE_BAND_BLENDING) {
+        return texture(terrainLayers, vec3(uv, round(layer))).xyz;
+    }
+    //Past the last layer the array index clamps, so the top layer blends with itself
+    float lower = floor(layer);
+    vec3 lowerColor = texture(terrainLayers, vec3(uv, lower)).xyz;
+    vec3 upperColor = texture(terrainLayers, vec3(uv, lower + 1.0f)).xyz;
+    return mix(lowerColor, upperColor, layer - lower);
+}
+
 void main() {
     vec2 tiledTexCoord = texCoord * tilingFactor;
-    vec3 color = vec3(0.0f);
-    if (worldHeight < 30.0f) { //all grass
-        color = texture(tex1[0], tiledTexCoord).xyz;
-    }
-    else if (worldHeight < 50.0f) { //mix of grass and rock
-        vec3 grass = texture(tex1[0], tiledTexCoord).xyz;
-        vec3 rock = texture(tex1[1], tiledTexCoord).xyz;
-        color = mix(grass, rock, (worldHeight - 30.0f) / 20.0f);
-    }
-    else if (worldHeight < 70.0f) { //all rock
-        color = texture(tex1[1], tiledTexCoord).xyz;
-    }
-    else if (worldHeight < 90.0f) { //mix of rock and snow
-        vec3 rock = texture(tex1[1], tiledTexCoord).xyz;
-        vec3 snow = texture(tex1[2], tiledTexCoord).xyz;
-        color = mix(rock, snow, (worldHeight - 70.0f) / 20.0f);
-    }
-    else { //all snow
-        color = texture(tex1[2], tiledTexCoord).xyz;
-    }
+    vec3 color = sampleLayers(tiledTexCoord);
 
-    //vec3 color = texture(tex1[texData.texIdx], tiledTexCoord).xyz;
     //vec3 color = vec3(1.0f);
     vec3 lights = vec3(0.0f);
     //Calculate sunlight
@@ -84,22 +101,31 @@ void main() {
         vec4 sunCol = sceneData.sunlightColor;
         float sunCos = dot(sunDir, normal);
         vec3 sunDiffuse = max(0.0, sunCos) * sunCol.xyz;
-        vec3 sunSpecular = blinnPhong(sunDir, normal, sunCol);
-
-        lights += sunDiffuse + sunSpecular;
+        lights += sunDiffuse;
+        if (ENABLE_SPECULAR) {
+            lights += blinnPhong(sunDir, normal, sunCol);
+        }
     }
 
-    //Calculate dynamic lights
-    for (int i = 0; i < 0; i++) {
-        PointLightData light = lightBuffer.lights[i];
+    //Calculate dynamic lights, only the ones binned into this fragment's cluster
+    uvec3 clusterCell = uvec3(uvec2(gl_FragCoord.xy / clusterBuffer.gridParams.xy),
+                              uint(max(log(viewDepth) * clusterBuffer.gridParams.z + clusterBuffer.gridParams.w, 0.0f)));
+    clusterCell = min(clusterCell, clusterBuffer.gridSize.xyz - 1);
+    uvec2 cluster = clusterBuffer.clusters[clusterCell.x + clusterBuffer.gridSize.x * (clusterCell.y + clusterBuffer.gridSize.y * clusterCell.z)];
+    for (uint i = 0; i < cluster.y; i++) {
+        PointLightData light = lightBuffer.lights[lightIndexBuffer.lightIndices[cluster.x + i]];
         vec3 pointPos = light.lightPosition.xyz;
         vec3 pointDir = normalize(pointPos - fragPos);
         float pointDist = distance(fragPos, pointPos);
-        vec4 pointColor = vec4(light.lightColor.xyz * (1/pow(pointDist, 2.0f)), light.lightColor.w);
+        //Inverse square falloff, windowed to reach zero at the light's radius so it can be left out of other clusters
+        float window = clamp(1.0f - pow(pointDist / light.lightPosition.w, 4.0f), 0.0f, 1.0f);
+        vec4 pointColor = vec4(light.lightColor.xyz * (window * window / (pointDist * pointDist)), light.lightColor.w);
         float pointCos = dot(pointDir, normal);
         vec3 pointDiffuse = max(0.0, pointCos) * pointColor.xyz;
-        vec3 pointSpecular = blinnPhong(pointDir, normal, pointColor);
-        lights += pointDiffuse + pointSpecular;
+        lights += pointDiffuse;
+        if (ENABLE_SPECULAR) {
+            lights += blinnPhong(pointDir, normal, pointColor);
+        }
     }
     color *= lights;
 
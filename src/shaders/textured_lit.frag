@@ -6,9 +6,15 @@ layout (location=2) in vec3 fragPos;
 layout (location=3) in vec3 normal;
 layout (location=4) in vec3 viewPos;
 layout (location=5) in float worldHeight;
+layout (location=6) in float viewDepth;
 
 layout (location=0) out vec4 outColor;
 
+//Specialization constants, see SpecializationConstant in vk_engine.h. The defaults are only used if a pipeline
+//doesn't set them.
+layout (constant_id = 0) const int TEXTURE_COUNT = 5;
+layout (constant_id = 2) const bool ENABLE_SPECULAR = true;
+
 layout (set=0, binding=1) uniform SceneData{
     vec4 fogColor;
     vec4 fogDistances;
@@ -22,20 +28,31 @@ struct ObjectData{
 };
 
 struct PointLightData{
-    vec4 lightPosition;
+    vec4 lightPosition; //w is the radius
     vec4 lightColor;
 };
 
-//All light matrices
-layout(std140, set = 1, binding = 1) readonly buffer LightBuffer{
+//All point lights
+layout(std430, set = 1, binding = 1) readonly buffer LightBuffer{
     PointLightData lights[];
 } lightBuffer;
 
+//The lights binned into view space clusters, see light_clusters.h
+layout(std430, set = 1, binding = 2) readonly buffer ClusterBuffer{
+    uvec4 gridSize; //clusters in x, y and z; w is the light count
+    vec4 gridParams; //tile width and height in pixels, scale and bias from log(view depth) to a depth slice
+    uvec2 clusters[]; //offset and count in lightIndices
+} clusterBuffer;
+
+layout(std430, set = 1, binding = 3) readonly buffer LightIndexBuffer{
+    uint lightIndices[];
+} lightIndexBuffer;
+
 layout(push_constant) uniform per_object {
     layout(offset=80) int texIdx;
 } texData;
 
-layout (set=2, binding=0) uniform sampler2D tex1[5];
+layout (set=2, binding=0) uniform sampler2D tex1[TEXTURE_COUNT];
 
 //Returns the specular component only
 //lightColor.w = exponent
@@ -60,22 +77,31 @@ void main() {
         vec4 sunCol = sceneData.sunlightColor;
         float sunCos = dot(sunDir, normal);
         vec3 sunDiffuse = max(0.0, sunCos) * sunCol.xyz;
-        vec3 sunSpecular = blinnPhong(sunDir, normal, sunCol);
-
-        lights += sunDiffuse + sunSpecular;
+        lights += sunDiffuse;
+        if (ENABLE_SPECULAR) {
+            lights += blinnPhong(sunDir, normal, sunCol);
+        }
     }
 
-    //Calculate dynamic lights
-    for (int i = 0; i < 0; i++) {
-        PointLightData light = lightBuffer.lights[i];
+    //Calculate dynamic lights, only the ones binned into this fragment's cluster
+    uvec3 clusterCell = uvec3(uvec2(gl_FragCoord.xy / clusterBuffer.gridParams.xy),
+                              uint(max(log(viewDepth) * clusterBuffer.gridParams.z + clusterBuffer.gridParams.w, 0.0f)));
+    clusterCell = min(clusterCell, clusterBuffer.gridSize.xyz - 1);
+    uvec2 cluster = clusterBuffer.clusters[clusterCell.x + clusterBuffer.gridSize.x * (clusterCell.y + clusterBuffer.gridSize.y * clusterCell.z)];
+    for (uint i = 0; i < cluster.y; i++) {
+        PointLightData light = lightBuffer.lights[lightIndexBuffer.lightIndices[cluster.x + i]];
         vec3 pointPos = light.lightPosition.xyz;
         vec3 pointDir = normalize(pointPos - fragPos);
         float pointDist = distance(fragPos, pointPos);
-        vec4 pointColor = vec4(light.lightColor.xyz * (1/pow(pointDist, 2.0f)), light.lightColor.w);
+        //Inverse square falloff, windowed to reach zero at the light's radius so it can be left out of other clusters
+        float window = clamp(1.0f - pow(pointDist / light.lightPosition.w, 4.0f), 0.0f, 1.0f);
+        vec4 pointColor = vec4(light.lightColor.xyz * (window * window / (pointDist * pointDist)), light.lightColor.w);
         float pointCos = dot(pointDir, normal);
         vec3 pointDiffuse = max(0.0, pointCos) * pointColor.xyz;
-        vec3 pointSpecular = blinnPhong(pointDir, normal, pointColor);
-        lights += pointDiffuse + pointSpecular;
+        lights += pointDiffuse;
+        if (ENABLE_SPECULAR) {
+            lights += blinnPhong(pointDir, normal, pointColor);
+        }
     }
     color *= lights;
 
@@ -11,6 +11,7 @@ layout (location=2) out vec3 fragPos;
 layout (location=3) out vec3 normal;
 layout (location=4) out vec3 viewPos;
 layout (location=5) out float worldHeight;
+layout (location=6) out float viewDepth;
 
 layout(push_constant) uniform constants
 {
@@ -44,4 +45,5 @@ void main() {
     viewPos = cameraData.view[3].xyz;
     vec3 worldPos = vec3(modelMatrix * vec4(vPosition, 1.0));
     worldHeight = worldPos.y;
+    viewDepth = -(cameraData.view * vec4(worldPos, 1.0f)).z;
 }
@@ -0,0 +1,89 @@
+#include "texture_streaming.h"
+
+#include <cmath>
+#include <algorithm>
+
+uint32_t TextureStreamer::addTexture(uint32_t width, uint32_t height, const std::vector<size_t> &levelSizes) {
+    StreamedTexture texture;
+    texture.levelSizes = levelSizes;
+    uint32_t lastLevel = static_cast<uint32_t>(levelSizes.size()) - 1;
+    while (texture.tailLevel < lastLevel && std::max(width >> texture.tailLevel, height >> texture.tailLevel) > STREAMING_TAIL_SIZE) {
+        texture.tailLevel++;
+    }
+    texture.residentLevel = texture.tailLevel;
+    texture.wantedLevel = texture.tailLevel;
+    texture.requestedLevel = texture.tailLevel;
+    m_textures.push_back(texture);
+    return static_cast<uint32_t>(m_textures.size() - 1);
+}
+
+size_t TextureStreamer::getSize(uint32_t texture, uint32_t level) const {
+    const auto & sizes = m_textures[texture].levelSizes;
+    size_t size = 0;
+    for (size_t i = level; i < sizes.size(); i++) {
+        size += sizes[i];
+    }
+    return size;
+}
+
+size_t TextureStreamer::getResidentSize() const {
+    size_t size = 0;
+    for (uint32_t i = 0; i < m_textures.size(); i++) {
+        size += getSize(i, m_textures[i].residentLevel);
+    }
+    return size;
+}
+
+void TextureStreamer::requestLevel(uint32_t texture, float level, uint64_t frame) {
+    StreamedTexture & streamed = m_textures[texture];
+    //Rounded down, so a texture is never magnified because it's between two levels
+    uint32_t requested = static_cast<uint32_t>(std::clamp(std::floor(level), 0.0f, static_cast<float>(streamed.tailLevel)));
+    //Coarser requests only count once the finer one is old, so levels don't flicker in and out while moving around
+    if (!streamed.requested || requested <= streamed.requestedLevel || frame - streamed.requestedFrame > STREAMING_EVICT_DELAY) {
+        streamed.requestedLevel = requested;
+        streamed.requestedFrame = frame;
+        streamed.requested = true;
+    }
+}
+
+void TextureStreamer::update(uint64_t frame) {
+    size_t total = 0;
+    for (uint32_t i = 0; i < m_textures.size(); i++) {
+        StreamedTexture & texture = m_textures[i];
+        bool recent = texture.requested && frame - texture.requestedFrame <= STREAMING_EVICT_DELAY;
+        texture.wantedLevel = recent ? texture.requestedLevel : texture.tailLevel;
+        total += getSize(i, texture.wantedLevel);
+    }
+    //Over the budget, the texture seen longest ago gives up its largest level, then the next, until it fits or only
+    //the tails are left. Ties go to the texture with the largest level to give up.
+    while (m_budget > 0 && total > m_budget) {
+        StreamedTexture * victim = nullptr;
+        for (auto & texture : m_textures) {
+            if (texture.wantedLevel >= texture.tailLevel) {
+                continue;
+            }
+            if (!victim || texture.requestedFrame < victim->requestedFrame ||
+                (texture.requestedFrame == victim->requestedFrame && texture.levelSizes[texture.wantedLevel] > victim->levelSizes[victim->wantedLevel])) {
+                victim = &texture;
+            }
+        }
+        if (!victim) {
+            break;
+        }
+        total -= victim->levelSizes[victim->wantedLevel];
+        victim->wantedLevel++;
+    }
+}
+
+std::optional<uint32_t> TextureStreamer::pickStreamIn() const {
+    std::optional<uint32_t> best;
+    uint32_t bestMissing = 0;
+    for (uint32_t i = 0; i < m_textures.size(); i++) {
+        const StreamedTexture & texture = m_textures[i];
+        if (texture.wantedLevel < texture.residentLevel && texture.residentLevel - texture.wantedLevel > bestMissing) {
+            best = i;
+            bestMissing = texture.residentLevel - texture.wantedLevel;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,68 @@
+#ifndef VKENG_TEXTURE_STREAMING_H
+#define VKENG_TEXTURE_STREAMING_H
+
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Decides which mip levels of streamed textures should be in memory. A texture always keeps its tail, the levels no
+ * bigger than STREAMING_TAIL_SIZE, which is all it's loaded with. Every frame the renderer reports the finest level
+ * each texture is seen at (from its size on screen), and the streamer picks the level each texture should have:
+ * the one it's seen at, or coarser ones while the total is over the budget, starting with the textures seen longest
+ * ago. Textures nobody has looked at for STREAMING_EVICT_DELAY frames go back to their tail.
+ * Only the bookkeeping is here; VulkanEngine reads the levels in and swaps the images.
+ */
+constexpr uint32_t STREAMING_TAIL_SIZE = 128;
+constexpr uint64_t STREAMING_EVICT_DELAY = 120;
+
+class TextureStreamer {
+public:
+    //Bytes the streamed textures may use all together, 0 for no limit
+    void setBudget(size_t bytes) { m_budget = bytes; }
+    size_t getBudget() const { return m_budget; }
+
+    //Adds a texture from the sizes of its levels, largest first. Returns its index. It starts at its tail level.
+    uint32_t addTexture(uint32_t width, uint32_t height, const std::vector<size_t> & levelSizes);
+
+    uint32_t getTailLevel(uint32_t texture) const { return m_textures[texture].tailLevel; }
+    //The first level the texture's image has
+    uint32_t getResidentLevel(uint32_t texture) const { return m_textures[texture].residentLevel; }
+    void setResidentLevel(uint32_t texture, uint32_t level) { m_textures[texture].residentLevel = level; }
+    //The first level the texture should have, as of the last update
+    uint32_t getWantedLevel(uint32_t texture) const { return m_textures[texture].wantedLevel; }
+
+    size_t getLevelSize(uint32_t texture, uint32_t level) const { return m_textures[texture].levelSizes[level]; }
+    //Bytes of the texture's levels from level down to the smallest
+    size_t getSize(uint32_t texture, uint32_t level) const;
+    size_t getResidentSize() const;
+
+    //Feedback: the texture was drawn this frame where it's sampled at level (fractional, 0 is full resolution).
+    //The finest level of the last STREAMING_EVICT_DELAY frames counts.
+    void requestLevel(uint32_t texture, float level, uint64_t frame);
+
+    //Picks the wanted level of every texture from the requests and the budget
+    void update(uint64_t frame);
+
+    //The texture that should stream in next: of those wanting finer levels than they have, the one missing the most
+    std::optional<uint32_t> pickStreamIn() const;
+
+    size_t getTextureCount() const { return m_textures.size(); }
+
+private:
+    struct StreamedTexture {
+        std::vector<size_t> levelSizes;
+        uint32_t tailLevel = 0;
+        uint32_t residentLevel = 0;
+        uint32_t wantedLevel = 0;
+        uint32_t requestedLevel = 0;
+        uint64_t requestedFrame = 0; //when requestedLevel was last seen
+        bool requested = false; //seen at all yet
+    };
+
+    std::vector<StreamedTexture> m_textures;
+    size_t m_budget = 0;
+};
+
+#endif //VKENG_TEXTURE_STREAMING_H
@@ -0,0 +1,248 @@
+#include "vk_benchmark.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+bool CameraPath::loadFromFile(const char *filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open camera path " << filename << std::endl;
+        return false;
+    }
+
+    m_keyframes.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream stream(line);
+        CameraKeyframe keyframe = {};
+        if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch)) {
+            std::cout << "Malformed keyframe on line " << lineNumber << " of " << filename << std::endl;
+            return false;
+        }
+        addKeyframe(keyframe);
+    }
+
+    std::cout << "Loaded camera path " << filename << " with " << m_keyframes.size() << " keyframes." << std::endl;
+    return !m_keyframes.empty();
+}
+
+bool CameraPath::saveToFile(const char *filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    file << "# time x y z yaw pitch" << std::endl;
+    for (const auto & k : m_keyframes) {
+        file << k.time << " " << k.position.x << " " << k.position.y << " " << k.position.z << " " << k.yaw << " " << k.pitch << std::endl;
+    }
+    return true;
+}
+
+void CameraPath::addKeyframe(const CameraKeyframe &keyframe) {
+    //Keep the keyframes sorted by time so sample() can binary search them
+    auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), keyframe.time, [](float t, const CameraKeyframe & k) {
+        return t < k.time;
+    });
+    m_keyframes.insert(it, keyframe);
+}
+
+CameraKeyframe CameraPath::sample(float time) const {
+    if (m_keyframes.empty()) {
+        return {};
+    }
+    if (time <= m_keyframes.front().time) {
+        return m_keyframes.front();
+    }
+    if (time >= m_keyframes.back().time) {
+        return m_keyframes.back();
+    }
+
+    auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time, [](float t, const CameraKeyframe & k) {
+        return t < k.time;
+    });
+    auto prev = next - 1;
+    float span = next->time - prev->time;
+    float t = span > 0.0f ? (time - prev->time) / span : 0.0f;
+
+    //Yaw wraps around at +-180 degrees, so interpolate along the shorter arc
+    float yawDelta = next->yaw - prev->yaw;
+    if (yawDelta > 180.0f) {
+        yawDelta -= 360.0f;
+    }
+    else if (yawDelta < -180.0f) {
+        yawDelta += 360.0f;
+    }
+
+    CameraKeyframe result = {};
+    result.time = time;
+    result.position = glm::mix(prev->position, next->position, t);
+    result.yaw = prev->yaw + yawDelta * t;
+    result.pitch = prev->pitch + (next->pitch - prev->pitch) * t;
+    return result;
+}
+
+float CameraPath::duration() const {
+    if (m_keyframes.empty()) {
+        return 0.0f;
+    }
+    return m_keyframes.back().time;
+}
+
+bool CameraPath::empty() const {
+    return m_keyframes.empty();
+}
+
+CameraPath CameraPath::defaultFlythrough() {
+    CameraPath path;
+    path.addKeyframe({0.0f, {0.0f, 60.0f, 10.0f}, -90.0f, -20.0f});
+    path.addKeyframe({10.0f, {0.0f, 60.0f, -300.0f}, -90.0f, -20.0f});
+    path.addKeyframe({15.0f, {0.0f, 80.0f, -350.0f}, 0.0f, -30.0f});
+    path.addKeyframe({25.0f, {300.0f, 80.0f, -350.0f}, 0.0f, -30.0f});
+    path.addKeyframe({30.0f, {350.0f, 40.0f, -300.0f}, 90.0f, -10.0f});
+    path.addKeyframe({40.0f, {350.0f, 40.0f, 0.0f}, 180.0f, -10.0f});
+    path.addKeyframe({45.0f, {300.0f, 60.0f, 10.0f}, -170.0f, -20.0f});
+    return path;
+}
+
+void BenchmarkRecorder::addFrame(const FrameStats &stats) {
+    m_frames.push_back(stats);
+}
+
+void BenchmarkRecorder::setGpuTime(uint64_t frameNumber, double gpuTimeMs) {
+    //Frames are recorded in order, so search from the back; the frame is at most a couple of entries away
+    for (auto it = m_frames.rbegin(); it != m_frames.rend(); it++) {
+        if (it->frameNumber == frameNumber) {
+            it->gpuTimeMs = gpuTimeMs;
+            return;
+        }
+        if (it->frameNumber < frameNumber) {
+            return;
+        }
+    }
+}
+
+bool BenchmarkRecorder::writeCsv(const std::string &filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    file << "frame,simulation_time,frame_ms,cpu_ms,gpu_ms,chunks_generated,chunks_deleted,draw_calls,pipeline_binds" << std::endl;
+    file << std::fixed << std::setprecision(4);
+    for (const auto & f : m_frames) {
+        file << f.frameNumber << "," << f.simulationTime << "," << f.frameTimeMs << "," << f.cpuTimeMs << "," << f.gpuTimeMs << ","
+             << f.chunksGenerated << "," << f.chunksDeleted << "," << f.drawCalls << "," << f.pipelineBinds << std::endl;
+    }
+
+    std::cout << "Wrote " << m_frames.size() << " frames to " << filename << std::endl;
+    return true;
+}
+
+static void writeSummary(std::ostream & out, const char * name, const PercentileSummary & s) {
+    out << "    \"" << name << "\": {\"min\": " << s.min << ", \"mean\": " << s.mean << ", \"p50\": " << s.p50
+        << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}";
+}
+
+void BenchmarkRecorder::setPipelineCreationTime(double ms, bool warmCache) {
+    m_pipelineCreationMs = ms;
+    m_pipelineCacheWarm = warmCache;
+}
+
+bool BenchmarkRecorder::writeJson(const std::string &filename, uint32_t warmupFrames) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    std::vector<double> frameTimes;
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<double> drawCalls;
+    uint64_t totalChunksGenerated = 0;
+    for (size_t i = warmupFrames; i < m_frames.size(); i++) {
+        const auto & f = m_frames[i];
+        frameTimes.push_back(f.frameTimeMs);
+        cpuTimes.push_back(f.cpuTimeMs);
+        if (f.gpuTimeMs >= 0.0) {
+            gpuTimes.push_back(f.gpuTimeMs);
+        }
+        drawCalls.push_back(static_cast<double>(f.drawCalls));
+        totalChunksGenerated += f.chunksGenerated;
+    }
+
+    file << std::fixed << std::setprecision(4);
+    file << "{" << std::endl;
+    file << "  \"frameCount\": " << m_frames.size() << "," << std::endl;
+    file << "  \"warmupFrames\": " << warmupFrames << "," << std::endl;
+    file << "  \"totalChunksGenerated\": " << totalChunksGenerated << "," << std::endl;
+    if (m_pipelineCreationMs >= 0.0) {
+        file << "  \"pipelineCreationMs\": " << m_pipelineCreationMs << "," << std::endl;
+        file << "  \"pipelineCacheWarm\": " << (m_pipelineCacheWarm ? "true" : "false") << "," << std::endl;
+    }
+    file << "  \"summary\": {" << std::endl;
+    writeSummary(file, "frameMs", summarize(frameTimes));
+    file << "," << std::endl;
+    writeSummary(file, "cpuMs", summarize(cpuTimes));
+    file << "," << std::endl;
+    writeSummary(file, "gpuMs", summarize(gpuTimes));
+    file << "," << std::endl;
+    writeSummary(file, "drawCalls", summarize(drawCalls));
+    file << std::endl << "  }," << std::endl;
+
+    file << "  \"frames\": [" << std::endl;
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        const auto & f = m_frames[i];
+        file << "    {\"frame\": " << f.frameNumber << ", \"time\": " << f.simulationTime << ", \"frameMs\": " << f.frameTimeMs
+             << ", \"cpuMs\": " << f.cpuTimeMs
+             << ", \"gpuMs\": " << f.gpuTimeMs << ", \"chunksGenerated\": " << f.chunksGenerated
+             << ", \"chunksDeleted\": " << f.chunksDeleted << ", \"drawCalls\": " << f.drawCalls
+             << ", \"pipelineBinds\": " << f.pipelineBinds << "}";
+        file << (i + 1 < m_frames.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl;
+    file << "}" << std::endl;
+
+    std::cout << "Wrote benchmark summary to " << filename << std::endl;
+    return true;
+}
+
+PercentileSummary BenchmarkRecorder::summarize(std::vector<double> values) {
+    PercentileSummary summary;
+    if (values.empty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+
+    //Nearest-rank method
+    auto percentile = [&](double p) {
+        auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(values.size())));
+        rank = std::clamp<size_t>(rank, 1, values.size());
+        return values[rank - 1];
+    };
+
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+
+    summary.min = values.front();
+    summary.max = values.back();
+    summary.mean = sum / static_cast<double>(values.size());
+    summary.p50 = percentile(50.0);
+    summary.p95 = percentile(95.0);
+    summary.p99 = percentile(99.0);
+    return summary;
+}
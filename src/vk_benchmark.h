@@ -0,0 +1,116 @@
+#ifndef VKENG_VK_BENCHMARK_H
+#define VKENG_VK_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+//A single camera pose on a scripted camera path.
+struct CameraKeyframe {
+    float time; //seconds since the start of the path
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+/*
+ * A camera path made of keyframes. Poses between keyframes are linearly interpolated.
+ * The text format is one keyframe per line: "time x y z yaw pitch". Lines starting with # are comments.
+ */
+class CameraPath {
+public:
+    bool loadFromFile(const char * filename);
+    bool saveToFile(const char * filename) const;
+
+    void addKeyframe(const CameraKeyframe & keyframe);
+    CameraKeyframe sample(float time) const;
+    float duration() const;
+    bool empty() const;
+
+    //Built-in flythrough used when no path file is given. Flies over the terrain while turning around.
+    static CameraPath defaultFlythrough();
+
+private:
+    std::vector<CameraKeyframe> m_keyframes;
+};
+
+//Everything we record about a single frame in benchmark mode.
+struct FrameStats {
+    uint64_t frameNumber = 0;
+    float simulationTime = 0.0f;
+    double frameTimeMs = 0.0; //wall-clock time of the whole frame
+    double cpuTimeMs = 0.0; //frame time minus the time spent blocked on fences and swap chain acquisition
+    double gpuTimeMs = -1.0; //negative if no GPU timing is available for this frame
+    uint32_t chunksGenerated = 0;
+    uint32_t chunksDeleted = 0;
+    uint32_t drawCalls = 0;
+    uint32_t pipelineBinds = 0;
+};
+
+struct BenchmarkSettings {
+    bool enabled = false;
+    std::string cameraPathFile; //empty = use CameraPath::defaultFlythrough()
+    std::string outputPrefix = "benchmark"; //writes <prefix>.csv and <prefix>.json
+    std::string recordPathFile; //if set outside benchmark mode, the live camera is recorded into this file
+    float fixedTimestep = 1.0f / 60.0f;
+    uint32_t warmupFrames = 0; //frames excluded from the percentile summary
+    bool gpuPipelineStatistics = false; //collect vertex/fragment invocation counts per material
+    std::string cpuTraceFile; //if set, CPU zones of the whole run are written here (needs VKENG_ENABLE_PROFILER)
+    std::string memoryStatsFile; //if set, periodic memory snapshots are written here on exit
+    uint32_t memoryStatsInterval = 60; //frames between memory snapshots
+    std::string captureDirectory; //if set, every captureInterval-th frame is written here as a PNG
+    uint32_t captureInterval = 1;
+    std::string captureReferenceDirectory; //if set, captures are compared against the same-named images in here
+    std::string pipelineCacheFile = "pipeline_cache.bin"; //empty = don't load or save a pipeline cache
+    uint32_t captureTolerance = 2; //per-channel difference that still counts as the same pixel
+    double captureMaxDifferingFraction = 0.001; //fraction of differing pixels before a frame fails the comparison
+    bool hotReloadShaders = true; //watch the shaders and rebuild pipelines when they change (never in benchmark mode)
+    bool dynamicRendering = true; //use vkCmdBeginRendering instead of a render pass if the device supports it
+    uint32_t pointLightCount = 256; //point lights scattered over the terrain
+    bool mipmaps = true; //generate full mip chains for loaded textures
+    float maxAnisotropy = 16.0f; //anisotropic filtering of textures, clamped to what the device supports. 1 = off.
+    bool compressedTextures = true; //load the BC compressed KTX2 versions of textures where they've been built
+    bool textureStreaming = true; //load textures with only their small mips and stream the rest in as they're seen
+    uint32_t textureBudgetMiB = 256; //memory the streamed textures may use together, 0 = no limit
+    bool transferQueue = true; //upload streamed texture levels on a dedicated transfer queue if the device has one
+    bool optimizeMeshes = true; //reorder mesh triangles and vertices for the vertex cache and less overdraw
+    bool meshCache = true; //load meshes from binary caches next to their sources, writing them on first load
+    std::string assetPackFile = "assets.pak"; //empty = load every asset from its source file
+};
+
+struct PercentileSummary {
+    double min = 0.0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+/*
+ * Collects per-frame statistics during a benchmark run and writes them out as CSV (one row per frame) and
+ * JSON (per-frame data plus percentile summaries).
+ * GPU times arrive a few frames late, so they are patched in after the fact with setGpuTime().
+ */
+class BenchmarkRecorder {
+public:
+    void addFrame(const FrameStats & stats);
+    void setGpuTime(uint64_t frameNumber, double gpuTimeMs);
+    //Startup cost of creating all pipelines, and whether the pipeline cache had data from a previous run
+    void setPipelineCreationTime(double ms, bool warmCache);
+
+    bool writeCsv(const std::string & filename) const;
+    bool writeJson(const std::string & filename, uint32_t warmupFrames) const;
+
+    const std::vector<FrameStats> & frames() const { return m_frames; }
+
+    //Nearest-rank percentile summary of the given values
+    static PercentileSummary summarize(std::vector<double> values);
+private:
+    std::vector<FrameStats> m_frames;
+    double m_pipelineCreationMs = -1.0;
+    bool m_pipelineCacheWarm = false;
+};
+
+#endif //VKENG_VK_BENCHMARK_H
@@ -102,23 +102,44 @@ void DescriptorSetLayoutCache::cleanup() {
     for (const auto& pair : m_layoutCache) {
         m_device.destroyDescriptorSetLayout(pair.second);
     }
+    m_layoutCache.clear();
 }
 
 vk::DescriptorSetLayout
 DescriptorSetLayoutCache::createDescriptorSetLayout(const vk::DescriptorSetLayoutCreateInfo &info) {
+    LayoutKey key;
+    key.flags = info.flags;
+    key.bindings.assign(info.pBindings, info.pBindings + info.bindingCount);
+    std::sort(key.bindings.begin(), key.bindings.end(), [](const vk::DescriptorSetLayoutBinding & a, const vk::DescriptorSetLayoutBinding & b) {
+        return a.binding < b.binding;
+    });
+
     //Check if binding is cached
-    auto it = m_layoutCache.find(info);
+    auto it = m_layoutCache.find(key);
     if (it != m_layoutCache.end()) {
         return it->second;
     }
     //If not, create a new one and cache it
     else {
         vk::DescriptorSetLayout layout = m_device.createDescriptorSetLayout(info);
-        m_layoutCache[info] = layout;
+        m_layoutCache[key] = layout;
         return layout;
     }
 }
 
+bool DescriptorSetLayoutCache::LayoutKey::operator==(const LayoutKey &other) const {
+    //Immutable samplers aren't used, so comparing the binding structs (which compares their pointers) is enough
+    return flags == other.flags && bindings == other.bindings;
+}
+
+size_t DescriptorSetLayoutCache::LayoutKeyHash::operator()(const LayoutKey &key) const {
+    size_t hash = std::hash<VkDescriptorSetLayoutCreateFlags>()(static_cast<VkDescriptorSetLayoutCreateFlags>(key.flags));
+    for (const auto & binding : key.bindings) {
+        hash ^= std::hash<vk::DescriptorSetLayoutBinding>()(binding) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
 DescriptorSetBuilder
 DescriptorSetBuilder::begin(DescriptorSetLayoutCache *layoutCache, DescriptorSetAllocator *allocator) {
     DescriptorSetBuilder builder;
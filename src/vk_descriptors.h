@@ -4,7 +4,7 @@
 #include <vector>
 #include <unordered_map>
 
-#include <vulkan/vulkan.hpp>
+#include "vk_types.h"
 #include <vulkan/vulkan_hash.hpp>
 
 
@@ -46,14 +46,27 @@ private:
     vk::DescriptorPool getPool();
 };
 
+//Hands out one layout per distinct set of bindings, so sets allocated for one pipeline can be bound with any other
+//pipeline using the same bindings.
 class DescriptorSetLayoutCache {
 public:
     void init(vk::Device device);
     void cleanup();
 
     vk::DescriptorSetLayout createDescriptorSetLayout(const vk::DescriptorSetLayoutCreateInfo &info);
+    size_t getLayoutCount() const { return m_layoutCache.size(); }
 private:
-    std::unordered_map<vk::DescriptorSetLayoutCreateInfo, vk::DescriptorSetLayout> m_layoutCache;
+    //The create info itself only holds a pointer to the bindings, so the cache is keyed on a copy of them
+    struct LayoutKey {
+        vk::DescriptorSetLayoutCreateFlags flags;
+        std::vector<vk::DescriptorSetLayoutBinding> bindings; //sorted by binding
+
+        bool operator==(const LayoutKey & other) const;
+    };
+    struct LayoutKeyHash {
+        size_t operator()(const LayoutKey & key) const;
+    };
+    std::unordered_map<LayoutKey, vk::DescriptorSetLayout, LayoutKeyHash> m_layoutCache;
     vk::Device m_device;
 };
 
@@ -3,6 +3,7 @@
 #include <SDL.h>
 #include <SDL_vulkan.h>
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <stb_image.h>
 
 #include <iostream>
@@ -12,9 +13,44 @@
 #include <map>
 #include <set>
 #include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <random>
 
 #include "vk_types.h"
 #include "vk_initializers.h"
+#include "cpu_profiler.h"
+#include "mip_chain.h"
+#include "image_decode.h"
+
+//Terrain layers from the lowest to the highest. Each is fully visible between its start and end height and blends
+//into the next one above that. Adding a layer only needs a texture the same size as the others.
+struct TerrainLayer {
+    const char * texture;
+    float start;
+    float end;
+};
+static const TerrainLayer TERRAIN_LAYERS[] = {
+        {"data/assets/grass.png", -std::numeric_limits<float>::infinity(), 30.0f},
+        {"data/assets/rock.png", 50.0f, 70.0f},
+        {"data/assets/snow.png", 90.0f, std::numeric_limits<float>::infinity()},
+};
+constexpr uint32_t TERRAIN_BLEND_LUT_SIZE = 256;
+//Staging memory uploads start with. Enough for a terrain and a water chunk; bigger uploads grow it.
+constexpr vk::DeviceSize UPLOAD_STAGING_SIZE = 8 * 1024 * 1024;
+
+//The heights the terrain blend lookup covers: from where the first layer starts blending to where the last one is
+//fully visible
+static void getTerrainBlendRange(float & minHeight, float & maxHeight) {
+    minHeight = TERRAIN_LAYERS[0].end;
+    maxHeight = TERRAIN_LAYERS[std::size(TERRAIN_LAYERS) - 1].start;
+}
+
+#ifdef VKENG_EMBED_SHADERS
+//Generated by pack_shaders at build time
+extern const uint32_t g_embeddedShaderArchive[];
+extern const size_t g_embeddedShaderArchiveSize;
+#endif
 
 //Global dispatch loader singleton
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
@@ -33,6 +69,13 @@ const std::vector<const char *> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+//Enabled when the device has them, but not required
+const std::vector<const char *> optionalDeviceExtensions = {
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+};
+
+const char * const MATERIAL_FILE = "data/materials.txt";
+
 static void populateDebugMessageCreateInfo(vk::DebugUtilsMessengerCreateInfoEXT & createInfo) {
     createInfo.setMessageSeverity(vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose | vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning | vk::DebugUtilsMessageSeverityFlagBitsEXT::eError);
     createInfo.setMessageType(vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral | vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation | vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance);
@@ -41,6 +84,16 @@ static void populateDebugMessageCreateInfo(vk::DebugUtilsMessengerCreateInfoEXT
 }
 
 void VulkanEngine::init() {
+    PROFILE_THREAD_NAME("main");
+#ifdef VKENG_ENABLE_PROFILER
+    if (!m_benchmarkSettings.cpuTraceFile.empty()) {
+        CpuProfiler::startCapture();
+    }
+#else
+    if (!m_benchmarkSettings.cpuTraceFile.empty()) {
+        std::cout << "CPU tracing requested, but the engine was built without VKENG_ENABLE_PROFILER." << std::endl;
+    }
+#endif
     //Initialize SDL window
     SDL_Init(SDL_INIT_VIDEO);
     SDL_WindowFlags window_flags = static_cast<SDL_WindowFlags>(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
@@ -63,11 +116,30 @@ void VulkanEngine::init() {
 
     initVulkan();
 
+    //Worker threads for pipeline compilation and asset loading
+    m_jobSystem.init();
+
     createSyncStructures();
 
+    createTextureUploadContext();
+
+    createProfiler();
+
+    createFrameCapture();
+
+    loadAssetPack();
+
+    loadShaderArchive();
+
     createDescriptors();
 
+    createPipelineCache();
+
     createPipelines();
+    //Benchmarks report how long the pipelines took, so they get the job system to themselves there
+    if (m_benchmarkSettings.enabled) {
+        waitForPipelines();
+    }
 
     loadMeshes();
 
@@ -75,6 +147,8 @@ void VulkanEngine::init() {
 
     initScene();
 
+    startShaderHotReload();
+
     m_isInitialized = true;
 }
 
@@ -83,11 +157,19 @@ void VulkanEngine::cleanup() {
         //Wait for the device to finish rendering before cleaning up
         m_vkDevice.waitIdle();
 
+        //Pipelines still being built would otherwise leak
+        m_shaderWatcher.stop();
+        waitForPipelines();
+        destroyRetiredPipelines(true);
+        m_jobSystem.shutdown();
+
         //Delete terrain
         deleteAllTerrainChunks();
 
-        //Destroy all objects in the deletion queues
-        getCurrentFrame().frameDeletionQueue.flush();
+        //Destroy all objects in the deletion queues. Both frames' queues can hold replaced textures.
+        for (auto & frame : m_frames) {
+            frame.frameDeletionQueue.flush();
+        }
         m_sceneDeletionQueue.flush();
         m_pipelineDeletionQueue.flush();
         m_mainDeletionQueue.flush();
@@ -106,6 +188,10 @@ void VulkanEngine::cleanup() {
     }
 }
 
+void VulkanEngine::configureBenchmark(const BenchmarkSettings &settings) {
+    m_benchmarkSettings = settings;
+}
+
 void VulkanEngine::run() {
     SDL_Event e;
     bool bQuit = false;
@@ -114,8 +200,32 @@ void VulkanEngine::run() {
     SDL_SetRelativeMouseMode(SDL_TRUE);
     int mouse_x = 0;
     int mouse_y = 0;
+
+    //In benchmark mode the camera follows a scripted path and the simulation advances with a fixed timestep,
+    //so every run renders exactly the same sequence of frames regardless of how fast they are drawn.
+    const bool benchmark = m_benchmarkSettings.enabled;
+    if (benchmark) {
+        if (m_benchmarkSettings.cameraPathFile.empty() || !m_cameraPath.loadFromFile(m_benchmarkSettings.cameraPathFile.c_str())) {
+            std::cout << "Using the default benchmark flythrough." << std::endl;
+            m_cameraPath = CameraPath::defaultFlythrough();
+        }
+        std::cout << "Running benchmark: " << m_cameraPath.duration() << " s at a fixed timestep of "
+                  << m_benchmarkSettings.fixedTimestep << " s" << std::endl;
+        //Every frame has to be drawn with every material, or runs wouldn't be comparable
+        waitForPipelines();
+    }
+
+    //Outside benchmark mode the live camera can be recorded into a path file for later replay
+    const bool recordPath = !benchmark && !m_benchmarkSettings.recordPathFile.empty();
+    const float recordInterval = 0.1f;
+    float lastRecordTime = -recordInterval;
+    CameraPath recordedPath;
+
     while (!bQuit) {
         auto start = std::chrono::high_resolution_clock::now();
+        m_frameStats = {};
+        m_frameStats.frameNumber = m_frameNumber;
+        m_frameStats.simulationTime = m_simulationTime;
         while (SDL_PollEvent(&e)) {
             if (e.type == SDL_QUIT) {
                 bQuit = true;
@@ -129,6 +239,41 @@ void VulkanEngine::run() {
                         m_selectedShader = 0;
                     }
                 }
+                else if (e.key.keysym.scancode == SDL_SCANCODE_F1) {
+                    m_gpuProfiler.printSummary();
+                }
+                else if (e.key.keysym.scancode == SDL_SCANCODE_F12) {
+                    m_frameCapture.requestScreenshot("screenshot_" + std::to_string(m_frameNumber) + ".png");
+                }
+                else if (e.key.keysym.scancode == SDL_SCANCODE_F6) {
+                    ShaderFeatures features = m_shaderFeatures;
+                    features.specular = !features.specular;
+                    std::cout << "Specular highlights " << (features.specular ? "on" : "off") << std::endl;
+                    setShaderFeatures(features);
+                }
+                else if (e.key.keysym.scancode == SDL_SCANCODE_F7) {
+                    ShaderFeatures features = m_shaderFeatures;
+                    features.terrainBlending = !features.terrainBlending;
+                    std::cout << "Terrain band blending " << (features.terrainBlending ? "on" : "off") << std::endl;
+                    setShaderFeatures(features);
+                }
+                else if (e.key.keysym.scancode == SDL_SCANCODE_F3) {
+                    m_memoryTelemetry.printSummary(m_frameNumber);
+                    m_memoryTelemetry.writeJson("memory_snapshot.json", m_frameNumber);
+                }
+#ifdef VKENG_ENABLE_PROFILER
+                else if (e.key.keysym.scancode == SDL_SCANCODE_F2) {
+                    //F2 starts a CPU trace capture, pressing it again writes it out
+                    if (CpuProfiler::isCapturing()) {
+                        CpuProfiler::stopCapture();
+                        CpuProfiler::writeChromeTrace("cpu_trace.json");
+                    }
+                    else {
+                        std::cout << "Capturing CPU trace, press F2 again to stop." << std::endl;
+                        CpuProfiler::startCapture();
+                    }
+                }
+#endif
             }
             else if (e.type == SDL_WINDOWEVENT) {
                 if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
@@ -140,33 +285,109 @@ void VulkanEngine::run() {
                     m_framebufferResized = true;
                 }
             }
-            else if (e.type == SDL_MOUSEMOTION) {
+            else if (e.type == SDL_MOUSEMOTION && !benchmark) {
                 if (e.motion.windowID == SDL_GetWindowID(m_sdlWindow)) {
                     m_camera.processMouseMovement((float)e.motion.xrel, (float)e.motion.yrel);
                 }
             }
         }
-        m_camera.processKeyboard(timeDelta);
+
+        if (benchmark) {
+            auto pose = m_cameraPath.sample(m_simulationTime);
+            m_camera.setPose(pose.position, pose.yaw, pose.pitch);
+        }
+        else {
+            m_camera.processKeyboard(timeDelta);
+        }
+
+        if (recordPath && m_simulationTime - lastRecordTime >= recordInterval) {
+            recordedPath.addKeyframe({m_simulationTime, m_camera.m_position, m_camera.m_yaw, m_camera.m_pitch});
+            lastRecordTime = m_simulationTime;
+        }
 
         draw();
+        PROFILE_COLLECT();
+        m_memoryTelemetry.update(m_frameNumber);
         auto end = std::chrono::high_resolution_clock::now();
         auto elapsedTime = std::chrono::duration_cast<std::chrono::duration<float>>(end - start).count();
-        timeDelta = elapsedTime;
-        m_simulationTime += elapsedTime;
+
+        if (benchmark) {
+            m_frameStats.frameTimeMs = elapsedTime * 1000.0;
+            m_frameStats.cpuTimeMs += m_frameStats.frameTimeMs; //holds minus the blocked time so far
+            m_benchmarkRecorder.addFrame(m_frameStats);
+
+            timeDelta = m_benchmarkSettings.fixedTimestep;
+            if (m_simulationTime >= m_cameraPath.duration()) {
+                bQuit = true;
+            }
+        }
+        else {
+            timeDelta = elapsedTime;
+        }
+        m_simulationTime += timeDelta;
+    }
+
+    if (benchmark) {
+        //Pick up the GPU times of the frames still in flight
+        m_vkDevice.waitIdle();
+        for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            collectGpuTimings(i);
+        }
+        m_benchmarkRecorder.writeCsv(m_benchmarkSettings.outputPrefix + ".csv");
+        m_benchmarkRecorder.writeJson(m_benchmarkSettings.outputPrefix + ".json", m_benchmarkSettings.warmupFrames);
+        m_gpuProfiler.writeJson(m_benchmarkSettings.outputPrefix + "_gpu.json");
+        m_memoryTelemetry.writeJson(m_benchmarkSettings.outputPrefix + "_memory.json", m_frameNumber);
+    }
+    finishCaptures();
+    if (!m_benchmarkSettings.memoryStatsFile.empty()) {
+        m_memoryTelemetry.writeHistoryJson(m_benchmarkSettings.memoryStatsFile);
+    }
+#ifdef VKENG_ENABLE_PROFILER
+    if (!m_benchmarkSettings.cpuTraceFile.empty()) {
+        CpuProfiler::stopCapture();
+        CpuProfiler::writeChromeTrace(m_benchmarkSettings.cpuTraceFile);
+    }
+#endif
+    if (recordPath) {
+        recordedPath.addKeyframe({m_simulationTime, m_camera.m_position, m_camera.m_yaw, m_camera.m_pitch});
+        if (recordedPath.saveToFile(m_benchmarkSettings.recordPathFile.c_str())) {
+            std::cout << "Saved camera path to " << m_benchmarkSettings.recordPathFile << std::endl;
+        }
     }
 }
 
 void VulkanEngine::draw() {
+    PROFILE_FUNCTION();
     FrameData& frame = getCurrentFrame();
 
     //Wait until the GPU has rendered the previous frame, with a timeout of 1 second.
-    auto waitResult = m_vkDevice.waitForFences(frame.inFlightFence, true, S_TO_NS(1));
-    if (waitResult == vk::Result::eTimeout) {
-        std::cout << "Waiting for fences timed out!" << std::endl;
+    auto waitStart = std::chrono::high_resolution_clock::now();
+    {
+        PROFILE_ZONE("waitForFence");
+        auto waitResult = m_vkDevice.waitForFences(frame.inFlightFence, true, S_TO_NS(1));
+        if (waitResult == vk::Result::eTimeout) {
+            std::cout << "Waiting for fences timed out!" << std::endl;
+        }
+    }
+
+    //The frame that last used this slot has retired, so its GPU timings can be read without stalling
+    collectGpuTimings(m_frameNumber % FRAMES_IN_FLIGHT);
+    //Same for a frame captured in this slot
+    m_frameCapture.resolve(m_frameNumber % FRAMES_IN_FLIGHT);
+
+    //Pipelines replaced by a shader reload can go once the frames that used them are done
+    destroyRetiredPipelines(false);
+
+    //Start rebuilding pipelines for shaders that changed, and pick up pipelines that finished building since the last frame
+    if (m_hotReloadEnabled) {
+        reloadChangedShaders();
     }
+    installCompiledPipelines();
 
     //Request image from swapchain with one second timeout.
     auto [nextImageResult, swapChainImgIndex] = m_vkDevice.acquireNextImageKHR(m_swapChain, S_TO_NS(1), frame.imageAvailableSemaphore);
+    auto waitEnd = std::chrono::high_resolution_clock::now();
+    m_frameStats.cpuTimeMs -= std::chrono::duration<double, std::milli>(waitEnd - waitStart).count();
     if (nextImageResult == vk::Result::eErrorOutOfDateKHR) {
         recreateSwapChain();
         return;
@@ -192,33 +413,44 @@ void VulkanEngine::draw() {
 
     cmd.begin(cmdBeginInfo);
 
-    //Clear screen to black
-    vk::ClearValue clearValue = {};
-    const std::array<float, 4> cols = {0.0f, 0.0f, 0.0f, 1.0f};
-    clearValue.color = {cols};
-
-    //Clear depth buffer
-    vk::ClearValue depthClear = {};
-    depthClear.depthStencil.depth = 1.0f;
-
-    //Start the main render pass
-    vk::RenderPassBeginInfo rpInfo = {};
-    rpInfo.renderPass = m_renderPass;
-    rpInfo.renderArea.offset.x = 0;
-    rpInfo.renderArea.offset.y = 0;
-    rpInfo.renderArea.extent = m_swapChainExtent;
-    rpInfo.framebuffer = m_swapChainFramebuffers[swapChainImgIndex];
-
-    //connect clear values
-    rpInfo.clearValueCount = 2;
-    vk::ClearValue clearValues[2] = {clearValue, depthClear};
-    rpInfo.pClearValues = &clearValues[0];
+    //Texture swaps are recorded before rendering, which samples the new images
+    vk::Semaphore textureUploadSemaphore = updateTextureStreaming(frame, cmd);
 
+    m_gpuProfiler.beginFrame(cmd, m_frameNumber % FRAMES_IN_FLIGHT, m_frameNumber);
+    auto frameZone = m_gpuProfiler.beginZone(cmd, "frame");
 
     //
     //Render commands go here
     //
-    cmd.beginRenderPass(rpInfo, vk::SubpassContents::eInline);
+    if (m_dynamicRenderingEnabled) {
+        beginDynamicRendering(cmd, swapChainImgIndex);
+    }
+    else {
+        //Clear screen to black
+        vk::ClearValue clearValue = {};
+        const std::array<float, 4> cols = {0.0f, 0.0f, 0.0f, 1.0f};
+        clearValue.color = {cols};
+
+        //Clear depth buffer
+        vk::ClearValue depthClear = {};
+        depthClear.depthStencil.depth = 1.0f;
+
+        //Start the main render pass
+        vk::RenderPassBeginInfo rpInfo = {};
+        rpInfo.renderPass = m_renderPass;
+        rpInfo.renderArea.offset.x = 0;
+        rpInfo.renderArea.offset.y = 0;
+        rpInfo.renderArea.extent = m_swapChainExtent;
+        rpInfo.framebuffer = m_swapChainFramebuffers[swapChainImgIndex];
+
+        //connect clear values
+        rpInfo.clearValueCount = 2;
+        vk::ClearValue clearValues[2] = {clearValue, depthClear};
+        rpInfo.pClearValues = &clearValues[0];
+
+        cmd.beginRenderPass(rpInfo, vk::SubpassContents::eInline);
+    }
+    auto renderPassZone = m_gpuProfiler.beginZone(cmd, "renderpass");
 
     //Concatenate renderables with terrain renderables
     std::vector<RenderObject> allRenderables;
@@ -233,16 +465,34 @@ void VulkanEngine::draw() {
 
 
     //Finalize the render pass
-    cmd.endRenderPass();
+    m_gpuProfiler.endZone(cmd, renderPassZone);
+    if (m_dynamicRenderingEnabled) {
+        endDynamicRendering(cmd, swapChainImgIndex);
+    }
+    else {
+        cmd.endRenderPass();
+    }
+    if (m_captureSupported && m_frameCapture.shouldCapture(m_frameNumber)) {
+        m_frameCapture.recordCopy(cmd, m_frameNumber % FRAMES_IN_FLIGHT, m_frameNumber, m_swapChainImages[swapChainImgIndex],
+                                  m_swapChainExtent, m_swapChainImageFormat);
+    }
+    m_gpuProfiler.endZone(cmd, frameZone);
+
     //Finalize the command buffer (can no longer add commands, but it can be executed)
     cmd.end();
 
 
     //Submit command buffer to GPU
     vk::SubmitInfo submitInfo = {};
-    vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-    submitInfo.pWaitDstStageMask = &waitStage;
-    submitInfo.setWaitSemaphores(frame.imageAvailableSemaphore);
+    std::vector<vk::Semaphore> waitSemaphores = {frame.imageAvailableSemaphore};
+    std::vector<vk::PipelineStageFlags> waitStages = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
+    if (textureUploadSemaphore) {
+        //The upload is already done, so this doesn't hold anything up
+        waitSemaphores.push_back(textureUploadSemaphore);
+        waitStages.push_back(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eFragmentShader);
+    }
+    submitInfo.setWaitSemaphores(waitSemaphores);
+    submitInfo.setWaitDstStageMask(waitStages);
     submitInfo.setSignalSemaphores(frame.renderFinishedSemaphore);
     submitInfo.setCommandBuffers(cmd);
 
@@ -268,14 +518,17 @@ void VulkanEngine::draw() {
 }
 
 void VulkanEngine::drawObjects(vk::CommandBuffer cmd, RenderObject *first, int count) {
+    PROFILE_FUNCTION();
 //    glm::vec3 camPos = {0.0f, 0.0f, -10.0f};
 //    glm::mat4 view = glm::translate(glm::mat4(1.0f), camPos);
 //    float aspect = static_cast<float>(m_windowExtent.width) / static_cast<float>(m_windowExtent.height);
 //    glm::mat4 projection = glm::perspective(glm::radians(70.0f), aspect, 0.1f, 200.0f);
 //    projection[1][1] *= -1;
 
+    const float nearPlane = 0.1f;
+    const float farPlane = 200.0f;
     float aspect = static_cast<float>(m_windowExtent.width) / static_cast<float>(m_windowExtent.height);
-    glm::mat4 projection = glm::perspective(glm::radians(m_camera.m_fov), aspect, 0.1f, 200.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(m_camera.m_fov), aspect, nearPlane, farPlane);
     projection[1][1] *= -1;
     glm::mat4 view = m_camera.getViewMatrix();
 
@@ -310,40 +563,43 @@ void VulkanEngine::drawObjects(vk::CommandBuffer cmd, RenderObject *first, int c
     memcpy(sceneData, &m_sceneParameters, sizeof(GPUSceneData));
     m_allocator.unmapMemory(m_sceneParameterBuffer.allocation);
 
-    //Create point lights and copy them into GPU memory
-//    float posMod = (sin(uTime) + 1.0f) / 2.0f * 10.0f;
-//    std::array<PointLightData, 3> pointLights = {};
-//    pointLights[0] = {{-3.0f - posMod/2, 3.0f, -0.0f - posMod, 32.0f}, {10.0f, 0.0f, 0.0f, 32.0f}};
-//    pointLights[1] = {{-2.0f, 3.0f, -0.0f - posMod, 32.0f}, {0.0f, 10.0f, 0.0f, 32.0f}};
-//    pointLights[2] = {{-1.0f + posMod/2, 3.0f, -0.0f - posMod, 32.0f}, {0.0f, 0.0f, 10.0f, 32.0f}};
-//    PointLightData* pointLightSSBO = static_cast<PointLightData *>(m_allocator.mapMemory(curFrame.lightBuffer.allocation));
-//    std::copy(pointLights.begin(), pointLights.end(), pointLightSSBO);
-//    m_allocator.unmapMemory(curFrame.lightBuffer.allocation);
+    //Move the point lights, bin them into clusters and copy both into GPU memory
+    updatePointLights(getCurrentFrame(), view, projection, nearPlane, farPlane);
 
     //Copy object matrices into storage buffer
     GPUObjectData* objectSSBO = static_cast<GPUObjectData *>(m_allocator.mapMemory(curFrame.objectBuffer.allocation)); //unmapped after the object loop
 
     Mesh* lastMesh = nullptr;
-    Material* lastMaterial = nullptr;
+    MaterialHandle lastMaterial = INVALID_MATERIAL;
+    //Materials sharing a pipeline, layout or texture set don't rebind it
+    vk::Pipeline lastPipeline;
+    vk::PipelineLayout lastLayout;
+    std::optional<vk::DescriptorSet> lastTextureSet;
+    //Each run of objects sharing a material is timed as one batch
+    uint32_t batchZone = GpuProfiler::INVALID_ZONE;
 
     //TODO: sort array by pipeline pointer to reduce number of binds, maybe?
     for (int i = 0; i < count; i++) {
         RenderObject& object = first[i];
         objectSSBO[i].modelMatrix = object.transformMatrix;
 
-        //Only bind the pipeline if it doesn't match the already bound one
+        //The material's pipeline may still be building
+        const Material & material = m_materials[object.material];
+        if (!material.pipeline) {
+            continue;
+        }
+
         if (object.material != lastMaterial) {
-            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, object.material->pipeline);
+            m_gpuProfiler.endZone(cmd, batchZone);
+            batchZone = m_gpuProfiler.beginZone(cmd, "material:" + material.name, true);
             lastMaterial = object.material;
-            //Bind the camera data descriptor set when changing pipeline
-            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, object.material->pipelineLayout, 0, curFrame.globalDescriptor, uniformOffset);
-            //Bind the object descriptor set too
-            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, object.material->pipelineLayout, 1, curFrame.objectDescriptor, nullptr);
+        }
 
-            //Bind the texture descriptor set, if relevant
-            if (object.material->textureSet.has_value()) {
-                cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, object.material->pipelineLayout, 2, object.material->textureSet.value(), nullptr);
-            }
+        //Only bind the pipeline if it doesn't match the already bound one
+        if (material.pipeline != lastPipeline) {
+            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, material.pipeline);
+            m_frameStats.pipelineBinds++;
+            lastPipeline = material.pipeline;
 
             //Update viewport and scissor
             vk::Viewport viewport = {};
@@ -362,34 +618,52 @@ void VulkanEngine::drawObjects(vk::CommandBuffer cmd, RenderObject *first, int c
             cmd.setScissor(0, scissor);
         }
 
-        MeshPushConstants constants;
-        constants.renderMatrix = object.transformMatrix;
-        cmd.pushConstants(object.material->pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(MeshPushConstants), &constants);
+        if (material.pipelineLayout != lastLayout) {
+            //Bind the camera data descriptor set when changing layout
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material.pipelineLayout, 0, curFrame.globalDescriptor, uniformOffset);
+            //Bind the object descriptor set too
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material.pipelineLayout, 1, curFrame.objectDescriptor, nullptr);
+            lastLayout = material.pipelineLayout;
+            lastTextureSet.reset();
+        }
+
+        //Bind the texture descriptor set, if relevant
+        if (material.textureSet.has_value() && material.textureSet != lastTextureSet) {
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, material.pipelineLayout, material.textureSetIndex, material.textureSet.value(), nullptr);
+            lastTextureSet = material.textureSet;
+        }
 
-        //Push texIdx if the material is textured
-        if (object.material->textureSet.has_value()) {
+        //Only push what the material's shaders read
+        if (material.meshConstantStages) {
+            MeshPushConstants constants;
+            constants.renderMatrix = object.transformMatrix;
+            cmd.pushConstants(material.pipelineLayout, material.meshConstantStages, 0, sizeof(MeshPushConstants), &constants);
+        }
+        if (material.textureIndexStages) {
             int texIdx = static_cast<int>(object.textureId);
-            cmd.pushConstants(object.material->pipelineLayout, vk::ShaderStageFlagBits::eFragment, sizeof(MeshPushConstants), sizeof(int), &texIdx);
+            cmd.pushConstants(material.pipelineLayout, material.textureIndexStages, sizeof(MeshPushConstants), sizeof(int), &texIdx);
         }
 
         //Only bind the mesh if it doesn't match the already bound one
         if (object.mesh != lastMesh) {
             vk::DeviceSize offset = 0;
             cmd.bindVertexBuffers(0, 1, &object.mesh->vertexBuffer.buffer, &offset);
-            if (!object.mesh->indices.empty()) {
+            if (object.mesh->indexCount > 0) {
                 cmd.bindIndexBuffer(object.mesh->indexBuffer.buffer, 0, vk::IndexType::eUint16);
             }
             lastMesh = object.mesh;
         }
 
-        if (object.mesh->indices.empty()) {
-            cmd.draw(object.mesh->vertices.size(), 1, 0,
+        if (object.mesh->indexCount == 0) {
+            cmd.draw(object.mesh->vertexCount, 1, 0,
                      i); //FIXME: we're hackily using the firstInstance parameter here to pass instance index to the shader, and I do not like it.
         }
         else {
-            cmd.drawIndexed(object.mesh->indices.size(), 1, 0, 0, i);
+            cmd.drawIndexed(object.mesh->indexCount, 1, 0, 0, i);
         }
+        m_frameStats.drawCalls++;
     }
+    m_gpuProfiler.endZone(cmd, batchZone);
 
     m_allocator.unmapMemory(curFrame.objectBuffer.allocation);
 }
@@ -529,6 +803,10 @@ void VulkanEngine::createLogicalDevice() {
 
     std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    bool useTransferQueue = m_benchmarkSettings.transferQueue && indices.transferFamily.has_value();
+    if (useTransferQueue) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
 
     float queuePriority = 1.0f; //FIXME: this seems dodgy
     for (uint32_t queueFamily: uniqueQueueFamilies) {
@@ -542,9 +820,27 @@ void VulkanEngine::createLogicalDevice() {
     //Specify used device features
     vk::PhysicalDeviceFeatures2 deviceFeatures = {};
     deviceFeatures.features.geometryShader = VK_TRUE;
+    //Pipeline statistics queries are optional and only enabled on request
+    m_pipelineStatisticsSupported = m_benchmarkSettings.gpuPipelineStatistics && m_activeGPU.getFeatures().pipelineStatisticsQuery;
+    deviceFeatures.features.pipelineStatisticsQuery = m_pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+    m_samplerAnisotropyEnabled = m_benchmarkSettings.maxAnisotropy > 1.0f && m_activeGPU.getFeatures().samplerAnisotropy;
+    deviceFeatures.features.samplerAnisotropy = m_samplerAnisotropyEnabled ? VK_TRUE : VK_FALSE;
+    m_textureCompressionBCEnabled = m_benchmarkSettings.compressedTextures && m_activeGPU.getFeatures().textureCompressionBC;
+    deviceFeatures.features.textureCompressionBC = m_textureCompressionBCEnabled ? VK_TRUE : VK_FALSE;
     vk::PhysicalDeviceVulkan11Features vk11Features = {};
     deviceFeatures.pNext = &vk11Features;
     vk11Features.shaderDrawParameters = VK_TRUE;
+    //Dynamic rendering is core in 1.3, but the feature still has to be enabled, and the device might only do 1.2
+    vk::PhysicalDeviceVulkan13Features vk13Features = {};
+    m_dynamicRenderingEnabled = false;
+    if (m_benchmarkSettings.dynamicRendering && m_activeGPU.getProperties().apiVersion >= VK_API_VERSION_1_3) {
+        auto supported = m_activeGPU.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features>();
+        m_dynamicRenderingEnabled = supported.get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering;
+    }
+    if (m_dynamicRenderingEnabled) {
+        vk13Features.dynamicRendering = VK_TRUE;
+        vk11Features.pNext = &vk13Features;
+    }
 
     //Actually create the logical device
     vk::DeviceCreateInfo createInfo = {};
@@ -552,8 +848,21 @@ void VulkanEngine::createLogicalDevice() {
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pNext = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    std::vector<const char *> enabledExtensions = deviceExtensions;
+    auto availableExtensions = m_activeGPU.enumerateDeviceExtensionProperties();
+    for (const char * ext : optionalDeviceExtensions) {
+        bool available = std::any_of(availableExtensions.begin(), availableExtensions.end(), [&](const vk::ExtensionProperties & props) {
+            return strcmp(props.extensionName, ext) == 0;
+        });
+        if (available) {
+            enabledExtensions.push_back(ext);
+        }
+        if (strcmp(ext, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            m_memoryBudgetSupported = available;
+        }
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
         createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -564,8 +873,14 @@ void VulkanEngine::createLogicalDevice() {
     m_vkDevice = m_activeGPU.createDevice(createInfo);
     m_graphicsQueue = m_vkDevice.getQueue(indices.graphicsFamily.value(), 0);
     m_presentQueue = m_vkDevice.getQueue(indices.presentFamily.value(), 0);
+    m_textureUpload.graphicsFamily = indices.graphicsFamily.value();
+    m_textureUpload.queueFamily = useTransferQueue ? indices.transferFamily.value() : indices.graphicsFamily.value();
+    m_textureUpload.queue = m_vkDevice.getQueue(m_textureUpload.queueFamily, 0);
 
     std::cout << "Created logical device " << m_vkDevice << "." << std::endl;
+    if (useTransferQueue) {
+        std::cout << "Streamed textures are uploaded on the transfer queue family " << m_textureUpload.queueFamily << "." << std::endl;
+    }
 }
 
 void VulkanEngine::createSwapChain() {
@@ -593,6 +908,11 @@ void VulkanEngine::createSwapChain() {
         createInfo.imageArrayLayers = 1;
         //This flag means we render directly to the images, as opposed to some other image as we might if we were doing post-processing (see: vk::ImageUsageFlagBits::eTransferDst)
         createInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+        //Frame captures copy out of the swap chain images
+        m_captureSupported = static_cast<bool>(swapChainSupport.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+        if (m_captureSupported) {
+            createInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+        }
 
         QueueFamilyIndices indices = findQueueFamilies(m_activeGPU);
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -671,9 +991,7 @@ void VulkanEngine::createSwapChain() {
         depthAllocInfo.requiredFlags = vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
 
         //Allocate and create the depth buffer image
-        auto imagePair = m_allocator.createImage(depthImgInfo, depthAllocInfo);
-        m_depthImage.image = imagePair.first;
-        m_depthImage.allocation = imagePair.second;
+        m_depthImage = createImage(depthImgInfo, depthAllocInfo, MemoryCategory::RenderTargets);
 
         vk::ImageViewCreateInfo depthViewInfo = vkinit::imageViewCreateInfo(m_depthFormat, m_depthImage.image,
                                                                             vk::ImageAspectFlagBits::eDepth);
@@ -695,9 +1013,7 @@ void VulkanEngine::createSwapChain() {
         colorAllocInfo.usage = vma::MemoryUsage::eGpuOnly;
         colorAllocInfo.requiredFlags = vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
 
-        auto imagePair = m_allocator.createImage(colorImgInfo, colorAllocInfo);
-        m_colorImage.image = imagePair.first;
-        m_colorImage.allocation = imagePair.second;
+        m_colorImage = createImage(colorImgInfo, colorAllocInfo, MemoryCategory::RenderTargets);
 
         vk::ImageViewCreateInfo colorViewInfo = vkinit::imageViewCreateInfo(m_colorFormat, m_colorImage.image, vk::ImageAspectFlagBits::eColor);
         m_colorImageView = m_vkDevice.createImageView(colorViewInfo);
@@ -859,6 +1175,152 @@ void VulkanEngine::createFramebuffers() {
     std::cout << "Initialized " << m_swapChainFramebuffers.size() << " framebuffers." << std::endl;
 }
 
+void VulkanEngine::beginDynamicRendering(vk::CommandBuffer cmd, uint32_t swapChainImgIndex) {
+    //Without MSAA there's nothing to resolve, so the pipelines render straight into the swap chain image
+    bool resolve = m_msaaSamples != vk::SampleCountFlagBits::e1;
+
+    //Previous contents are cleared anyway, so all images start from undefined. The source stages wait for the
+    //previous frame's attachment writes, like the render pass's external subpass dependencies.
+    vk::ImageMemoryBarrier swapChainBarrier = {};
+    swapChainBarrier.oldLayout = vk::ImageLayout::eUndefined;
+    swapChainBarrier.newLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    swapChainBarrier.srcAccessMask = vk::AccessFlagBits::eNone;
+    swapChainBarrier.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+    swapChainBarrier.image = m_swapChainImages[swapChainImgIndex];
+    swapChainBarrier.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+
+    vk::ImageMemoryBarrier colorBarrier = swapChainBarrier;
+    colorBarrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+    colorBarrier.image = m_colorImage.image;
+
+    vk::ImageMemoryBarrier depthBarrier = {};
+    depthBarrier.oldLayout = vk::ImageLayout::eUndefined;
+    //Not eDepthAttachmentOptimal, which would need separateDepthStencilLayouts enabled
+    depthBarrier.newLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depthBarrier.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    depthBarrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    depthBarrier.image = m_depthImage.image;
+    depthBarrier.subresourceRange = {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1};
+
+    std::vector<vk::ImageMemoryBarrier> barriers = {swapChainBarrier, depthBarrier};
+    if (resolve) {
+        barriers.push_back(colorBarrier);
+    }
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests,
+                        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                        {}, nullptr, nullptr, barriers);
+
+    //Clear to black, resolving the MSAA image into the swap chain image at the end. The MSAA image itself
+    //isn't needed after the resolve, so it isn't stored.
+    vk::RenderingAttachmentInfo colorAttachment = {};
+    colorAttachment.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+    colorAttachment.clearValue.color = std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f};
+    if (resolve) {
+        colorAttachment.imageView = m_colorImageView;
+        colorAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+        colorAttachment.resolveMode = vk::ResolveModeFlagBits::eAverage;
+        colorAttachment.resolveImageView = m_swapChainImageViews[swapChainImgIndex];
+        colorAttachment.resolveImageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    }
+    else {
+        colorAttachment.imageView = m_swapChainImageViews[swapChainImgIndex];
+        colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+    }
+
+    vk::RenderingAttachmentInfo depthAttachment = {};
+    depthAttachment.imageView = m_depthImageView;
+    depthAttachment.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+    depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+    depthAttachment.clearValue.depthStencil.depth = 1.0f;
+
+    vk::RenderingInfo renderingInfo = {};
+    renderingInfo.renderArea.offset = vk::Offset2D{0, 0};
+    renderingInfo.renderArea.extent = m_swapChainExtent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.setColorAttachments(colorAttachment);
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    cmd.beginRendering(renderingInfo);
+}
+
+void VulkanEngine::endDynamicRendering(vk::CommandBuffer cmd, uint32_t swapChainImgIndex) {
+    cmd.endRendering();
+
+    //The render pass's final layout transition. Presentation is ordered by the render finished semaphore; the
+    //destination stage is only there so a frame capture's barrier (which waits on color output) comes after this one.
+    vk::ImageMemoryBarrier presentBarrier = {};
+    presentBarrier.oldLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    presentBarrier.newLayout = vk::ImageLayout::ePresentSrcKHR;
+    presentBarrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+    presentBarrier.dstAccessMask = vk::AccessFlagBits::eNone;
+    presentBarrier.image = m_swapChainImages[swapChainImgIndex];
+    presentBarrier.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                        {}, nullptr, nullptr, presentBarrier);
+}
+
+void VulkanEngine::createProfiler() {
+    auto graphicsFamily = findQueueFamilies(m_activeGPU).graphicsFamily.value();
+    m_gpuProfiler.init(m_vkDevice, m_activeGPU, graphicsFamily, FRAMES_IN_FLIGHT, m_pipelineStatisticsSupported);
+    m_mainDeletionQueue.pushFunction([=]() {
+        m_gpuProfiler.cleanup();
+    });
+}
+
+//Reads back the GPU timings of a retired frame. Never waits; results that aren't available yet are dropped.
+void VulkanEngine::collectGpuTimings(uint32_t frameSlot) {
+    if (!m_gpuProfiler.resolveFrame(frameSlot)) {
+        return;
+    }
+    if (m_benchmarkSettings.enabled) {
+        auto frameZone = m_gpuProfiler.getZone("frame");
+        if (frameZone) {
+            m_benchmarkRecorder.setGpuTime(m_gpuProfiler.getLastResolvedFrame(), frameZone->lastMs);
+        }
+    }
+}
+
+void VulkanEngine::createFrameCapture() {
+    m_frameCapture.init(m_allocator, &m_memoryTelemetry, FRAMES_IN_FLIGHT);
+    m_mainDeletionQueue.pushFunction([=]() {
+        m_frameCapture.cleanup();
+    });
+    if (!m_captureSupported) {
+        std::cout << "Swap chain images can't be copied from, frame capture is disabled." << std::endl;
+        return;
+    }
+
+    const auto & directory = m_benchmarkSettings.captureDirectory;
+    if (!directory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        m_frameCapture.setContinuous(directory, m_benchmarkSettings.captureInterval);
+        if (!m_benchmarkSettings.captureReferenceDirectory.empty()) {
+            m_frameCapture.setReference(m_benchmarkSettings.captureReferenceDirectory, m_benchmarkSettings.captureTolerance,
+                                        m_benchmarkSettings.captureMaxDifferingFraction);
+        }
+        std::cout << "Capturing every " << m_benchmarkSettings.captureInterval << " frames into " << directory << std::endl;
+    }
+}
+
+//Picks up captures of the frames still in flight and waits for the encoder to write them
+void VulkanEngine::finishCaptures() {
+    m_vkDevice.waitIdle();
+    for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        m_frameCapture.resolve((m_frameNumber + i) % FRAMES_IN_FLIGHT);
+    }
+    m_frameCapture.flush();
+    if (m_frameCapture.isContinuous()) {
+        m_frameCapture.writeReport(m_benchmarkSettings.captureDirectory + "/report.json");
+    }
+}
+
+uint32_t VulkanEngine::getCaptureFailures() {
+    return m_frameCapture.getFailureCount();
+}
+
 void VulkanEngine::createSyncStructures() {
     vk::FenceCreateInfo fenceInfo = {};
     //This allows us to wait on the fence on first use
@@ -882,89 +1344,55 @@ void VulkanEngine::createSyncStructures() {
     m_uploadContext.uploadFence = m_vkDevice.createFence(uploadFenceInfo);
     m_mainDeletionQueue.pushFunction([=] () {
         m_vkDevice.destroyFence(m_uploadContext.uploadFence);
+        if (m_uploadContext.stagingBuffer.buffer) {
+            destroyBuffer(m_uploadContext.stagingBuffer);
+        }
     });
 }
 
-void VulkanEngine::createDescriptors() {
-    //
-    // Descriptor set layout 0
-    //
-
-    //Bind camera data at 0
-    vk::DescriptorSetLayoutBinding camBinding = vkinit::descriptorSetLayoutBinding(vk::DescriptorType::eUniformBuffer,
-                                                                                   vk::ShaderStageFlagBits::eVertex, 0,
-                                                                                   1);
-
-    //Bind scene parameters at 1
-    vk::DescriptorSetLayoutBinding sceneBinding = vkinit::descriptorSetLayoutBinding(
-            vk::DescriptorType::eUniformBufferDynamic,
-            vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eVertex, 1, 1);
-
-    vk::DescriptorSetLayoutBinding bindings0[] = {camBinding, sceneBinding};
-
-    vk::DescriptorSetLayoutCreateInfo set0Info = {};
-    set0Info.setBindings(bindings0);
-
-    m_globalDescriptorSetLayout = m_vkDevice.createDescriptorSetLayout(set0Info);
-    m_mainDeletionQueue.pushFunction([=] () {
-        m_vkDevice.destroyDescriptorSetLayout(m_globalDescriptorSetLayout);
-    });
-
-    //
-    // Descriptor set layout 1
-    //
-    //Bind objects at 0
-    vk::DescriptorSetLayoutBinding objBinding = vkinit::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer,
-                                                                                   vk::ShaderStageFlagBits::eVertex, 0,
-                                                                                   1);
-
-    //Bind lights at 1
-    vk::DescriptorSetLayoutBinding lightBinding = vkinit::descriptorSetLayoutBinding(vk::DescriptorType::eStorageBuffer,
-                                                                                     vk::ShaderStageFlagBits::eFragment,
-                                                                                     1, 1);
-    vk::DescriptorSetLayoutBinding bindings1[] = {objBinding, lightBinding};
-    vk::DescriptorSetLayoutCreateInfo set1Info = {};
-    set1Info.setBindings(bindings1);
-
-    m_objectDescriptorSetLayout = m_vkDevice.createDescriptorSetLayout(set1Info);
-    m_mainDeletionQueue.pushFunction([=] () {
-        m_vkDevice.destroyDescriptorSetLayout(m_objectDescriptorSetLayout);
-    });
-
-
-    //
-    // Descriptor set layout 2. We don't allocate it here yet.
-    //
-    vk::DescriptorSetLayoutBinding texBinding = vkinit::descriptorSetLayoutBinding(
-            vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment, 0, TEXTURE_ARRAY_SIZE);
+void VulkanEngine::createTextureUploadContext() {
+    vk::CommandPoolCreateInfo poolInfo = vkinit::commandPoolCreateInfo(m_textureUpload.queueFamily, {});
+    m_textureUpload.commandPool = m_vkDevice.createCommandPool(poolInfo);
+    vk::CommandBufferAllocateInfo allocInfo = {};
+    allocInfo.commandPool = m_textureUpload.commandPool;
+    allocInfo.commandBufferCount = 1;
+    allocInfo.level = vk::CommandBufferLevel::ePrimary;
+    m_textureUpload.commandBuffer = m_vkDevice.allocateCommandBuffers(allocInfo)[0];
+    m_textureUpload.fence = m_vkDevice.createFence({});
+    m_textureUpload.semaphore = m_vkDevice.createSemaphore({});
 
-    vk::DescriptorSetLayoutCreateInfo set2Info = {};
-    set2Info.setBindings(texBinding);
-    m_textureDescriptorSetLayout = m_vkDevice.createDescriptorSetLayout(set2Info);
     m_mainDeletionQueue.pushFunction([=]() {
-        m_vkDevice.destroyDescriptorSetLayout(m_textureDescriptorSetLayout);
+        //An upload no frame took over yet
+        if (m_textureUpload.pending) {
+            destroyImage(m_textureUpload.image);
+        }
+        if (m_textureUpload.stagingBuffer.buffer) {
+            destroyBuffer(m_textureUpload.stagingBuffer);
+        }
+        m_vkDevice.destroySemaphore(m_textureUpload.semaphore);
+        m_vkDevice.destroyFence(m_textureUpload.fence);
+        m_vkDevice.destroyCommandPool(m_textureUpload.commandPool);
     });
+}
 
-    //Third one for terrain textures
-    vk::DescriptorSetLayoutBinding terrainTexBinding = vkinit::descriptorSetLayoutBinding(
-            vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment, 0, TERRAIN_TEXTURE_ARRAY_SIZE);
-    vk::DescriptorSetLayoutCreateInfo set3Info = {};
-    set3Info.setBindings(terrainTexBinding);
-    m_terrainTextureDescriptorSetLayout = m_vkDevice.createDescriptorSetLayout(set3Info);
-    m_mainDeletionQueue.pushFunction([=]() {
-        m_vkDevice.destroyDescriptorSetLayout(m_terrainTextureDescriptorSetLayout);
-    });
+void VulkanEngine::createDescriptors() {
+    //The set layouts come from the shaders, so the materials are needed to know which shaders use which set
+    std::vector<MaterialDescription> descriptions;
+    if (!loadMaterialDescriptions(MATERIAL_FILE, descriptions)) {
+        throw std::runtime_error("Failed to load material descriptions.");
+    }
+    createDescriptorSetLayouts(descriptions);
 
     //Create a descriptor pool to hold 10 uniform buffers, and 10 dynamic uniform buffers
     std::vector<vk::DescriptorPoolSize> sizes = {
             { vk::DescriptorType::eUniformBuffer, 10 },
             { vk::DescriptorType::eUniformBufferDynamic, 10 },
-            { vk::DescriptorType::eStorageBuffer, 10 },
-            { vk::DescriptorType::eCombinedImageSampler, 10 }
+            { vk::DescriptorType::eStorageBuffer, 20 },
+            { vk::DescriptorType::eCombinedImageSampler, 16 }
     };
 
     vk::DescriptorPoolCreateInfo poolCreateInfo = {};
-    poolCreateInfo.maxSets = 10;
+    poolCreateInfo.maxSets = 12;
     poolCreateInfo.setPoolSizes(sizes);
 
     m_descriptorPool = m_vkDevice.createDescriptorPool(poolCreateInfo);
@@ -974,7 +1402,8 @@ void VulkanEngine::createDescriptors() {
 
     //Create buffer for scene parameters
     size_t sceneParameterBufferSize = FRAMES_IN_FLIGHT * padUniformBufferSize(sizeof(GPUSceneData));
-    m_sceneParameterBuffer = createBuffer(sceneParameterBufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vma::MemoryUsage::eCpuToGpu);
+    m_sceneParameterBuffer = createBuffer(sceneParameterBufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vma::MemoryUsage::eCpuToGpu,
+                                          MemoryCategory::FrameBuffers);
     m_mainDeletionQueue.pushFunction([=] () {
         destroyBuffer(m_sceneParameterBuffer);
     });
@@ -984,17 +1413,22 @@ void VulkanEngine::createDescriptors() {
         auto & frame = m_frames[i];
 
         const int MAX_OBJECTS = 10000;
-        frame.objectBuffer = createBuffer(sizeof(GPUObjectData) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer, vma::MemoryUsage::eCpuToGpu);
+        frame.objectBuffer = createBuffer(sizeof(GPUObjectData) * MAX_OBJECTS, vk::BufferUsageFlagBits::eStorageBuffer, vma::MemoryUsage::eCpuToGpu,
+                                          MemoryCategory::FrameBuffers);
 
-        frame.cameraBuffer = createBuffer(sizeof(GPUCameraData), vk::BufferUsageFlagBits::eUniformBuffer, vma::MemoryUsage::eCpuToGpu);
+        frame.cameraBuffer = createBuffer(sizeof(GPUCameraData), vk::BufferUsageFlagBits::eUniformBuffer, vma::MemoryUsage::eCpuToGpu,
+                                          MemoryCategory::FrameBuffers);
 
-        const int MAX_LIGHTS = 10;
-        frame.lightBuffer = createBuffer(sizeof(PointLightData) * MAX_LIGHTS, vk::BufferUsageFlagBits::eStorageBuffer, vma::MemoryUsage::eCpuToGpu);
+        frame.clusterBuffer = createBuffer(sizeof(GPUClusterGrid) + sizeof(LightCluster) * CLUSTER_COUNT, vk::BufferUsageFlagBits::eStorageBuffer,
+                                           vma::MemoryUsage::eCpuToGpu, MemoryCategory::FrameBuffers);
 
         m_mainDeletionQueue.pushFunction([=] () {
             destroyBuffer(frame.objectBuffer);
             destroyBuffer(frame.cameraBuffer);
-            destroyBuffer(frame.lightBuffer);
+            destroyBuffer(frame.clusterBuffer);
+            //These are replaced when they grow, so not the ones from when this was queued
+            destroyBuffer(m_frames[i].lightBuffer);
+            destroyBuffer(m_frames[i].lightIndexBuffer);
         });
 
         //Allocate one descriptor set for each frame
@@ -1031,19 +1465,62 @@ void VulkanEngine::createDescriptors() {
         objectInfo.offset = 0;
         objectInfo.range = sizeof(GPUObjectData) * MAX_OBJECTS;
 
-        //Point the light descriptor to the light buffer
-        vk::DescriptorBufferInfo lightInfo = {};
-        lightInfo.buffer = frame.lightBuffer.buffer;
-        lightInfo.offset = 0;
-        lightInfo.range = sizeof(PointLightData) * MAX_LIGHTS;
+        //Point the cluster descriptor to the cluster buffer
+        vk::DescriptorBufferInfo clusterInfo = {};
+        clusterInfo.buffer = frame.clusterBuffer.buffer;
+        clusterInfo.offset = 0;
+        clusterInfo.range = VK_WHOLE_SIZE;
 
         vk::WriteDescriptorSet cameraWrite = vkinit::writeDescriptorSet(vk::DescriptorType::eUniformBuffer, frame.globalDescriptor, &cameraInfo, 0);
         vk::WriteDescriptorSet sceneWrite = vkinit::writeDescriptorSet(vk::DescriptorType::eUniformBufferDynamic, frame.globalDescriptor, &sceneInfo, 1);
         vk::WriteDescriptorSet objectWrite = vkinit::writeDescriptorSet(vk::DescriptorType::eStorageBuffer, frame.objectDescriptor, &objectInfo, 0);
-        vk::WriteDescriptorSet lightWrite = vkinit::writeDescriptorSet(vk::DescriptorType::eStorageBuffer, frame.objectDescriptor, &lightInfo, 1);
-        vk::WriteDescriptorSet setWrite[] = {cameraWrite, sceneWrite, objectWrite, lightWrite};
+        vk::WriteDescriptorSet clusterWrite = vkinit::writeDescriptorSet(vk::DescriptorType::eStorageBuffer, frame.objectDescriptor, &clusterInfo, 2);
+        vk::WriteDescriptorSet setWrite[] = {cameraWrite, sceneWrite, objectWrite, clusterWrite};
 
         m_vkDevice.updateDescriptorSets(setWrite, nullptr);
+
+        //The light and light index buffers write their own descriptors
+        reserveLightBuffers(frame, m_benchmarkSettings.pointLightCount, 0);
+    }
+}
+
+void VulkanEngine::reserveLightBuffers(FrameData &frame, size_t lightCount, size_t lightIndexCount) {
+    //Only called for a frame whose fence has been waited on, so nothing reads the old buffers or the descriptor set
+    //anymore. Capacities double, so a slowly growing count doesn't reallocate every frame.
+    auto grow = [](size_t capacity, size_t required) {
+        capacity = std::max<size_t>(capacity, 64);
+        while (capacity < required) {
+            capacity *= 2;
+        }
+        return capacity;
+    };
+    vk::DescriptorBufferInfo lightInfo = {};
+    vk::DescriptorBufferInfo lightIndexInfo = {};
+    std::vector<vk::WriteDescriptorSet> writes;
+    if (!frame.lightBuffer.buffer || lightCount > frame.lightCapacity) {
+        if (frame.lightBuffer.buffer) {
+            destroyBuffer(frame.lightBuffer);
+        }
+        frame.lightCapacity = grow(frame.lightCapacity, lightCount);
+        frame.lightBuffer = createBuffer(sizeof(PointLightData) * frame.lightCapacity, vk::BufferUsageFlagBits::eStorageBuffer,
+                                         vma::MemoryUsage::eCpuToGpu, MemoryCategory::FrameBuffers);
+        lightInfo.buffer = frame.lightBuffer.buffer;
+        lightInfo.range = VK_WHOLE_SIZE;
+        writes.push_back(vkinit::writeDescriptorSet(vk::DescriptorType::eStorageBuffer, frame.objectDescriptor, &lightInfo, 1));
+    }
+    if (!frame.lightIndexBuffer.buffer || lightIndexCount > frame.lightIndexCapacity) {
+        if (frame.lightIndexBuffer.buffer) {
+            destroyBuffer(frame.lightIndexBuffer);
+        }
+        frame.lightIndexCapacity = grow(frame.lightIndexCapacity, lightIndexCount);
+        frame.lightIndexBuffer = createBuffer(sizeof(uint32_t) * frame.lightIndexCapacity, vk::BufferUsageFlagBits::eStorageBuffer,
+                                              vma::MemoryUsage::eCpuToGpu, MemoryCategory::FrameBuffers);
+        lightIndexInfo.buffer = frame.lightIndexBuffer.buffer;
+        lightIndexInfo.range = VK_WHOLE_SIZE;
+        writes.push_back(vkinit::writeDescriptorSet(vk::DescriptorType::eStorageBuffer, frame.objectDescriptor, &lightIndexInfo, 3));
+    }
+    if (!writes.empty()) {
+        m_vkDevice.updateDescriptorSets(writes, nullptr);
     }
 }
 
@@ -1074,18 +1551,34 @@ void VulkanEngine::initVulkan() {
     allocatorInfo.physicalDevice = m_activeGPU;
     allocatorInfo.device = m_vkDevice;
     allocatorInfo.instance = m_instance;
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+    if (m_memoryBudgetSupported) {
+        allocatorInfo.flags |= vma::AllocatorCreateFlagBits::eExtMemoryBudget;
+    }
     m_allocator = vma::createAllocator(allocatorInfo);
+    m_memoryTelemetry.init(m_allocator, m_memoryBudgetSupported);
+    if (!m_benchmarkSettings.memoryStatsFile.empty()) {
+        m_memoryTelemetry.setDumpInterval(m_benchmarkSettings.memoryStatsInterval);
+    }
 
     createSwapChain();
     createCommandPoolAndBuffers();
-    createDefaultRenderPass();
-    createFramebuffers();
+    if (!m_dynamicRenderingEnabled) {
+        createDefaultRenderPass();
+        createFramebuffers();
+    }
+    std::cout << "Rendering with " << (m_dynamicRenderingEnabled ? "dynamic rendering" : "a render pass") << "." << std::endl;
 
     m_gpuProperties = m_activeGPU.getProperties();
     std::cout << "GPU minimum buffer alignment: " << m_gpuProperties.limits.minUniformBufferOffsetAlignment << std::endl;
 }
 
 void VulkanEngine::initScene() {
+    //Chunks are generated all the time, so their materials are looked up once here
+    m_terrainMaterial = getMaterialHandle("terrain");
+    m_waterMaterial = getMaterialHandle("water");
+    m_texturedMaterial = getMaterialHandle("texturedmesh");
+
 //    RenderObject terrain = {};
 //    terrain.mesh = getMesh("heightmap");
 //    terrain.material = getMaterial("terrain");
@@ -1101,15 +1594,68 @@ void VulkanEngine::initScene() {
 //    m_renderables.push_back(monkey);
 
     auto mesh = getMesh("monkey");
-    auto mat = getMaterial("texturedmesh");
     for (size_t i = 0; i < TEXTURE_ARRAY_SIZE; i++) {
         RenderObject monke;
         monke.mesh = mesh;
-        monke.material = mat;
+        monke.material = m_texturedMaterial;
         monke.transformMatrix = glm::translate(glm::vec3(-6.0f + i*3, 20, 0));
         monke.textureId = i;
         m_renderables.push_back(monke);
     }
+
+    createPointLights();
+}
+
+void VulkanEngine::createPointLights() {
+    //Scattered over the terrain around the start, a little above the ground or the water. Seeded with the terrain
+    //seed, so every benchmark run has the same lights.
+    std::mt19937 random(m_terrainSeed);
+    std::uniform_real_distribution<float> position(-m_lightAreaSize / 2.0f, m_lightAreaSize / 2.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    m_pointLights.resize(m_benchmarkSettings.pointLightCount);
+    for (auto & light : m_pointLights) {
+        float x = position(random);
+        float z = position(random);
+        //Same as the terrain's height in Mesh::writeNoiseSamples
+        float ground = static_cast<float>(m_noiseSource.octave2D_01(x * 0.01, z * 0.01, 4)) * 100.0f;
+        float y = std::max(ground, 16.0f) + 2.0f + 4.0f * unit(random);
+        float radius = 8.0f + 12.0f * unit(random);
+        glm::vec3 color = glm::vec3(unit(random), unit(random), unit(random)) + 0.1f;
+        color /= std::max(color.r, std::max(color.g, color.b));
+        light.worldPosition = glm::vec4(x, y, z, radius);
+        light.lightColor = glm::vec4(color * 40.0f, 32.0f);
+    }
+    std::cout << "Created " << m_pointLights.size() << " point lights." << std::endl;
+}
+
+void VulkanEngine::updatePointLights(FrameData &frame, const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane) {
+    PROFILE_FUNCTION();
+    //The lights bob up and down, so the clusters are really rebuilt from moving lights every frame
+    m_frameLights = m_pointLights;
+    for (size_t i = 0; i < m_frameLights.size(); i++) {
+        m_frameLights[i].worldPosition.y += 1.5f * std::sin(m_simulationTime + 0.7f * static_cast<float>(i));
+    }
+    {
+        PROFILE_ZONE("buildLightClusters");
+        m_lightClusters.build(m_frameLights, view, projection, nearPlane, farPlane, m_swapChainExtent.width, m_swapChainExtent.height);
+    }
+    const auto & lightIndices = m_lightClusters.getLightIndices();
+    reserveLightBuffers(frame, m_frameLights.size(), lightIndices.size());
+
+    if (!m_frameLights.empty()) {
+        void * lightData = m_allocator.mapMemory(frame.lightBuffer.allocation);
+        memcpy(lightData, m_frameLights.data(), sizeof(PointLightData) * m_frameLights.size());
+        m_allocator.unmapMemory(frame.lightBuffer.allocation);
+    }
+    char * clusterData = static_cast<char *>(m_allocator.mapMemory(frame.clusterBuffer.allocation));
+    memcpy(clusterData, &m_lightClusters.getGrid(), sizeof(GPUClusterGrid));
+    memcpy(clusterData + sizeof(GPUClusterGrid), m_lightClusters.getClusters().data(), sizeof(LightCluster) * CLUSTER_COUNT);
+    m_allocator.unmapMemory(frame.clusterBuffer.allocation);
+    if (!lightIndices.empty()) {
+        void * indexData = m_allocator.mapMemory(frame.lightIndexBuffer.allocation);
+        memcpy(indexData, lightIndices.data(), sizeof(uint32_t) * lightIndices.size());
+        m_allocator.unmapMemory(frame.lightIndexBuffer.allocation);
+    }
 }
 
 bool VulkanEngine::checkValidationLayerSupport() {
@@ -1222,6 +1768,17 @@ QueueFamilyIndices VulkanEngine::findQueueFamilies(const vk::PhysicalDevice &dev
             break;
         }
     }
+    //On most GPUs a transfer-only family is a separate copy engine, so uploads on it run alongside rendering. Its copies
+    //have to handle any texel, as the small mip levels are only a few texels big.
+    i = 0;
+    for (auto it = families.begin(); it != families.end(); it++, i++) {
+        bool transferOnly = (it->queueFlags & vk::QueueFlagBits::eTransfer) &&
+                            !(it->queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+        if (transferOnly && it->minImageTransferGranularity == vk::Extent3D(1, 1, 1)) {
+            indices.transferFamily = i;
+            break;
+        }
+    }
 
     return indices;
 }
@@ -1246,6 +1803,15 @@ vk::SurfaceFormatKHR VulkanEngine::chooseSwapSurfaceFormat(const std::vector<vk:
 }
 
 vk::PresentModeKHR VulkanEngine::chooseSwapPresentMode(const std::vector<vk::PresentModeKHR> &availableModes) {
+    //Benchmarks shouldn't be capped at the display refresh rate
+    if (m_benchmarkSettings.enabled) {
+        for (auto mode : {vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox}) {
+            if (std::find(availableModes.begin(), availableModes.end(), mode) != availableModes.end()) {
+                return mode;
+            }
+        }
+    }
+
 //    for (const auto & mode : availableModes) {
 //        if (mode == vk::PresentModeKHR::eMailbox) {
 //            return mode;
@@ -1277,7 +1843,7 @@ vk::Extent2D VulkanEngine::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &ca
 
 }
 
-vk::ShaderModule VulkanEngine::loadShaderModule(const char *filePath) {
+static std::vector<uint32_t> readShaderCode(const char *filePath) {
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
@@ -1291,261 +1857,874 @@ vk::ShaderModule VulkanEngine::loadShaderModule(const char *filePath) {
     file.seekg(0);
     file.read((char*) code.data(), fileSize);
     file.close();
+    return code;
+}
 
-    vk::ShaderModuleCreateInfo info = {};
-    info.setCode(code);
-
-    vk::ShaderModule module = m_vkDevice.createShaderModule(info); //FIXME: ensure that any resources are cleaned up if this throws (not sure if necessary)
-    return module;
+void VulkanEngine::loadAssetPack() {
+    if (m_benchmarkSettings.assetPackFile.empty()) {
+        return;
+    }
+    if (m_assetPack.open(m_benchmarkSettings.assetPackFile)) {
+        std::cout << "Mapped " << m_assetPack.getAssetCount() << " assets (" << m_assetPack.getSize() / 1024 << " KiB) from "
+                  << m_benchmarkSettings.assetPackFile << "." << std::endl;
+    }
+    else {
+        std::cout << "No asset pack, loading assets from their source files." << std::endl;
+    }
 }
 
-//TODO: use vk::PipelineCache to speed up rebuilding these
-//TODO: actually just refactor this whole function, JFC.
-void VulkanEngine::createPipelines() {
-    //Default placeholder shader
-    vk::ShaderModule defaultLitFragShader = loadShaderModule("shaders/default_lit.frag.spv");
-    //Textured shader
-    vk::ShaderModule defaultTexFragShader = loadShaderModule("shaders/textured_lit.frag.spv");
-    //Terrain
-    vk::ShaderModule defaultTerrainFragShader = loadShaderModule("shaders/terrain_textured_lit.frag.spv");
-    //Water
-    vk::ShaderModule defaultWaterShader = loadShaderModule("shaders/water.frag.spv");
-    //Load mesh vertex shader
-    vk::ShaderModule meshVertShader = loadShaderModule("shaders/tri_mesh.vert.spv");
-    std::cout << "Loaded shaders." << std::endl;
+void VulkanEngine::loadShaderArchive() {
+#ifdef VKENG_EMBED_SHADERS
+    bool opened = m_shaderArchive.openMemory(g_embeddedShaderArchive, g_embeddedShaderArchiveSize);
+#else
+    bool opened = false;
+    std::string archiveFile;
+    if (AssetBlob blob = m_assetPack.find("shaders.pak", AssetType::ShaderArchive)) {
+        opened = m_shaderArchive.openMemory(blob.data, blob.size);
+        archiveFile = m_benchmarkSettings.assetPackFile;
+    }
+    if (!opened) {
+        opened = m_shaderArchive.open("shaders.pak");
+        archiveFile = "shaders.pak";
+    }
+    std::error_code error;
+    auto archiveTime = std::filesystem::last_write_time(archiveFile, error);
+    if (opened && !error) {
+        m_shaderArchiveTime = archiveTime;
+    }
+#endif
+    if (opened) {
+        std::cout << "Loaded " << m_shaderArchive.getShaderCount() << " shaders from the shader archive." << std::endl;
+    }
+    else {
+        std::cout << "No shader archive, loading shaders from their own files." << std::endl;
+    }
 
-    PipelineBuilder pipelineBuilder;
+    m_mainDeletionQueue.pushFunction([=]() {
+        for (const auto & [path, module] : m_shaderModules) {
+            m_vkDevice.destroyShaderModule(module);
+        }
+        m_shaderModules.clear();
+        for (auto module : m_retiredShaderModules) {
+            m_vkDevice.destroyShaderModule(module);
+        }
+        m_retiredShaderModules.clear();
+    });
+}
 
-    //This controls how to read vertices from the vertex buffers. We aren't using them yet.
-    pipelineBuilder.m_vertexInputInfo = vkinit::pipelineVertexInputStateCreateInfo();
+vk::ShaderModule VulkanEngine::getShaderModule(const std::string &path) {
+    //Stages shared between materials, like tri_mesh.vert, are only created once
+    auto it = m_shaderModules.find(path);
+    if (it != m_shaderModules.end()) {
+        return it->second;
+    }
 
-    //This is the configuration for drawing triangle lists, strips, or individual points
-    //We are just drawing a triangle list.
-    pipelineBuilder.m_inputAssemblyInfo = vkinit::pipelineInputAssemblyStateCreateInfo(vk::PrimitiveTopology::eTriangleList);
+    vk::ShaderModuleCreateInfo info = {};
+    std::vector<uint32_t> code;
+    ShaderBlob blob = findArchivedShader(path);
+    if (blob) {
+        //Straight from the mapped archive, without copying it into a buffer first
+        info.codeSize = blob.wordCount * sizeof(uint32_t);
+        info.pCode = blob.code;
+    }
+    else {
+        code = readShaderCode(path.c_str());
+        info.setCode(code);
+    }
+    vk::ShaderModule module = m_vkDevice.createShaderModule(info);
+    m_shaderModules[path] = module;
+    return module;
+}
 
-    //Build viewport and scissor
-    pipelineBuilder.m_viewport.x = 0.0f;
-    pipelineBuilder.m_viewport.y = 0.0f;
-    pipelineBuilder.m_viewport.width = static_cast<float>(m_swapChainExtent.width);
-    pipelineBuilder.m_viewport.height = static_cast<float>(m_swapChainExtent.height);
-    pipelineBuilder.m_viewport.minDepth = 0.0f;
-    pipelineBuilder.m_viewport.maxDepth = 1.0f;
+ShaderBlob VulkanEngine::findArchivedShader(const std::string &path) {
+    ShaderBlob blob = m_shaderArchive.find(path);
+    std::error_code error;
+    auto fileTime = std::filesystem::last_write_time(path, error);
+    if (!blob || error) {
+        return blob;
+    }
+    //An embedded archive has no time to compare with, so its shaders are only overridden while shaders are being edited
+    bool newer = m_shaderArchiveTime.has_value() ? fileTime > m_shaderArchiveTime.value()
+                                                 : m_benchmarkSettings.hotReloadShaders && !m_benchmarkSettings.enabled;
+    if (newer) {
+        std::cout << "Loading " << path << " instead of the shader archive's older copy." << std::endl;
+        return {};
+    }
+    return blob;
+}
 
-    pipelineBuilder.m_scissor.offset = vk::Offset2D{0, 0};
-    pipelineBuilder.m_scissor.extent = m_swapChainExtent; //FIXME: do we need the "real" hiDPI-aware extent here?
+void VulkanEngine::createPipelineCache() {
+    m_pipelineCache.init(m_vkDevice, m_gpuProperties, m_benchmarkSettings.pipelineCacheFile);
+    m_pipelineCompiler.init(m_vkDevice, &m_jobSystem);
+    m_mainDeletionQueue.pushFunction([=]() {
+        m_pipelineCache.cleanup();
+    });
+}
 
-    //Configure the rasterizer to draw filled rectangles
-    pipelineBuilder.m_rasterizerInfo = vkinit::pipelineRasterizationStateCreateInfo(vk::PolygonMode::eFill);
+//Materials are described in data/materials.txt. Their pipelines are built on the job system; until a material's
+//pipeline is done, objects using it are skipped when drawing.
+void VulkanEngine::createPipelines() {
+    PROFILE_FUNCTION();
+    std::vector<MaterialDescription> descriptions;
+    if (!loadMaterialDescriptions(MATERIAL_FILE, descriptions)) {
+        throw std::runtime_error("Failed to load material descriptions.");
+    }
+    m_pipelineLayoutCache.init(m_vkDevice);
 
-    //yes multisampling
-    pipelineBuilder.m_multisampleInfo = vkinit::multisampleStateCreateInfo(m_msaaSamples);
+    std::vector<MaterialHandle> handles;
+    for (const auto & description : descriptions) {
+        handles.push_back(createMaterial(description));
+    }
 
-    //a single blend attachment with no blending, writing to RGBA
-    pipelineBuilder.m_colorBlendAttachmentState = vkinit::pipelineColorBlendAttachmentState();
+    bool warmCache = m_pipelineCache.isWarm();
+    rebuildPipelines(handles);
+    m_pipelineBatchWarmCache = warmCache;
+    m_pipelineBatchIsReload = false;
+    std::cout << "Created " << handles.size() << " materials sharing " << m_pendingPipelineKeys.size() << " pipelines and "
+              << m_pipelineLayoutCache.getLayoutCount() << " pipeline layouts." << std::endl;
 
-    //
-    //Build the mesh pipeline
-    //
-    VertexInputDescription vertexDescription = Vertex::getVertexDescription();
+    //Queue destruction of the layouts and of every pipeline built by then, since shader reloads and feature
+    //changes swap them out while running.
+    m_pipelineDeletionQueue.pushFunction([=]() {
+        for (auto & material : m_materials) {
+            material.pipeline = VK_NULL_HANDLE;
+            material.pipelineLayout = VK_NULL_HANDLE;
+        }
+        for (const auto & [key, variant] : m_pipelineVariants) {
+            m_vkDevice.destroyPipeline(variant.pipeline);
+        }
+        m_pipelineVariants.clear();
+        m_pipelineLayoutCache.cleanup();
+    });
+}
 
-    vk::PipelineLayoutCreateInfo meshPipelineInfo = vkinit::pipelineLayoutCreateInfo();
+MaterialHandle VulkanEngine::createMaterial(const MaterialDescription &description) {
+    MaterialHandle handle = getMaterialHandle(description.name);
+    if (handle == INVALID_MATERIAL) {
+        handle = static_cast<MaterialHandle>(m_materials.size());
+        m_materials.emplace_back();
+        m_materialDescriptions.emplace_back();
+        m_materialHandles[description.name] = handle;
+    }
+    m_materialDescriptions[handle] = description;
+    Material & material = m_materials[handle];
+    material.name = description.name;
+
+    //The texture set always holds the whole array, so its shader is specialized for that many textures
+    MaterialDescription & stored = m_materialDescriptions[handle];
+    if (usesDescriptorSet(handle, "texture")) {
+        if (stored.textureCount != 0 && stored.textureCount != TEXTURE_ARRAY_SIZE) {
+            throw std::runtime_error("Material " + description.name + " asks for " + std::to_string(stored.textureCount) +
+                                     " textures, but the texture set holds " + std::to_string(TEXTURE_ARRAY_SIZE) + ".");
+        }
+        stored.textureCount = TEXTURE_ARRAY_SIZE;
+    }
 
-    //Set up push constants
-    vk::PushConstantRange pushConstantRange;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(MeshPushConstants);
-    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eVertex;
-    meshPipelineInfo.setPushConstantRanges(pushConstantRange);
+    if (!createMaterialLayout(stored, material)) {
+        throw std::runtime_error("Material " + description.name + " doesn't match its shaders.");
+    }
+    material.pipelineKey = getPipelineKey(handle);
+    return handle;
+}
 
-    //Hook up the set layouts
-    vk::DescriptorSetLayout setLayouts[] = {m_globalDescriptorSetLayout, m_objectDescriptorSetLayout};
-    meshPipelineInfo.setSetLayouts(setLayouts);
+//The engine pushes MeshPushConstants at offset 0 and the texture index right after it. The shaders' ranges are
+//widened to whole members of that, so every push lies inside the range of each stage it's pushed to.
+static std::vector<vk::PushConstantRange> getPushConstantRanges(const ShaderReflection & reflection, vk::ShaderStageFlags & meshConstantStages,
+                                                                vk::ShaderStageFlags & textureIndexStages) {
+    const uint32_t members[][2] = {
+            {0, sizeof(MeshPushConstants)},
+            {sizeof(MeshPushConstants), sizeof(MeshPushConstants) + sizeof(int)},
+    };
+    meshConstantStages = {};
+    textureIndexStages = {};
+    std::vector<vk::PushConstantRange> ranges;
+    for (auto range : reflection.pushConstantRanges) {
+        uint32_t begin = range.offset;
+        uint32_t end = range.offset + range.size;
+        if (end > members[1][1]) {
+            throw std::runtime_error("Shader reads push constants past the texture index, which aren't pushed.");
+        }
+        for (uint32_t i = 0; i < std::size(members); i++) {
+            if (begin < members[i][1] && end > members[i][0]) {
+                begin = std::min(begin, members[i][0]);
+                end = std::max(end, members[i][1]);
+                (i == 0 ? meshConstantStages : textureIndexStages) |= range.stageFlags;
+            }
+        }
+        range.offset = begin;
+        range.size = end - begin;
+        ranges.push_back(range);
+    }
+    return ranges;
+}
 
-    m_meshPipelineLayout = m_vkDevice.createPipelineLayout(meshPipelineInfo); //queued for deletion at the bottom of this func
+//Arrays sized by the texture count specialization constant are as big as the material says
+static uint32_t getDescriptorCount(const MaterialDescription & description, const ReflectedBinding & binding) {
+    if (binding.countSpecializationID == SPEC_TEXTURE_COUNT && description.textureCount > 0) {
+        return description.textureCount;
+    }
+    return binding.count;
+}
 
-    //Connect the builder vertex input info to the one we got from Vertex::
-    pipelineBuilder.m_vertexInputInfo.setVertexAttributeDescriptions(vertexDescription.attributes);
-    pipelineBuilder.m_vertexInputInfo.setVertexBindingDescriptions(vertexDescription.bindings);
+bool VulkanEngine::createMaterialLayout(const MaterialDescription &description, Material &material) {
+    ShaderReflection reflection;
+    std::vector<vk::PushConstantRange> pushConstantRanges;
+    try {
+        reflection = getMaterialReflection(description);
+        pushConstantRanges = getPushConstantRanges(reflection, material.meshConstantStages, material.textureIndexStages);
+    }
+    catch (const std::exception & e) {
+        std::cout << "Material " << description.name << ": " << e.what() << std::endl;
+        return false;
+    }
 
-    //Add shaders
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex, meshVertShader));
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eFragment, defaultLitFragShader));
+    //Every binding the shaders use has to be in the set listed at its index, with enough descriptors for the array
+    for (const auto & binding : reflection.bindings) {
+        std::string where = "set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) + " (" + binding.name + ")";
+        if (binding.set >= description.descriptorSets.size()) {
+            std::cout << "Material " << description.name << " doesn't list a descriptor set for " << where << std::endl;
+            return false;
+        }
+        const auto & setBindings = m_descriptorSetBindings[description.descriptorSets[binding.set]];
+        auto it = std::find_if(setBindings.begin(), setBindings.end(), [&](const vk::DescriptorSetLayoutBinding & layoutBinding) {
+            return layoutBinding.binding == binding.binding;
+        });
+        bool dynamic = it != setBindings.end() &&
+                ((it->descriptorType == vk::DescriptorType::eUniformBufferDynamic && binding.type == vk::DescriptorType::eUniformBuffer) ||
+                 (it->descriptorType == vk::DescriptorType::eStorageBufferDynamic && binding.type == vk::DescriptorType::eStorageBuffer));
+        uint32_t count = getDescriptorCount(description, binding);
+        if (it == setBindings.end() || (it->descriptorType != binding.type && !dynamic) || it->descriptorCount < count ||
+            (it->stageFlags & binding.stages) != binding.stages) {
+            std::cout << "Material " << description.name << " uses " << where << ", which its "
+                      << description.descriptorSets[binding.set] << " set doesn't provide." << std::endl;
+            return false;
+        }
+    }
 
-    //Hook the new layout into the pipelineBuilder
-    pipelineBuilder.m_pipelineLayout = m_meshPipelineLayout;
+    //Descriptor sets in the order listed
+    std::vector<vk::DescriptorSetLayout> setLayouts;
+    for (const auto & setName : description.descriptorSets) {
+        setLayouts.push_back(getDescriptorSetLayout(setName));
+    }
+    material.pipelineLayout = m_pipelineLayoutCache.createPipelineLayout(setLayouts, pushConstantRanges);
+    return true;
+}
 
-    //Default depth testing
-    pipelineBuilder.m_depthStencil = vkinit::depthStencilStateCreateInfo(true, true, vk::CompareOp::eLessOrEqual);
+ShaderReflection VulkanEngine::getMaterialReflection(const MaterialDescription &description) {
+    ShaderReflection reflection;
+    for (const auto & path : {description.vertexShader, description.fragmentShader}) {
+        auto it = m_shaderReflections.find(path);
+        if (it == m_shaderReflections.end()) {
+            ShaderBlob blob = findArchivedShader(path);
+            if (blob) {
+                it = m_shaderReflections.emplace(path, reflectShader(blob.code, blob.wordCount)).first;
+            }
+            else {
+                std::vector<uint32_t> code = readShaderCode(path.c_str());
+                it = m_shaderReflections.emplace(path, reflectShader(code.data(), code.size())).first;
+            }
+        }
+        reflection.merge(it->second);
+    }
+    return reflection;
+}
 
-    //Finally, build the pipeline
-    m_meshPipeline = pipelineBuilder.buildPipeline(m_vkDevice, m_renderPass);
+void VulkanEngine::createDescriptorSetLayouts(const std::vector<MaterialDescription> &descriptions) {
+    //Each named set gets every binding the shaders of the materials using it declare, so all materials agree on
+    //its layout and one descriptor set can be bound for all of them
+    m_descriptorSetBindings.clear();
+    for (const auto & description : descriptions) {
+        ShaderReflection reflection = getMaterialReflection(description);
+        for (const auto & binding : reflection.bindings) {
+            if (binding.set >= description.descriptorSets.size()) {
+                throw std::runtime_error("Material " + description.name + " uses descriptor set " + std::to_string(binding.set) + ", which it doesn't list.");
+            }
+            const std::string & setName = description.descriptorSets[binding.set];
+            auto & setBindings = m_descriptorSetBindings[setName];
+            uint32_t count = getDescriptorCount(description, binding);
+            auto it = std::find_if(setBindings.begin(), setBindings.end(), [&](const vk::DescriptorSetLayoutBinding & existing) {
+                return existing.binding == binding.binding;
+            });
+            if (it == setBindings.end()) {
+                setBindings.push_back(vkinit::descriptorSetLayoutBinding(binding.type, binding.stages, binding.binding, count));
+            }
+            else if (it->descriptorType != binding.type) {
+                throw std::runtime_error("Shaders disagree on the type of " + setName + " set binding " + std::to_string(binding.binding) + ".");
+            }
+            else {
+                it->stageFlags |= binding.stages;
+                it->descriptorCount = std::max(it->descriptorCount, count);
+            }
+        }
+    }
 
-    //Add the pipeline to our materials
-    createMaterial(m_meshPipeline, m_meshPipelineLayout, "defaultmesh");
+    //What the engine writes into each set. The shaders have to declare all of it, and the buffers bound with a
+    //dynamic offset get their type from here because SPIR-V doesn't tell them apart from plain ones.
+    struct EngineBinding {
+        const char * set;
+        uint32_t binding;
+        vk::DescriptorType type;
+        uint32_t count;
+    };
+    const EngineBinding engineBindings[] = {
+            {"global", 0, vk::DescriptorType::eUniformBuffer, 1}, //camera
+            {"global", 1, vk::DescriptorType::eUniformBufferDynamic, 1}, //scene parameters
+            {"object", 0, vk::DescriptorType::eStorageBuffer, 1}, //object matrices
+            {"object", 1, vk::DescriptorType::eStorageBuffer, 1}, //lights
+            {"object", 2, vk::DescriptorType::eStorageBuffer, 1}, //light clusters
+            {"object", 3, vk::DescriptorType::eStorageBuffer, 1}, //light indices of the clusters
+            {"texture", 0, vk::DescriptorType::eCombinedImageSampler, TEXTURE_ARRAY_SIZE},
+            {"terrain_texture", 0, vk::DescriptorType::eCombinedImageSampler, 1}, //layer array
+            {"terrain_texture", 1, vk::DescriptorType::eCombinedImageSampler, 1}, //blend lookup
+    };
+    for (const auto & engineBinding : engineBindings) {
+        auto & setBindings = m_descriptorSetBindings[engineBinding.set];
+        std::string where = std::string(engineBinding.set) + " set binding " + std::to_string(engineBinding.binding);
+        auto it = std::find_if(setBindings.begin(), setBindings.end(), [&](const vk::DescriptorSetLayoutBinding & binding) {
+            return binding.binding == engineBinding.binding;
+        });
+        if (it == setBindings.end()) {
+            throw std::runtime_error("No shader uses the " + where + ", which the engine writes.");
+        }
+        bool dynamic = (engineBinding.type == vk::DescriptorType::eUniformBufferDynamic && it->descriptorType == vk::DescriptorType::eUniformBuffer) ||
+                       (engineBinding.type == vk::DescriptorType::eStorageBufferDynamic && it->descriptorType == vk::DescriptorType::eStorageBuffer);
+        if (it->descriptorType != engineBinding.type && !dynamic) {
+            throw std::runtime_error("The shaders' type for the " + where + " doesn't match what the engine writes.");
+        }
+        if (it->descriptorCount > engineBinding.count) {
+            throw std::runtime_error("The shaders expect more descriptors in the " + where + " than the engine writes.");
+        }
+        it->descriptorType = engineBinding.type;
+        it->descriptorCount = engineBinding.count;
+    }
+    for (const auto & [setName, setBindings] : m_descriptorSetBindings) {
+        for (const auto & binding : setBindings) {
+            bool written = std::any_of(std::begin(engineBindings), std::end(engineBindings), [&](const EngineBinding & engineBinding) {
+                return setName == engineBinding.set && binding.binding == engineBinding.binding;
+            });
+            if (!written) {
+                throw std::runtime_error("Shaders use " + setName + " set binding " + std::to_string(binding.binding) + ", which the engine doesn't write.");
+            }
+        }
+    }
 
-    //
-    //Build a pipeline for textured mesh
-    //
-    vk::PipelineLayoutCreateInfo texPipelineInfo = meshPipelineInfo;
-
-    //Create extra push constant for this pipeline for fragment shaders
-    vk::PushConstantRange texPushConstants[2];
-    texPushConstants[0] = pushConstantRange;
-    texPushConstants[1].offset = sizeof(MeshPushConstants);
-    texPushConstants[1].size = sizeof(int);
-    texPushConstants[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
-    texPipelineInfo.setPushConstantRanges(texPushConstants);
-
-    vk::DescriptorSetLayout texSetLayouts[] = {m_globalDescriptorSetLayout, m_objectDescriptorSetLayout, m_textureDescriptorSetLayout};
-    texPipelineInfo.setSetLayouts(texSetLayouts);
-
-    auto texPipelineLayout = m_vkDevice.createPipelineLayout(texPipelineInfo);
-    pipelineBuilder.m_shaderStageInfos.clear();
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex, meshVertShader));
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eFragment, defaultTexFragShader));
-    pipelineBuilder.m_pipelineLayout = texPipelineLayout;
-    auto texPipeline = pipelineBuilder.buildPipeline(m_vkDevice, m_renderPass);
-    createMaterial(texPipeline, texPipelineLayout, "texturedmesh");
-
-    //Textured terrain pipeline, similar to the above one for textured meshes
-    vk::PipelineLayoutCreateInfo terrainPipelineInfo = meshPipelineInfo;
-
-    vk::PushConstantRange texTerrainPushConstants[2];
-    texTerrainPushConstants[0] = pushConstantRange;
-    texTerrainPushConstants[1].offset = sizeof(MeshPushConstants);
-    texTerrainPushConstants[1].size = sizeof(int);
-    texTerrainPushConstants[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
-    terrainPipelineInfo.setPushConstantRanges(texTerrainPushConstants);
-
-    vk::DescriptorSetLayout terrainSetLayouts[] = {m_globalDescriptorSetLayout, m_objectDescriptorSetLayout, m_terrainTextureDescriptorSetLayout};
-    terrainPipelineInfo.setSetLayouts(terrainSetLayouts);
-
-    auto terrainPipelineLayout = m_vkDevice.createPipelineLayout(terrainPipelineInfo);
-    pipelineBuilder.m_shaderStageInfos.clear();
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex, meshVertShader));
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eFragment, defaultTerrainFragShader));
-    pipelineBuilder.m_pipelineLayout = terrainPipelineLayout;
-    auto terrainPipeline = pipelineBuilder.buildPipeline(m_vkDevice, m_renderPass);
-    createMaterial(terrainPipeline, terrainPipelineLayout, "terrain");
-
-    //Water
-    vk::PipelineLayoutCreateInfo waterPipelineInfo = meshPipelineInfo;
-
-    //Water doesn't use texIdx push constant
-    vk::PushConstantRange waterPushConstants[1];
-    waterPushConstants[0] = pushConstantRange;
-    waterPipelineInfo.setPushConstantRanges(waterPushConstants);
-
-    vk::DescriptorSetLayout waterSetLayouts[] = {m_globalDescriptorSetLayout, m_objectDescriptorSetLayout};
-    waterPipelineInfo.setSetLayouts(waterSetLayouts);
-
-    auto waterPipelineLayout = m_vkDevice.createPipelineLayout(waterPipelineInfo);
-    pipelineBuilder.m_shaderStageInfos.clear();
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex, meshVertShader));
-    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eFragment, defaultWaterShader));
-    pipelineBuilder.m_pipelineLayout = waterPipelineLayout;
-    auto waterPipeline = pipelineBuilder.buildPipeline(m_vkDevice, m_renderPass);
-    createMaterial(waterPipeline, waterPipelineLayout, "water");
-
-
-    //Destroy shader modules
-    m_vkDevice.destroyShaderModule(meshVertShader);
-    m_vkDevice.destroyShaderModule(defaultLitFragShader);
-    m_vkDevice.destroyShaderModule(defaultTexFragShader);
-    m_vkDevice.destroyShaderModule(defaultTerrainFragShader);
-    m_vkDevice.destroyShaderModule(defaultWaterShader);
-
-    //Queue destruction of pipelines
-    m_pipelineDeletionQueue.pushFunction([=]() {
-        m_vkDevice.destroyPipeline(m_meshPipeline);
-        m_vkDevice.destroyPipelineLayout(m_meshPipelineLayout);
+    //Identical sets share a layout through the cache
+    m_descriptorLayoutCache.init(m_vkDevice);
+    auto createLayout = [&](const char * setName) {
+        vk::DescriptorSetLayoutCreateInfo info = {};
+        info.setBindings(m_descriptorSetBindings[setName]);
+        return m_descriptorLayoutCache.createDescriptorSetLayout(info);
+    };
+    m_globalDescriptorSetLayout = createLayout("global");
+    m_objectDescriptorSetLayout = createLayout("object");
+    m_textureDescriptorSetLayout = createLayout("texture");
+    m_terrainTextureDescriptorSetLayout = createLayout("terrain_texture");
+    m_mainDeletionQueue.pushFunction([=]() {
+        m_descriptorLayoutCache.cleanup();
+    });
+    std::cout << "Created " << m_descriptorLayoutCache.getLayoutCount() << " descriptor set layouts from "
+              << m_shaderReflections.size() << " reflected shaders." << std::endl;
+}
+
+vk::DescriptorSetLayout VulkanEngine::getDescriptorSetLayout(const std::string &name) const {
+    if (name == "global") {
+        return m_globalDescriptorSetLayout;
+    }
+    if (name == "object") {
+        return m_objectDescriptorSetLayout;
+    }
+    if (name == "texture") {
+        return m_textureDescriptorSetLayout;
+    }
+    if (name == "terrain_texture") {
+        return m_terrainTextureDescriptorSetLayout;
+    }
+    throw std::runtime_error("Unknown descriptor set layout " + name);
+}
 
-        m_vkDevice.destroyPipeline(texPipeline);
-        m_vkDevice.destroyPipelineLayout(texPipelineLayout);
+PipelineBuilder VulkanEngine::makePipelineBuilder(MaterialHandle handle, vk::ShaderModule vertexShader, vk::ShaderModule fragmentShader) const {
+    const MaterialDescription & description = m_materialDescriptions[handle];
+    PipelineBuilder pipelineBuilder;
 
-        m_vkDevice.destroyPipeline(terrainPipeline);
-        m_vkDevice.destroyPipelineLayout(terrainPipelineLayout);
+    //This controls how to read vertices from the vertex buffers
+    pipelineBuilder.m_vertexInputInfo = vkinit::pipelineVertexInputStateCreateInfo();
+    if (description.meshVertexLayout) {
+        pipelineBuilder.m_vertexDescription = Vertex::getVertexDescription();
+    }
 
-        m_vkDevice.destroyPipeline(waterPipeline);
-        m_vkDevice.destroyPipelineLayout(waterPipelineLayout);
-    });
+    //This is the configuration for drawing triangle lists, strips, or individual points
+    //We are just drawing a triangle list.
+    pipelineBuilder.m_inputAssemblyInfo = vkinit::pipelineInputAssemblyStateCreateInfo(vk::PrimitiveTopology::eTriangleList);
+
+    //Build viewport and scissor. Both are dynamic state, set when drawing.
+    pipelineBuilder.m_viewport.x = 0.0f;
+    pipelineBuilder.m_viewport.y = 0.0f;
+    pipelineBuilder.m_viewport.width = static_cast<float>(m_swapChainExtent.width);
+    pipelineBuilder.m_viewport.height = static_cast<float>(m_swapChainExtent.height);
+    pipelineBuilder.m_viewport.minDepth = 0.0f;
+    pipelineBuilder.m_viewport.maxDepth = 1.0f;
+
+    pipelineBuilder.m_scissor.offset = vk::Offset2D{0, 0};
+    pipelineBuilder.m_scissor.extent = m_swapChainExtent; //FIXME: do we need the "real" hiDPI-aware extent here?
+
+    pipelineBuilder.m_rasterizerInfo = vkinit::pipelineRasterizationStateCreateInfo(description.polygonMode);
+    pipelineBuilder.m_rasterizerInfo.cullMode = description.cullMode;
+
+    //yes multisampling
+    pipelineBuilder.m_multisampleInfo = vkinit::multisampleStateCreateInfo(m_msaaSamples);
+
+    //a single blend attachment writing to RGBA, blending if the material asks for it
+    pipelineBuilder.m_colorBlendAttachmentState = vkinit::pipelineColorBlendAttachmentState();
+    if (description.blend != BlendMode::None) {
+        vk::BlendFactor destination = description.blend == BlendMode::Alpha ? vk::BlendFactor::eOneMinusSrcAlpha : vk::BlendFactor::eOne;
+        auto & blend = pipelineBuilder.m_colorBlendAttachmentState;
+        blend.blendEnable = VK_TRUE;
+        blend.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+        blend.dstColorBlendFactor = destination;
+        blend.colorBlendOp = vk::BlendOp::eAdd;
+        blend.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        blend.dstAlphaBlendFactor = destination;
+        blend.alphaBlendOp = vk::BlendOp::eAdd;
+    }
+
+    pipelineBuilder.m_depthStencil = vkinit::depthStencilStateCreateInfo(description.depthTest, description.depthWrite, description.depthCompare);
+
+    //Only used when building for dynamic rendering
+    pipelineBuilder.m_colorAttachmentFormat = m_colorFormat;
+    pipelineBuilder.m_depthAttachmentFormat = m_depthFormat;
+
+    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex, vertexShader));
+    pipelineBuilder.m_shaderStageInfos.push_back(vkinit::pipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eFragment, fragmentShader));
+    pipelineBuilder.setSpecialization(vk::ShaderStageFlagBits::eFragment, getSpecialization(handle));
+
+    pipelineBuilder.m_pipelineLayout = m_materials[handle].pipelineLayout;
+    return pipelineBuilder;
+}
+
+//Hands pipelines that finished building to their materials. Called between frames, so no command buffer is
+//being recorded with the materials while they change.
+void VulkanEngine::installCompiledPipelines() {
+    auto completed = m_pipelineCompiler.takeCompleted();
+    for (const auto & compiled : completed) {
+        auto pending = m_pendingPipelineKeys.find(compiled.key);
+        if (pending != m_pendingPipelineKeys.end()) {
+            m_pendingPipelineKeys.erase(pending);
+        }
+        if (!compiled.pipeline) {
+            //A failed rebuild keeps the materials' current pipelines
+            continue;
+        }
+        //Replacements for pipelines in use, from a shader reload or a feature change, are swapped in below with
+        //the rest of their batch
+        bool replacesPipeline = m_pipelineVariants.count(compiled.key) > 0;
+        for (const auto & material : m_materials) {
+            replacesPipeline |= material.pipelineKey == compiled.key && material.pipeline;
+        }
+        if (replacesPipeline) {
+            m_stagedPipelines.push_back(compiled);
+            continue;
+        }
+        m_pipelineVariants[compiled.key] = {compiled.pipeline, getMaterialHandle(compiled.name)};
+        for (auto & material : m_materials) {
+            if (material.pipelineKey == compiled.key) {
+                material.pipeline = compiled.pipeline;
+            }
+        }
+        std::cout << "Pipeline for " << compiled.name << " ready after " << compiled.compileMs << " ms" << std::endl;
+    }
+
+    if (m_pipelineCompiler.getPendingCount() > 0) {
+        return;
+    }
+
+    //No build is using the modules a reload replaced anymore
+    for (auto module : m_retiredShaderModules) {
+        m_vkDevice.destroyShaderModule(module);
+    }
+    m_retiredShaderModules.clear();
+
+    //Swap in every rebuilt pipeline at once, so a change to a shared shader never shows up on only some of the
+    //materials using it. A pipeline that's replaced (one rebuilt from changed shaders) may still be in use by the
+    //previous frame, so it's retired rather than destroyed: the frame after this one waits on that frame's fence.
+    //Other variants stay around to switch back to.
+    for (const auto & staged : m_stagedPipelines) {
+        PipelineVariant & variant = m_pipelineVariants[staged.key];
+        if (variant.pipeline) {
+            m_retiredPipelines.emplace_back(m_frameNumber + 1, variant.pipeline);
+        }
+        variant = {staged.pipeline, getMaterialHandle(staged.name)};
+        //Only materials that still want this variant; features may have changed again while it was building
+        for (auto & material : m_materials) {
+            if (material.pipelineKey == staged.key) {
+                material.pipeline = staged.pipeline;
+            }
+        }
+        std::cout << "Swapped in rebuilt pipeline for " << staged.name << " (" << staged.compileMs << " ms)" << std::endl;
+    }
+    m_stagedPipelines.clear();
+
+    if (!m_pipelineBatchActive) {
+        return;
+    }
+    m_pipelineBatchActive = false;
+
+    //Whole batch done. Startup cost with a cold cache vs. one from a previous run is what the cache is for, so always report it.
+    //It ends when the last build did, not now: the main thread may have been loading assets in the meantime.
+    auto end = m_pipelineCompiler.getIdleTime();
+    double elapsedMs = std::chrono::duration<double, std::milli>(end - m_pipelineBatchStart).count();
+    if (m_pipelineBatchIsReload) {
+        std::cout << "Rebuilt pipelines in " << elapsedMs << " ms" << std::endl;
+    }
+    else {
+        std::cout << "Created pipelines in " << elapsedMs << " ms on " << m_jobSystem.getThreadCount() << " threads ("
+                  << (m_pipelineBatchWarmCache ? "warm" : "cold") << " pipeline cache)" << std::endl;
+        m_benchmarkRecorder.setPipelineCreationTime(elapsedMs, m_pipelineBatchWarmCache);
+    }
+    m_pipelineCache.save();
+}
+
+void VulkanEngine::waitForPipelines() {
+    m_pipelineCompiler.waitIdle();
+    installCompiledPipelines();
+}
+
+void VulkanEngine::startShaderHotReload() {
+    //Benchmark runs have to render the same shaders from start to finish
+    m_hotReloadEnabled = m_benchmarkSettings.hotReloadShaders && !m_benchmarkSettings.enabled;
+    if (!m_hotReloadEnabled) {
+        return;
+    }
+    std::string sourceDirectory;
+    std::string glslc;
+#if defined(VKENG_SHADER_SOURCE_DIR) && defined(VKENG_GLSLC)
+    sourceDirectory = VKENG_SHADER_SOURCE_DIR;
+    glslc = VKENG_GLSLC;
+#endif
+    //Without the sources, rebuilt .spv files (e.g. from `make shaders`) are still picked up
+    if (!sourceDirectory.empty() && !std::filesystem::is_directory(sourceDirectory)) {
+        sourceDirectory.clear();
+    }
+    m_shaderWatcher.start(sourceDirectory, "shaders", glslc);
+}
+
+void VulkanEngine::reloadChangedShaders() {
+    auto changes = m_shaderWatcher.takeChanges();
+    if (changes.empty()) {
+        return;
+    }
+    PROFILE_FUNCTION();
+
+    std::unordered_set<std::string> changedPaths;
+    std::vector<MaterialHandle> handles;
+    for (const auto & change : changes) {
+        auto usesShader = [&](MaterialHandle handle) {
+            const MaterialDescription & description = m_materialDescriptions[handle];
+            return description.vertexShader == change.path || description.fragmentShader == change.path;
+        };
+        std::vector<MaterialHandle> users;
+        for (MaterialHandle handle = 0; handle < m_materials.size(); handle++) {
+            if (usesShader(handle)) {
+                users.push_back(handle);
+            }
+        }
+        if (users.empty()) {
+            continue;
+        }
+
+        ShaderReflection reflection;
+        try {
+            reflection = reflectShader(change.code.data(), change.code.size());
+        }
+        catch (const std::exception & e) {
+            std::cout << "Ignoring " << change.path << ": " << e.what() << std::endl;
+            continue;
+        }
+        std::cout << "Shader " << change.path << " changed." << std::endl;
+
+        //Pipelines are swapped in without touching the layouts or what's pushed, so the interface has to stay the
+        //same for every material using the shader, since they all share its module
+        std::swap(m_shaderReflections[change.path], reflection);
+        bool compatible = true;
+        for (MaterialHandle handle : users) {
+            Material reloaded = m_materials[handle];
+            if (!createMaterialLayout(m_materialDescriptions[handle], reloaded) || reloaded.pipelineLayout != m_materials[handle].pipelineLayout ||
+                reloaded.meshConstantStages != m_materials[handle].meshConstantStages || reloaded.textureIndexStages != m_materials[handle].textureIndexStages) {
+                std::cout << "The shader interface of " << m_materials[handle].name << " changed, restart to pick it up." << std::endl;
+                compatible = false;
+                break;
+            }
+        }
+        if (!compatible) {
+            std::swap(m_shaderReflections[change.path], reflection);
+            continue;
+        }
+
+        //Creating a module only copies the SPIR-V; compiling is left to the pipeline builds on the job system.
+        //Builds already submitted may still use the old module.
+        vk::ShaderModuleCreateInfo info = {};
+        info.setCode(change.code);
+        vk::ShaderModule module = m_vkDevice.createShaderModule(info);
+        auto cached = m_shaderModules.find(change.path);
+        if (cached != m_shaderModules.end()) {
+            m_retiredShaderModules.push_back(cached->second);
+        }
+        m_shaderModules[change.path] = module;
+
+        changedPaths.insert(change.path);
+        for (MaterialHandle handle : users) {
+            if (std::find(handles.begin(), handles.end(), handle) == handles.end()) {
+                handles.push_back(handle);
+            }
+        }
+    }
+    auto usesChangedShader = [&](MaterialHandle handle) {
+        const MaterialDescription & description = m_materialDescriptions[handle];
+        return changedPaths.count(description.vertexShader) > 0 || changedPaths.count(description.fragmentShader) > 0;
+    };
+
+    //Only the pipelines in use are rebuilt. Other variants were built from the old shaders, so they're dropped.
+    for (auto it = m_pipelineVariants.begin(); it != m_pipelineVariants.end();) {
+        bool inUse = false;
+        for (const auto & material : m_materials) {
+            inUse |= material.pipeline == it->second.pipeline;
+        }
+        if (!inUse && usesChangedShader(it->second.builtFor)) {
+            m_retiredPipelines.emplace_back(m_frameNumber + 1, it->second.pipeline);
+            it = m_pipelineVariants.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    rebuildPipelines(handles);
+}
+
+void VulkanEngine::setShaderFeatures(const ShaderFeatures &features) {
+    m_shaderFeatures = features;
+    //Pipelines built before are switched to straight away, since no frame is being recorded right now
+    std::vector<MaterialHandle> missing;
+    for (MaterialHandle handle = 0; handle < m_materials.size(); handle++) {
+        Material & material = m_materials[handle];
+        material.pipelineKey = getPipelineKey(handle);
+        auto it = m_pipelineVariants.find(material.pipelineKey);
+        if (it != m_pipelineVariants.end()) {
+            material.pipeline = it->second.pipeline;
+        }
+        else if (m_pendingPipelineKeys.count(material.pipelineKey) == 0) {
+            missing.push_back(handle);
+        }
+    }
+    rebuildPipelines(missing);
+}
+
+ShaderSpecialization VulkanEngine::getSpecialization(MaterialHandle handle) const {
+    const MaterialDescription & description = m_materialDescriptions[handle];
+    ShaderSpecialization specialization;
+    if (description.textureCount > 0) {
+        specialization.setInt(SPEC_TEXTURE_COUNT, static_cast<int32_t>(description.textureCount));
+    }
+    if (description.lighting) {
+        specialization.setBool(SPEC_SPECULAR, m_shaderFeatures.specular);
+    }
+    if (description.terrain) {
+        float minHeight, maxHeight;
+        getTerrainBlendRange(minHeight, maxHeight);
+        specialization.setFloat(SPEC_TERRAIN_HEIGHT_RANGE, minHeight);
+        specialization.setFloat(SPEC_TERRAIN_HEIGHT_RANGE + 1, maxHeight);
+        specialization.setBool(SPEC_TERRAIN_BLENDING, m_shaderFeatures.terrainBlending);
+    }
+    return specialization;
+}
+
+uint64_t VulkanEngine::getPipelineKey(MaterialHandle handle) const {
+    uint64_t key = m_materialDescriptions[handle].getStateHash();
+    VkPipelineLayout layout = m_materials[handle].pipelineLayout;
+    key = hashBytes(key, &layout, sizeof(layout));
+    uint64_t specializationKey = getSpecialization(handle).getKey();
+    return hashBytes(key, &specializationKey, sizeof(specializationKey));
+}
+
+void VulkanEngine::rebuildPipelines(const std::vector<MaterialHandle> &handles) {
+    std::unordered_set<uint64_t> submitted;
+    for (MaterialHandle handle : handles) {
+        //Materials with identical state share the pipeline, so it's only built once
+        uint64_t key = m_materials[handle].pipelineKey;
+        if (!submitted.insert(key).second) {
+            continue;
+        }
+        const MaterialDescription & description = m_materialDescriptions[handle];
+        PipelineBuilder builder = makePipelineBuilder(handle, getShaderModule(description.vertexShader), getShaderModule(description.fragmentShader));
+        //m_renderPass is null with dynamic rendering, which builds against the attachment formats instead
+        m_pipelineCompiler.submit(description.name, key, builder, m_renderPass, m_pipelineCache.get());
+        m_pendingPipelineKeys.insert(key);
+    }
+
+    if (submitted.empty()) {
+        return;
+    }
+    std::cout << "Building " << submitted.size() << " pipelines in the background." << std::endl;
+    if (!m_pipelineBatchActive) {
+        m_pipelineBatchStart = std::chrono::high_resolution_clock::now();
+        m_pipelineBatchIsReload = true;
+        m_pipelineBatchActive = true;
+    }
+}
+
+void VulkanEngine::destroyRetiredPipelines(bool force) {
+    auto it = m_retiredPipelines.begin();
+    while (it != m_retiredPipelines.end()) {
+        if (force || it->first <= m_frameNumber) {
+            m_vkDevice.destroyPipeline(it->second);
+            it = m_retiredPipelines.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
 }
 
 void VulkanEngine::loadMeshes() {
     //Monke mesh
     Mesh monke;
-    monke.loadFromObj("data/assets/monkey_smooth.obj");
-    uploadMesh(monke);
+    loadMesh("data/assets/monkey_smooth.obj", monke);
     m_meshes["monkey"] = monke;
 //
 //    //Minecraft mesh
 //    Mesh mine;
-//    mine.loadFromObj("data/assets/lost_empire.obj");
-//    uploadMesh(mine);
+//    loadMesh("data/assets/lost_empire.obj", mine);
 //    m_meshes["mine"] = mine;
 
     //Heightmap
     Mesh heightmap;
-    heightmap.loadFromHeightmap("data/assets/test_heightmap.png");
-    uploadMesh(heightmap);
+    loadMesh("data/assets/test_heightmap.png", heightmap);
     m_meshes["heightmap"] = heightmap;
 
     std::cout << "Loaded meshes." << std::endl;
 }
 
+bool VulkanEngine::loadMesh(const std::string &path, Mesh &mesh) {
+    PROFILE_FUNCTION();
+    auto start = std::chrono::high_resolution_clock::now();
+    auto printLoaded = [&](const char * from) {
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Loaded mesh " << path << " (" << mesh.vertexCount << " vertices, " << mesh.indexCount << " indices) from "
+                  << from << " in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    };
+    uint32_t flags = m_benchmarkSettings.optimizeMeshes ? MESH_CACHE_OPTIMIZED : 0;
+    MeshCacheView cache;
+
+    //Packed meshes are cooked from the sources at build time, so they're used without hashing the source
+    AssetBlob blob = m_assetPack.find(path, AssetType::Mesh);
+    if (blob) {
+        if (parseMeshCache(blob.data, blob.size, cache) && cache.header.flags == flags) {
+            uploadMeshCache(cache, mesh);
+            printLoaded("the asset pack");
+            return true;
+        }
+        std::cout << "Packed mesh " << path << " was cooked by another version or with other settings, loading its source." << std::endl;
+    }
+
+    MappedFile source;
+    if (!source.open(path)) {
+        std::cout << "Failed to read mesh " << path << std::endl;
+        return false;
+    }
+    uint64_t sourceHash = hashMeshSource(source.data(), source.size());
+    source.close();
+    std::string cachePath = getMeshCachePath(path);
+    if (m_benchmarkSettings.meshCache) {
+        MappedFile cacheFile;
+        if (cacheFile.open(cachePath) && parseMeshCache(cacheFile.data(), cacheFile.size(), cache) &&
+            cache.header.sourceHash == sourceHash && cache.header.flags == flags) {
+            uploadMeshCache(cache, mesh);
+            printLoaded(cachePath.c_str());
+            return true;
+        }
+    }
+
+    bool obj = std::filesystem::path(path).extension() == ".obj";
+    if (!(obj ? mesh.loadFromObj(path.c_str(), &m_jobSystem) : mesh.loadFromHeightmap(path.c_str()))) {
+        std::cout << "Failed to load mesh " << path << std::endl;
+        return false;
+    }
+    if (m_benchmarkSettings.optimizeMeshes) {
+        mesh.optimize(path.c_str());
+    }
+    //A failed write only costs the next start the same load again
+    if (m_benchmarkSettings.meshCache) {
+        writeMeshCache(cachePath, buildMeshCache(mesh, sourceHash, flags));
+    }
+    uploadMesh(mesh);
+    printLoaded("its source");
+    return true;
+}
+
+void VulkanEngine::uploadMeshCache(const MeshCacheView &cache, Mesh &mesh) {
+    //The blobs are already laid out the way the buffers are, so they're copied as they are
+    const MeshCacheHeader & header = cache.header;
+    uploadMesh(mesh, header.vertexCount, header.indexCount, [&](Vertex * vertices, uint16_t * indices) {
+        memcpy(vertices, cache.vertices, static_cast<size_t>(header.vertexCount) * sizeof(Vertex));
+        memcpy(indices, cache.indices, static_cast<size_t>(header.indexCount) * sizeof(uint16_t));
+    }, true, MemoryCategory::Meshes);
+    mesh.boundingRadius = header.boundingRadius;
+}
+
 //Uploads a mesh to a GPU local buffer
-void VulkanEngine::uploadMesh(Mesh &mesh, bool addToDeletionQueue) {
-    //Allocate a CPU side staging buffer to hold mesh before uploading
-    const size_t bufferSize = mesh.vertices.size() * sizeof(Vertex);
-    AllocatedBuffer stagingBuffer = createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, vma::MemoryUsage::eCpuOnly);
+void VulkanEngine::uploadMesh(Mesh &mesh, bool addToDeletionQueue, MemoryCategory category) {
+    uploadMesh(mesh, static_cast<uint32_t>(mesh.vertices.size()), static_cast<uint32_t>(mesh.indices.size()), [&](Vertex * vertices, uint16_t * indices) {
+        std::copy(mesh.vertices.begin(), mesh.vertices.end(), vertices);
+        std::copy(mesh.indices.begin(), mesh.indices.end(), indices);
+    }, addToDeletionQueue, category);
+    for (const auto & vertex : mesh.vertices) {
+        mesh.boundingRadius = std::max(mesh.boundingRadius, glm::length(vertex.position));
+    }
+    //Drawing only needs the counts, and meshes get copied around
+    std::vector<Vertex>().swap(mesh.vertices);
+    std::vector<uint16_t>().swap(mesh.indices);
+}
+
+void VulkanEngine::uploadMesh(Mesh &mesh, uint32_t vertexCount, uint32_t indexCount, const std::function<void(Vertex *, uint16_t *)> &write,
+                              bool addToDeletionQueue, MemoryCategory category) {
+    PROFILE_FUNCTION();
+    mesh.vertexCount = vertexCount;
+    mesh.indexCount = indexCount;
 
-    //Copy vertex data into this buffer
-    Vertex * vertexData = static_cast<Vertex *>(m_allocator.mapMemory(stagingBuffer.allocation));
-    std::copy(mesh.vertices.begin(), mesh.vertices.end(), vertexData);
-    m_allocator.unmapMemory(stagingBuffer.allocation);
+    //Vertices and indices are written into one staging allocation and copied in one submission
+    const size_t bufferSize = vertexCount * sizeof(Vertex);
+    const size_t indexBufferSize = indexCount * sizeof(uint16_t);
+    unsigned char * stagingData = getUploadStaging(bufferSize + indexBufferSize);
+    write(reinterpret_cast<Vertex *>(stagingData), reinterpret_cast<uint16_t *>(stagingData + bufferSize));
 
     //Allocate GPU side vertex buffer that actually holds the mesh in VRAM
-    mesh.vertexBuffer = createBuffer(bufferSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vma::MemoryUsage::eGpuOnly);
+    mesh.vertexBuffer = createBuffer(bufferSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vma::MemoryUsage::eGpuOnly, category);
+    if (indexCount > 0) {
+        mesh.indexBuffer = createBuffer(indexBufferSize, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vma::MemoryUsage::eGpuOnly, category);
+    }
 
     //Submit copy command
-    submitImmediateCommand([=](vk::CommandBuffer cmd) {
+    submitImmediateCommand([&](vk::CommandBuffer cmd) {
         vk::BufferCopy copy = {};
         copy.dstOffset = 0;
         copy.srcOffset = 0;
         copy.size = bufferSize;
-        cmd.copyBuffer(stagingBuffer.buffer, mesh.vertexBuffer.buffer, copy);
+        cmd.copyBuffer(m_uploadContext.stagingBuffer.buffer, mesh.vertexBuffer.buffer, copy);
+        if (indexCount > 0) {
+            copy.srcOffset = bufferSize;
+            copy.size = indexBufferSize;
+            cmd.copyBuffer(m_uploadContext.stagingBuffer.buffer, mesh.indexBuffer.buffer, copy);
+        }
     });
 
     //Clean up
     if (addToDeletionQueue) {
+        AllocatedBuffer vertexBuffer = mesh.vertexBuffer;
+        AllocatedBuffer indexBuffer = mesh.indexBuffer;
         m_mainDeletionQueue.pushFunction([=]() {
-            destroyBuffer(mesh.vertexBuffer);
-        });
-    }
-    destroyBuffer(stagingBuffer);
-
-    //Do the same for the index buffer
-    if (!mesh.indices.empty()) {
-        const size_t indexBufferSize = mesh.indices.size() * sizeof(uint16_t);
-        AllocatedBuffer indexStagingBuffer = createBuffer(indexBufferSize, vk::BufferUsageFlagBits::eTransferSrc, vma::MemoryUsage::eCpuOnly);
-
-        uint16_t * indexData = static_cast<uint16_t *>(m_allocator.mapMemory(indexStagingBuffer.allocation));
-        std::copy(mesh.indices.begin(), mesh.indices.end(), indexData);
-        m_allocator.unmapMemory(indexStagingBuffer.allocation);
-        mesh.indexBuffer = createBuffer(indexBufferSize, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vma::MemoryUsage::eGpuOnly);
-        submitImmediateCommand([=](vk::CommandBuffer cmd) {
-            vk::BufferCopy copy = {};
-            copy.dstOffset = 0;
-            copy.srcOffset = 0;
-            copy.size = indexBufferSize;
-            cmd.copyBuffer(indexStagingBuffer.buffer, mesh.indexBuffer.buffer, copy);
+            destroyBuffer(vertexBuffer);
+            if (indexCount > 0) {
+                destroyBuffer(indexBuffer);
+            }
         });
-        if (addToDeletionQueue) {
-            m_mainDeletionQueue.pushFunction([=]() {
-                destroyBuffer(mesh.indexBuffer);
-            });
-        }
-        destroyBuffer(indexStagingBuffer);
     }
 }
 
@@ -1555,15 +2734,18 @@ void VulkanEngine::recreateSwapChain() {
 
     cleanupSwapChain();
     createSwapChain();
-    createFramebuffers();
+    //Dynamic rendering only needs the new image views, which createSwapChain made
+    if (!m_dynamicRenderingEnabled) {
+        createFramebuffers();
+    }
 }
 
 void VulkanEngine::cleanupSwapChain() {
     m_vkDevice.destroyImageView(m_colorImageView);
-    m_allocator.destroyImage(m_colorImage.image, m_colorImage.allocation);
+    destroyImage(m_colorImage);
 
     m_vkDevice.destroyImageView(m_depthImageView);
-    m_allocator.destroyImage(m_depthImage.image, m_depthImage.allocation);
+    destroyImage(m_depthImage);
 
     for (auto buf : m_swapChainFramebuffers) {
         m_vkDevice.destroyFramebuffer(buf);
@@ -1577,24 +2759,27 @@ void VulkanEngine::cleanupSwapChain() {
 }
 
 void VulkanEngine::recreatePipelines() {
+    waitForPipelines();
+    m_vkDevice.waitIdle();
+    destroyRetiredPipelines(true);
     m_pipelineDeletionQueue.flush();
     createPipelines();
 }
 
-Material *VulkanEngine::createMaterial(vk::Pipeline pipeline, vk::PipelineLayout layout, const std::string &name) {
-    Material mat;
-    mat.pipeline = pipeline;
-    mat.pipelineLayout = layout;
-    m_materials[name] = mat;
-    return &m_materials[name];
+MaterialHandle VulkanEngine::getMaterialHandle(const std::string &name) const {
+    auto it = m_materialHandles.find(name);
+    if (it == m_materialHandles.end()) {
+        return INVALID_MATERIAL;
+    }
+    return it->second;
 }
 
 Material *VulkanEngine::getMaterial(const std::string &name) {
-    auto it = m_materials.find(name);
-    if (it == m_materials.end()) {
+    MaterialHandle handle = getMaterialHandle(name);
+    if (handle == INVALID_MATERIAL) {
         return nullptr;
     }
-    return &(it->second);
+    return &m_materials[handle];
 }
 
 Mesh *VulkanEngine::getMesh(const std::string &name) {
@@ -1609,7 +2794,8 @@ FrameData &VulkanEngine::getCurrentFrame() {
     return m_frames[m_frameNumber % FRAMES_IN_FLIGHT];
 }
 
-AllocatedBuffer VulkanEngine::createBuffer(size_t size, vk::BufferUsageFlags usageFlags, vma::MemoryUsage memoryUsage) {
+AllocatedBuffer VulkanEngine::createBuffer(size_t size, vk::BufferUsageFlags usageFlags, vma::MemoryUsage memoryUsage,
+                                           MemoryCategory category) {
     vk::BufferCreateInfo info = {};
     info.size = size;
     info.usage = usageFlags;
@@ -1621,14 +2807,32 @@ AllocatedBuffer VulkanEngine::createBuffer(size_t size, vk::BufferUsageFlags usa
     auto pair = m_allocator.createBuffer(info, allocInfo);
     buffer.buffer = pair.first;
     buffer.allocation = pair.second;
+    m_memoryTelemetry.trackAllocation(buffer.allocation, category);
 
     return buffer;
 }
 
 void VulkanEngine::destroyBuffer(AllocatedBuffer buffer) {
+    m_memoryTelemetry.untrackAllocation(buffer.allocation);
     m_allocator.destroyBuffer(buffer.buffer, buffer.allocation);
 }
 
+AllocatedImage VulkanEngine::createImage(const vk::ImageCreateInfo &info, const vma::AllocationCreateInfo &allocInfo,
+                                         MemoryCategory category) {
+    AllocatedImage image;
+    auto pair = m_allocator.createImage(info, allocInfo);
+    image.image = pair.first;
+    image.allocation = pair.second;
+    m_memoryTelemetry.trackAllocation(image.allocation, category);
+
+    return image;
+}
+
+void VulkanEngine::destroyImage(AllocatedImage image) {
+    m_memoryTelemetry.untrackAllocation(image.allocation);
+    m_allocator.destroyImage(image.image, image.allocation);
+}
+
 //Pads a given size to align with the minimum uniform buffer offset alignment value.
 size_t VulkanEngine::padUniformBufferSize(size_t originalSize) {
     size_t minUboAlignment = m_gpuProperties.limits.minUniformBufferOffsetAlignment;
@@ -1639,7 +2843,52 @@ size_t VulkanEngine::padUniformBufferSize(size_t originalSize) {
     return alignedSize;
 }
 
+AllocatedBuffer VulkanEngine::createStagingBuffer(vk::DeviceSize capacity, unsigned char *&data) {
+    vk::BufferCreateInfo info = {};
+    info.size = capacity;
+    info.usage = vk::BufferUsageFlagBits::eTransferSrc;
+
+    //Persistently mapped, and cached on the host if possible: image decoders read back rows they've just written,
+    //which is very slow from write-combined memory
+    vma::AllocationCreateInfo allocInfo = {};
+    allocInfo.usage = vma::MemoryUsage::eCpuOnly;
+    allocInfo.flags = vma::AllocationCreateFlagBits::eMapped;
+    allocInfo.preferredFlags = vk::MemoryPropertyFlagBits::eHostCached;
+
+    auto pair = m_allocator.createBuffer(info, allocInfo);
+    AllocatedBuffer buffer = {pair.first, pair.second};
+    m_memoryTelemetry.trackAllocation(buffer.allocation, MemoryCategory::Staging);
+    data = static_cast<unsigned char *>(m_allocator.getAllocationInfo(buffer.allocation).pMappedData);
+    return buffer;
+}
+
+unsigned char * VulkanEngine::getUploadStaging(vk::DeviceSize size) {
+    if (size <= m_uploadContext.stagingCapacity) {
+        return m_uploadContext.stagingData;
+    }
+    if (m_uploadContext.stagingBuffer.buffer) {
+        destroyBuffer(m_uploadContext.stagingBuffer);
+    }
+    vk::DeviceSize capacity = UPLOAD_STAGING_SIZE;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    m_uploadContext.stagingBuffer = createStagingBuffer(capacity, m_uploadContext.stagingData);
+    m_uploadContext.stagingCapacity = capacity;
+    return m_uploadContext.stagingData;
+}
+
+void VulkanEngine::trimUploadStaging() {
+    if (m_uploadContext.stagingCapacity > UPLOAD_STAGING_SIZE) {
+        destroyBuffer(m_uploadContext.stagingBuffer);
+        m_uploadContext.stagingBuffer = {};
+        m_uploadContext.stagingData = nullptr;
+        m_uploadContext.stagingCapacity = 0;
+    }
+}
+
 void VulkanEngine::submitImmediateCommand(std::function<void(vk::CommandBuffer)> &&function) {
+    PROFILE_FUNCTION();
     auto cmd = m_uploadContext.commandBuffer;
 
     //Begin recording. We use this buffer only once, so give Vulkan a hint about that
@@ -1662,169 +2911,909 @@ void VulkanEngine::submitImmediateCommand(std::function<void(vk::CommandBuffer)>
     m_vkDevice.resetCommandPool(m_uploadContext.commandPool);
 }
 
-AllocatedImage VulkanEngine::loadImageFromFile(const char *filename) {
-    int texWidth, texHeight, texChannels;
+//Where tools/compress_textures.cpp puts the compressed version of a source image, see CMakeLists.txt
+static std::string getCompressedTexturePath(const std::string & sourceFile) {
+    return "textures/" + std::filesystem::path(sourceFile).stem().string() + ".ktx2";
+}
+
+bool VulkanEngine::openCompressedTextures(const std::vector<std::string> &sourceFiles, std::vector<KtxTexture> &files) const {
+    if (!m_textureCompressionBCEnabled) {
+        return false;
+    }
+    files = std::vector<KtxTexture>(sourceFiles.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        AssetBlob blob = m_assetPack.find(sourceFiles[i], AssetType::Texture);
+        bool opened = blob ? files[i].openMemory(blob.data, blob.size) : files[i].open(getCompressedTexturePath(sourceFiles[i]));
+        if (!opened) {
+            return false;
+        }
+        if (files[i].getFormat() != files[0].getFormat() || files[i].getWidth() != files[0].getWidth() ||
+            files[i].getHeight() != files[0].getHeight() || files[i].getLevelCount() != files[0].getLevelCount() ||
+            (files.size() > 1 && files[i].getLayerCount() != 1)) {
+            std::cout << "Compressed texture for " << sourceFiles[i] << " doesn't match the other layers." << std::endl;
+            return false;
+        }
+    }
+    vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    vk::Format format = static_cast<vk::Format>(files[0].getFormat());
+    return (m_activeGPU.getFormatProperties(format).optimalTilingFeatures & required) == required;
+}
+
+bool VulkanEngine::canBlitMips(vk::Format format) const {
+    vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    return (m_activeGPU.getFormatProperties(format).optimalTilingFeatures & required) == required;
+}
+
+uint32_t VulkanEngine::getTextureMipLevels(uint32_t width, uint32_t height) const {
+    if (!m_benchmarkSettings.mipmaps) {
+        return 1;
+    }
+    return getMipLevelCount(width, height);
+}
 
-    //Load  image from file
-    unsigned char * pixels = stbi_load(filename, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    if (!pixels) {
-        std::cout << "Failed to load texture from file " << filename << std::endl;
-        throw std::invalid_argument("Failed to load texture");
+vk::SamplerCreateInfo VulkanEngine::textureSamplerCreateInfo(vk::SamplerAddressMode addressMode) const {
+    vk::SamplerCreateInfo info = vkinit::samplerCreateInfo(vk::Filter::eLinear, addressMode);
+    //Tiled terrain textures are seen at grazing angles, where plain trilinear filtering blurs them
+    if (m_samplerAnisotropyEnabled) {
+        info.anisotropyEnable = VK_TRUE;
+        info.maxAnisotropy = std::min(m_benchmarkSettings.maxAnisotropy, m_gpuProperties.limits.maxSamplerAnisotropy);
     }
+    return info;
+}
 
-    //Create staging buffer to hold the image
-    vk::DeviceSize imgSize = texWidth * texHeight * 4; //4 bytes per pixel
-    vk::Format imgFormat = vk::Format::eR8G8B8A8Srgb; //...and RGBA
-    AllocatedBuffer stagingBuffer = createBuffer(imgSize, vk::BufferUsageFlagBits::eTransferSrc, vma::MemoryUsage::eCpuOnly);
+//The copy of one mip level, with all array layers packed one after another, from a staging buffer
+static vk::BufferImageCopy getLevelCopyRegion(const vk::ImageCreateInfo & info, uint32_t level, vk::DeviceSize bufferOffset) {
+    vk::BufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = bufferOffset;
+    copyRegion.bufferRowLength = 0;
+    copyRegion.bufferImageHeight = 0;
+    copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    copyRegion.imageSubresource.mipLevel = level;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = info.arrayLayers;
+    copyRegion.imageExtent.width = std::max(info.extent.width >> level, 1u);
+    copyRegion.imageExtent.height = std::max(info.extent.height >> level, 1u);
+    copyRegion.imageExtent.depth = 1;
+    return copyRegion;
+}
 
-    //Copy pixel data into staging buffer
-    unsigned char * stagingData = static_cast<unsigned char *>(m_allocator.mapMemory(stagingBuffer.allocation));
-    memcpy(stagingData, pixels, static_cast<size_t>(imgSize));
-    m_allocator.unmapMemory(stagingBuffer.allocation);
+//Records copying an image's levels in from a staging buffer. With blitMips only the first level is copied and the
+//rest of the mip chain is blitted down from it. The whole image ends up shader readable.
+static void recordImageUpload(vk::CommandBuffer cmd, vk::Buffer stagingBuffer, vk::Image image, const vk::ImageCreateInfo & info,
+                              const std::vector<vk::BufferImageCopy> & copyRegions, bool blitMips) {
+    //First, transform the image, so it can be written to
+    vk::ImageSubresourceRange range = {};
+    range.aspectMask = vk::ImageAspectFlagBits::eColor;
+    range.baseMipLevel = 0;
+    range.levelCount = info.mipLevels;
+    range.baseArrayLayer = 0;
+    range.layerCount = info.arrayLayers;
+
+    vk::ImageMemoryBarrier imgBarrier_toTransfer = {};
+    imgBarrier_toTransfer.oldLayout = vk::ImageLayout::eUndefined;
+    imgBarrier_toTransfer.newLayout = vk::ImageLayout::eTransferDstOptimal;
+    imgBarrier_toTransfer.image = image;
+    imgBarrier_toTransfer.subresourceRange = range;
+    imgBarrier_toTransfer.srcAccessMask = vk::AccessFlagBits::eNone;
+    imgBarrier_toTransfer.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+    //This barrier transitions the image into the transfer write layout
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, imgBarrier_toTransfer);
+
+    //Next, transfer the image from the staging buffer into the image
+    cmd.copyBufferToImage(stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+
+    //The image is now copied, so we need to transform it once more into a shader-readable layout
+    vk::ImageMemoryBarrier imgBarrier_toReadable = imgBarrier_toTransfer;
+    imgBarrier_toReadable.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    imgBarrier_toReadable.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    imgBarrier_toReadable.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    imgBarrier_toReadable.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+    if (blitMips) {
+        //Each level is blitted from the one before it, which is then done and can be made readable
+        int32_t width = static_cast<int32_t>(info.extent.width);
+        int32_t height = static_cast<int32_t>(info.extent.height);
+        for (uint32_t level = 1; level < info.mipLevels; level++) {
+            vk::ImageMemoryBarrier toBlitSource = imgBarrier_toTransfer;
+            toBlitSource.subresourceRange.baseMipLevel = level - 1;
+            toBlitSource.subresourceRange.levelCount = 1;
+            toBlitSource.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+            toBlitSource.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+            toBlitSource.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            toBlitSource.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, toBlitSource);
+
+            int32_t mipWidth = std::max(width / 2, 1);
+            int32_t mipHeight = std::max(height / 2, 1);
+            vk::ImageBlit blit = {};
+            blit.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, info.arrayLayers);
+            blit.srcOffsets[1] = vk::Offset3D(width, height, 1);
+            blit.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, info.arrayLayers);
+            blit.dstOffsets[1] = vk::Offset3D(mipWidth, mipHeight, 1);
+            cmd.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+            vk::ImageMemoryBarrier sourceToReadable = toBlitSource;
+            sourceToReadable.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+            sourceToReadable.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+            sourceToReadable.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+            sourceToReadable.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, sourceToReadable);
+
+            width = mipWidth;
+            height = mipHeight;
+        }
+        //Only the last level is left in the transfer write layout
+        imgBarrier_toReadable.subresourceRange.baseMipLevel = info.mipLevels - 1;
+        imgBarrier_toReadable.subresourceRange.levelCount = 1;
+    }
+    //This barrier transitions the image into shader readable layout
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, imgBarrier_toReadable);
+}
 
-    stbi_image_free(pixels);
+AllocatedImage VulkanEngine::uploadImage(const vk::ImageCreateInfo &imgCreateInfo, const void *data, vk::DeviceSize size) {
+    //Mip levels are blitted down from the first one on the GPU where the format allows linear blits, otherwise
+    //they're built on the CPU and uploaded with it
+    vk::ImageCreateInfo info = imgCreateInfo;
+    bool blitMips = info.mipLevels > 1 && canBlitMips(info.format);
+    std::vector<unsigned char> cpuMips;
+    if (info.mipLevels > 1 && !blitMips) {
+        if (info.format != vk::Format::eR8G8B8A8Srgb && info.format != vk::Format::eR8G8B8A8Unorm) {
+            throw std::runtime_error("Can't generate mip levels for " + vk::to_string(info.format) + " images.");
+        }
+        cpuMips = buildMipChain(static_cast<const unsigned char *>(data), info.extent.width, info.extent.height, info.arrayLayers,
+                                info.mipLevels, info.format == vk::Format::eR8G8B8A8Srgb);
+    }
+    if (blitMips) {
+        info.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
 
+    //Copy pixel data into staging memory, the CPU built levels right after the first one
+    unsigned char * stagingData = getUploadStaging(size + cpuMips.size());
+    memcpy(stagingData, data, static_cast<size_t>(size));
+    if (!cpuMips.empty()) {
+        memcpy(stagingData + size, cpuMips.data(), cpuMips.size());
+    }
 
-    //Create the image
-    vk::Extent3D imgExtent = {};
-    imgExtent.width = static_cast<uint32_t>(texWidth);
-    imgExtent.height = static_cast<uint32_t>(texHeight);
-    imgExtent.depth = 1;
+    std::vector<vk::BufferImageCopy> copyRegions = {getLevelCopyRegion(info, 0, 0)};
+    vk::DeviceSize bufferOffset = size;
+    for (uint32_t level = 1; level < info.mipLevels && !cpuMips.empty(); level++) {
+        copyRegions.push_back(getLevelCopyRegion(info, level, bufferOffset));
+        bufferOffset += getMipLevelSize(info.extent.width, info.extent.height, info.arrayLayers, level);
+    }
 
-    vk::ImageCreateInfo imgCreateInfo = vkinit::imageCreateInfo(imgFormat, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, imgExtent);
     vma::AllocationCreateInfo imgAllocInfo = {};
     imgAllocInfo.usage = vma::MemoryUsage::eGpuOnly;
-    auto imgPair = m_allocator.createImage(imgCreateInfo, imgAllocInfo);
-    AllocatedImage image;
-    image.image = imgPair.first;
-    image.allocation = imgPair.second;
+    AllocatedImage image = createImage(info, imgAllocInfo, MemoryCategory::Textures);
 
     //Copy the image
-    submitImmediateCommand([=](vk::CommandBuffer cmd) {
-        //First, transform the image, so it can be written to
-        vk::ImageSubresourceRange range = {};
-        range.aspectMask = vk::ImageAspectFlagBits::eColor;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
-        vk::ImageMemoryBarrier imgBarrier_toTransfer = {};
-        imgBarrier_toTransfer.oldLayout = vk::ImageLayout::eUndefined;
-        imgBarrier_toTransfer.newLayout = vk::ImageLayout::eTransferDstOptimal;
-        imgBarrier_toTransfer.image = image.image;
-        imgBarrier_toTransfer.subresourceRange = range;
-        imgBarrier_toTransfer.srcAccessMask = vk::AccessFlagBits::eNone;
-        imgBarrier_toTransfer.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-        //This barrier transitions the image into the transfer write layout
-        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, imgBarrier_toTransfer);
-
-        //Next, transfer the image from the staging buffer into the image
-        vk::BufferImageCopy copyRegion = {};
-        copyRegion.bufferOffset = 0;
-        copyRegion.bufferRowLength = 0;
-        copyRegion.bufferImageHeight = 0;
-        copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-        copyRegion.imageSubresource.mipLevel = 0;
-        copyRegion.imageSubresource.baseArrayLayer = 0;
-        copyRegion.imageSubresource.layerCount = 1;
-        copyRegion.imageExtent = imgExtent;
-
-        cmd.copyBufferToImage(stagingBuffer.buffer, image.image, vk::ImageLayout::eTransferDstOptimal, copyRegion);
-
-        //The image is now copied, so we need to transform it once more into a shader-readable layout
-        vk::ImageMemoryBarrier imgBarrier_toReadable = imgBarrier_toTransfer;
-        imgBarrier_toReadable.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-        imgBarrier_toReadable.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        imgBarrier_toReadable.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        imgBarrier_toReadable.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-        //This barrier transitions the image into shader readable layout
-        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, imgBarrier_toReadable);
+    submitImmediateCommand([&](vk::CommandBuffer cmd) {
+        recordImageUpload(cmd, m_uploadContext.stagingBuffer.buffer, image.image, info, copyRegions, blitMips);
     });
 
     //Cleanup
     m_mainDeletionQueue.pushFunction([=]() {
-        m_allocator.destroyImage(image.image, image.allocation);
+        destroyImage(image);
     });
-    destroyBuffer(stagingBuffer);
-
-    std::cout << "Loaded texture " << filename << std::endl;
 
     return image;
 }
 
-Texture VulkanEngine::loadTexture(std::string file) {
-    Texture tex;
-    tex.image = loadImageFromFile(file.c_str());
-    vk::ImageViewCreateInfo imgInfo = vkinit::imageViewCreateInfo(vk::Format::eR8G8B8A8Srgb, tex.image.image, vk::ImageAspectFlagBits::eColor);
-    tex.imageView = m_vkDevice.createImageView(imgInfo);
-    m_mainDeletionQueue.pushFunction([=]() {
-        m_vkDevice.destroyImageView(tex.imageView);
+std::vector<Texture> VulkanEngine::loadTextureBatch(const std::vector<TextureLoadRequest> &requests) {
+    PROFILE_FUNCTION();
+    if (requests.empty()) {
+        return {};
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+
+    //Lay out every texture's part of the staging buffer first. The sizes come from the KTX2 headers or the image
+    //headers, so the buffer exists before anything is decoded and the jobs can write straight into it.
+    struct PendingTexture {
+        std::vector<KtxTexture> compressed; //one mapped file per layer file, empty if it's decoded from the sources
+        vk::ImageCreateInfo info;
+        bool blitMips = false;
+        std::vector<vk::BufferImageCopy> copyRegions; //one per level in the staging buffer
+        AllocatedImage image;
+    };
+    //Each layer file is one job
+    struct LayerJob {
+        size_t texture;
+        uint32_t file;
+    };
+    std::vector<PendingTexture> pending(requests.size());
+    std::vector<LayerJob> jobs;
+    vk::DeviceSize stagingSize = 0;
+    size_t compressedCount = 0;
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto & files = requests[i].layerFiles;
+        PendingTexture & texture = pending[i];
+        vk::Format format = vk::Format::eR8G8B8A8Srgb;
+        vk::Extent3D extent = {0, 0, 1};
+        uint32_t layersPerFile = 1;
+        if (openCompressedTextures(files, texture.compressed)) {
+            format = static_cast<vk::Format>(texture.compressed[0].getFormat());
+            extent.width = texture.compressed[0].getWidth();
+            extent.height = texture.compressed[0].getHeight();
+            layersPerFile = texture.compressed[0].getLayerCount();
+            compressedCount++;
+        }
+        else {
+            texture.compressed.clear();
+            for (const auto & file : files) {
+                int width, height, channels;
+                if (!stbi_info(file.c_str(), &width, &height, &channels)) {
+                    throw std::runtime_error("Failed to load texture from file " + file);
+                }
+                if (extent.width == 0) {
+                    extent.width = static_cast<uint32_t>(width);
+                    extent.height = static_cast<uint32_t>(height);
+                }
+                else if (static_cast<uint32_t>(width) != extent.width || static_cast<uint32_t>(height) != extent.height) {
+                    throw std::runtime_error("Texture layer " + file + " isn't the same size as the first layer.");
+                }
+            }
+        }
+
+        texture.info = vkinit::imageCreateInfo(format, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, extent);
+        texture.info.arrayLayers = static_cast<uint32_t>(files.size()) * layersPerFile;
+        texture.info.mipLevels = getTextureMipLevels(extent.width, extent.height);
+        if (!texture.compressed.empty()) {
+            //The mips are prebuilt, since compressed formats can't be blitted
+            texture.info.mipLevels = std::min(texture.info.mipLevels, texture.compressed[0].getLevelCount());
+        }
+        else if (texture.info.mipLevels > 1 && canBlitMips(format)) {
+            texture.blitMips = true;
+            texture.info.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+        }
+        //Levels start at 16 byte offsets, a whole number of blocks for compressed formats
+        uint32_t uploadedLevels = texture.blitMips ? 1 : texture.info.mipLevels;
+        for (uint32_t level = 0; level < uploadedLevels; level++) {
+            texture.copyRegions.push_back(getLevelCopyRegion(texture.info, level, stagingSize));
+            size_t levelSize = texture.compressed.empty()
+                    ? getMipLevelSize(extent.width, extent.height, texture.info.arrayLayers, level)
+                    : getBlockCompressedLevelSize(static_cast<VkFormat>(format), extent.width, extent.height, texture.info.arrayLayers, level);
+            stagingSize = (stagingSize + levelSize + 15) & ~vk::DeviceSize(15);
+        }
+        for (uint32_t file = 0; file < files.size(); file++) {
+            jobs.push_back({i, file});
+        }
+    }
+
+    unsigned char * stagingData = getUploadStaging(stagingSize);
+    //Jobs can't throw, so failures are collected and thrown afterwards
+    std::vector<std::string> errors(jobs.size());
+    m_jobSystem.parallelFor(jobs.size(), [&](size_t j) {
+        PROFILE_ZONE("decodeTexture");
+        const PendingTexture & texture = pending[jobs[j].texture];
+        uint32_t file = jobs[j].file;
+        if (!texture.compressed.empty()) {
+            //A file's levels hold its layers, which come after the previous files' in each level of the image
+            const KtxTexture & ktx = texture.compressed[file];
+            for (uint32_t level = 0; level < texture.copyRegions.size(); level++) {
+                memcpy(stagingData + texture.copyRegions[level].bufferOffset + file * ktx.getLevelSize(level), ktx.getLevelData(level), ktx.getLevelSize(level));
+            }
+            return;
+        }
+
+        const std::string & filename = requests[jobs[j].texture].layerFiles[file];
+        uint32_t width = texture.info.extent.width;
+        uint32_t height = texture.info.extent.height;
+        unsigned char * pixels = stagingData + texture.copyRegions[0].bufferOffset + file * getMipLevelSize(width, height, 1, 0);
+        if (!decodeImageInto(filename, width, height, pixels)) {
+            errors[j] = "Failed to load texture from file " + filename;
+            return;
+        }
+        //Formats the GPU can't blit get their mips built here, on the worker, from the decoded image in staging memory
+        if (texture.copyRegions.size() > 1) {
+            std::vector<unsigned char> mips = buildMipChain(pixels, width, height, 1, texture.info.mipLevels, texture.info.format == vk::Format::eR8G8B8A8Srgb);
+            size_t mipOffset = 0;
+            for (uint32_t level = 1; level < texture.copyRegions.size(); level++) {
+                size_t mipSize = getMipLevelSize(width, height, 1, level);
+                memcpy(stagingData + texture.copyRegions[level].bufferOffset + file * mipSize, mips.data() + mipOffset, mipSize);
+                mipOffset += mipSize;
+            }
+        }
     });
-    return tex;
+    for (const auto & error : errors) {
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+
+    vma::AllocationCreateInfo imgAllocInfo = {};
+    imgAllocInfo.usage = vma::MemoryUsage::eGpuOnly;
+    for (auto & texture : pending) {
+        texture.image = createImage(texture.info, imgAllocInfo, MemoryCategory::Textures);
+    }
+    //Every copy, blit and layout transition of the batch goes into one submission
+    submitImmediateCommand([&](vk::CommandBuffer cmd) {
+        for (const auto & texture : pending) {
+            recordImageUpload(cmd, m_uploadContext.stagingBuffer.buffer, texture.image.image, texture.info, texture.copyRegions, texture.blitMips);
+        }
+    });
+
+    std::vector<Texture> textures;
+    for (size_t i = 0; i < pending.size(); i++) {
+        Texture texture;
+        texture.image = pending[i].image;
+        vk::ImageViewCreateInfo viewInfo = vkinit::imageViewCreateInfo(pending[i].info.format, texture.image.image, vk::ImageAspectFlagBits::eColor);
+        viewInfo.viewType = requests[i].viewType;
+        viewInfo.subresourceRange.layerCount = pending[i].info.arrayLayers;
+        viewInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        texture.imageView = m_vkDevice.createImageView(viewInfo);
+        m_mainDeletionQueue.pushFunction([=]() {
+            m_vkDevice.destroyImageView(texture.imageView);
+            destroyImage(texture.image);
+        });
+        textures.push_back(texture);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Loaded " << textures.size() << " textures (" << compressedCount << " compressed, " << stagingSize / (1024 * 1024)
+              << " MiB staged) in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms on "
+              << m_jobSystem.getThreadCount() << " threads" << std::endl;
+    return textures;
 }
 
 void VulkanEngine::loadTextures() {
-    m_textures.push_back(loadTexture("data/assets/brick.png"));
-    m_textures.push_back(loadTexture("data/assets/concrete.png"));
-    m_textures.push_back(loadTexture("data/assets/fabric.png"));
-    m_textures.push_back(loadTexture("data/assets/rust.png"));
-    m_textures.push_back(loadTexture("data/assets/wood.png"));
+    const std::vector<std::string> materialTextures = {"data/assets/brick.png", "data/assets/concrete.png", "data/assets/fabric.png",
+                                                       "data/assets/rust.png", "data/assets/wood.png"};
+    std::vector<TextureLoadRequest> requests;
+    if (!m_benchmarkSettings.textureStreaming) {
+        for (const auto & file : materialTextures) {
+            requests.push_back({{file}, vk::ImageViewType::e2D});
+        }
+    }
+    //The terrain layers are one array texture, so they have to be the same size. They cover the ground everywhere
+    //around the camera, so they're always loaded whole rather than streamed.
+    TextureLoadRequest terrainLayers = {{}, vk::ImageViewType::e2DArray};
+    for (const auto & layer : TERRAIN_LAYERS) {
+        terrainLayers.layerFiles.emplace_back(layer.texture);
+    }
+    requests.push_back(terrainLayers);
+    std::vector<Texture> loaded = loadTextureBatch(requests);
+    m_terrainLayers = loaded.back();
+    loaded.pop_back();
+    if (m_benchmarkSettings.textureStreaming) {
+        loadStreamedTextures(materialTextures);
+    }
+    else {
+        m_textures = loaded;
+    }
 
-    vk::SamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(vk::Filter::eLinear);
+    vk::SamplerCreateInfo samplerInfo = textureSamplerCreateInfo();
     m_linearSampler = m_vkDevice.createSampler(samplerInfo);
     m_sceneDeletionQueue.pushFunction([=]() {
         m_vkDevice.destroySampler(m_linearSampler);
     });
 
-    auto material = getMaterial("texturedmesh");
-    vk::DescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.setSetLayouts(m_textureDescriptorSetLayout);
-    m_textureDescriptorSet = m_vkDevice.allocateDescriptorSets(allocInfo)[0];
-    material->textureSet = m_textureDescriptorSet;
-
-    vk::DescriptorImageInfo imgInfos[TEXTURE_ARRAY_SIZE];
-    for (size_t i = 0; i < TEXTURE_ARRAY_SIZE; i++) {
-        auto& info = imgInfos[i];
-        info.sampler = m_linearSampler;
-        info.imageView = m_textures[i].imageView;
-        info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    for (auto & frame : m_frames) {
+        vk::DescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.setSetLayouts(m_textureDescriptorSetLayout);
+        frame.textureDescriptor = m_vkDevice.allocateDescriptorSets(allocInfo)[0];
+        updateTextureDescriptors(frame);
     }
-    vk::WriteDescriptorSet tex1 = vkinit::writeDescriptorSet(vk::DescriptorType::eCombinedImageSampler,
-                                                             m_textureDescriptorSet, imgInfos, 0, TEXTURE_ARRAY_SIZE);
-    m_vkDevice.updateDescriptorSets(tex1, nullptr);
 
     //Terrain textures use a different set
-    m_terrainTextures.push_back(loadTexture("data/assets/grass.png"));
-    m_terrainTextures.push_back(loadTexture("data/assets/rock.png"));
-    m_terrainTextures.push_back(loadTexture("data/assets/snow.png"));
+    createTerrainBlendLookup();
+    //Texture batches can grow the staging arena well past what streaming terrain chunks need
+    trimUploadStaging();
 
-    auto terrainMaterial = getMaterial("terrain");
     vk::DescriptorSetAllocateInfo terrainAllocInfo = {};
     terrainAllocInfo.descriptorPool = m_descriptorPool;
     terrainAllocInfo.setSetLayouts(m_terrainTextureDescriptorSetLayout);
     m_terrainTextureDescriptorSet = m_vkDevice.allocateDescriptorSets(terrainAllocInfo)[0];
-    terrainMaterial->textureSet = m_terrainTextureDescriptorSet;
 
-    vk::DescriptorImageInfo terrainImgInfos[TERRAIN_TEXTURE_ARRAY_SIZE];
-    for (size_t i = 0; i < TERRAIN_TEXTURE_ARRAY_SIZE; i++) {
-        auto& info = terrainImgInfos[i];
-        info.sampler = m_linearSampler;
-        info.imageView = m_terrainTextures[i].imageView;
-        info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    }
-    vk::WriteDescriptorSet terrainTex1 = vkinit::writeDescriptorSet(vk::DescriptorType::eCombinedImageSampler,
-                                                                    m_terrainTextureDescriptorSet, terrainImgInfos, 0, TERRAIN_TEXTURE_ARRAY_SIZE);
-    m_vkDevice.updateDescriptorSets(terrainTex1, nullptr);
+    vk::DescriptorImageInfo terrainImgInfos[2];
+    terrainImgInfos[0].sampler = m_linearSampler;
+    terrainImgInfos[0].imageView = m_terrainLayers.imageView;
+    terrainImgInfos[0].imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    terrainImgInfos[1].sampler = m_terrainBlendSampler;
+    terrainImgInfos[1].imageView = m_terrainBlend.imageView;
+    terrainImgInfos[1].imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    vk::WriteDescriptorSet terrainWrites[] = {
+            vkinit::writeDescriptorSet(vk::DescriptorType::eCombinedImageSampler, m_terrainTextureDescriptorSet, &terrainImgInfos[0], 0, 1),
+            vkinit::writeDescriptorSet(vk::DescriptorType::eCombinedImageSampler, m_terrainTextureDescriptorSet, &terrainImgInfos[1], 1, 1),
+    };
+    m_vkDevice.updateDescriptorSets(terrainWrites, nullptr);
 
     std::cout << "Loaded textures." << std::endl;
 }
 
+void VulkanEngine::createTerrainBlendLookup() {
+    PROFILE_FUNCTION();
+    //The blend lookup maps height to a layer coordinate: the integer part is the lower of the two layers to blend
+    //and the fraction how far it has blended into the next one. It's continuous, so linear filtering keeps it exact
+    //inside the bands and smooth across texels. Heights outside its range clamp to the first and last layer.
+    float minHeight, maxHeight;
+    getTerrainBlendRange(minHeight, maxHeight);
+    std::vector<uint16_t> blend(TERRAIN_BLEND_LUT_SIZE);
+    for (uint32_t i = 0; i < TERRAIN_BLEND_LUT_SIZE; i++) {
+        float worldHeight = minHeight + (maxHeight - minHeight) * (static_cast<float>(i) + 0.5f) / TERRAIN_BLEND_LUT_SIZE;
+        float layerCoordinate = 0.0f;
+        for (size_t layer = 0; layer + 1 < std::size(TERRAIN_LAYERS); layer++) {
+            float blendStart = TERRAIN_LAYERS[layer].end;
+            float blendEnd = TERRAIN_LAYERS[layer + 1].start;
+            if (worldHeight >= blendStart) {
+                layerCoordinate = static_cast<float>(layer) + std::clamp((worldHeight - blendStart) / (blendEnd - blendStart), 0.0f, 1.0f);
+            }
+        }
+        blend[i] = glm::packHalf1x16(layerCoordinate);
+    }
+    vk::ImageCreateInfo blendInfo = vkinit::imageCreateInfo(vk::Format::eR16Sfloat, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+                                                            {TERRAIN_BLEND_LUT_SIZE, 1, 1});
+    blendInfo.imageType = vk::ImageType::e1D;
+    m_terrainBlend.image = uploadImage(blendInfo, blend.data(), blend.size() * sizeof(uint16_t));
+    vk::ImageViewCreateInfo blendViewInfo = vkinit::imageViewCreateInfo(vk::Format::eR16Sfloat, m_terrainBlend.image.image, vk::ImageAspectFlagBits::eColor);
+    blendViewInfo.viewType = vk::ImageViewType::e1D;
+    m_terrainBlend.imageView = m_vkDevice.createImageView(blendViewInfo);
+
+    vk::SamplerCreateInfo samplerInfo = vkinit::samplerCreateInfo(vk::Filter::eLinear, vk::SamplerAddressMode::eClampToEdge);
+    m_terrainBlendSampler = m_vkDevice.createSampler(samplerInfo);
+    m_mainDeletionQueue.pushFunction([=]() {
+        m_vkDevice.destroySampler(m_terrainBlendSampler);
+        m_vkDevice.destroyImageView(m_terrainBlend.imageView);
+    });
+}
+
+void VulkanEngine::loadStreamedTextures(const std::vector<std::string> &files) {
+    PROFILE_FUNCTION();
+    auto start = std::chrono::high_resolution_clock::now();
+    m_textureStreamer.setBudget(static_cast<size_t>(m_benchmarkSettings.textureBudgetMiB) * 1024 * 1024);
+    m_streamedTextures = std::vector<StreamedTextureSource>(files.size());
+    size_t compressedCount = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        StreamedTextureSource & source = m_streamedTextures[i];
+        source.file = files[i];
+        vk::Format format = vk::Format::eR8G8B8A8Srgb;
+        vk::Extent3D extent = {0, 0, 1};
+        std::vector<KtxTexture> compressed;
+        if (openCompressedTextures({files[i]}, compressed) && compressed[0].getLayerCount() == 1) {
+            source.compressed = std::move(compressed[0]);
+            format = static_cast<vk::Format>(source.compressed.getFormat());
+            extent.width = source.compressed.getWidth();
+            extent.height = source.compressed.getHeight();
+            compressedCount++;
+        }
+        else {
+            int width, height, channels;
+            if (!stbi_info(files[i].c_str(), &width, &height, &channels)) {
+                throw std::runtime_error("Failed to load texture from file " + files[i]);
+            }
+            extent.width = static_cast<uint32_t>(width);
+            extent.height = static_cast<uint32_t>(height);
+        }
+        //Replacing the image copies the levels it keeps out of the old one, so it's a transfer source too
+        source.info = vkinit::imageCreateInfo(format, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst |
+                                                      vk::ImageUsageFlagBits::eTransferSrc, extent);
+        source.info.mipLevels = getTextureMipLevels(extent.width, extent.height);
+        if (source.compressed.getLevelCount() > 0) {
+            source.info.mipLevels = std::min(source.info.mipLevels, source.compressed.getLevelCount());
+        }
+        std::vector<size_t> levelSizes;
+        for (uint32_t level = 0; level < source.info.mipLevels; level++) {
+            levelSizes.push_back(source.compressed.getLevelCount() > 0
+                    ? getBlockCompressedLevelSize(static_cast<VkFormat>(format), extent.width, extent.height, 1, level)
+                    : getMipLevelSize(extent.width, extent.height, 1, level));
+        }
+        m_textureStreamer.addTexture(extent.width, extent.height, levelSizes);
+    }
+
+    //Only the tails are loaded now, read in parallel like a texture batch
+    std::vector<std::vector<unsigned char>> tails(files.size());
+    m_jobSystem.parallelFor(files.size(), [&](size_t i) {
+        tails[i] = readTextureLevels(m_streamedTextures[i], m_textureStreamer.getTailLevel(i), m_streamedTextures[i].info.mipLevels);
+    });
+    m_textures = std::vector<Texture>(files.size());
+    for (uint32_t i = 0; i < files.size(); i++) {
+        if (tails[i].empty()) {
+            throw std::runtime_error("Failed to load texture from file " + files[i]);
+        }
+        setStreamedTextureLevel(i, m_textureStreamer.getTailLevel(i), tails[i], m_mainDeletionQueue);
+    }
+    m_mainDeletionQueue.pushFunction([=]() {
+        //These are replaced as levels stream in and out, so not the ones from when this was queued
+        for (const auto & texture : m_textures) {
+            m_vkDevice.destroyImageView(texture.imageView);
+            destroyImage(texture.image);
+        }
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Loaded the tails of " << files.size() << " streamed textures (" << compressedCount << " compressed, "
+              << m_textureStreamer.getResidentSize() / 1024 << " KiB) in " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms. Texture budget: ";
+    if (m_textureStreamer.getBudget() > 0) {
+        std::cout << m_benchmarkSettings.textureBudgetMiB << " MiB" << std::endl;
+    }
+    else {
+        std::cout << "unlimited" << std::endl;
+    }
+}
+
+std::vector<unsigned char> VulkanEngine::readTextureLevels(const StreamedTextureSource &source, uint32_t first, uint32_t end) const {
+    PROFILE_FUNCTION();
+    std::vector<unsigned char> levels;
+    if (source.compressed.getLevelCount() > 0) {
+        for (uint32_t level = first; level < end; level++) {
+            const uint8_t * data = source.compressed.getLevelData(level);
+            levels.insert(levels.end(), data, data + source.compressed.getLevelSize(level));
+        }
+        return levels;
+    }
+
+    //Sources have no mips, so even a small level needs the whole image decoded and filtered down
+    uint32_t width = source.info.extent.width;
+    uint32_t height = source.info.extent.height;
+    std::vector<unsigned char> pixels(getMipLevelSize(width, height, 1, 0));
+    if (!decodeImageInto(source.file, width, height, pixels.data())) {
+        std::cout << "Failed to load texture from file " << source.file << std::endl;
+        return {};
+    }
+    std::vector<unsigned char> mips;
+    if (end > 1) {
+        mips = buildMipChain(pixels.data(), width, height, 1, end, source.info.format == vk::Format::eR8G8B8A8Srgb);
+    }
+    size_t mipOffset = 0;
+    for (uint32_t level = 0; level < end; level++) {
+        size_t size = getMipLevelSize(width, height, 1, level);
+        if (level >= first) {
+            const unsigned char * data = level == 0 ? pixels.data() : mips.data() + mipOffset;
+            levels.insert(levels.end(), data, data + size);
+        }
+        if (level > 0) {
+            mipOffset += size;
+        }
+    }
+    return levels;
+}
+
+//The image of a streamed texture holding its levels from level on
+static vk::ImageCreateInfo getStreamedImageInfo(const vk::ImageCreateInfo & info, uint32_t level) {
+    vk::ImageCreateInfo levelInfo = info;
+    levelInfo.extent.width = std::max(info.extent.width >> level, 1u);
+    levelInfo.extent.height = std::max(info.extent.height >> level, 1u);
+    levelInfo.mipLevels = info.mipLevels - level;
+    return levelInfo;
+}
+
+void VulkanEngine::setStreamedTextureLevel(uint32_t texture, uint32_t level, const std::vector<unsigned char> &levelData, DeletionQueue &deletionQueue) {
+    PROFILE_FUNCTION();
+    if (!levelData.empty()) {
+        unsigned char * stagingData = getUploadStaging(levelData.size());
+        memcpy(stagingData, levelData.data(), levelData.size());
+    }
+    AllocatedImage image = createStreamedTextureImage(texture, level);
+    submitImmediateCommand([&](vk::CommandBuffer cmd) {
+        recordStreamedTextureUpload(cmd, m_textureUpload.graphicsFamily, m_uploadContext.stagingBuffer.buffer, texture, level, image.image);
+        recordStreamedTextureSwap(cmd, texture, level, image.image, false);
+    });
+    installStreamedTexture(texture, level, image, deletionQueue);
+}
+
+AllocatedImage VulkanEngine::createStreamedTextureImage(uint32_t texture, uint32_t level) {
+    vma::AllocationCreateInfo imgAllocInfo = {};
+    imgAllocInfo.usage = vma::MemoryUsage::eGpuOnly;
+    return createImage(getStreamedImageInfo(m_streamedTextures[texture].info, level), imgAllocInfo, MemoryCategory::Textures);
+}
+
+void VulkanEngine::recordStreamedTextureUpload(vk::CommandBuffer cmd, uint32_t queueFamily, vk::Buffer staging, uint32_t texture, uint32_t level, vk::Image image) {
+    const StreamedTextureSource & source = m_streamedTextures[texture];
+    uint32_t oldLevel = m_textures[texture].image.image ? m_textureStreamer.getResidentLevel(texture) : source.info.mipLevels;
+    if (level >= oldLevel) {
+        return;
+    }
+    vk::ImageCreateInfo info = getStreamedImageInfo(source.info, level);
+    std::vector<vk::BufferImageCopy> uploads;
+    vk::DeviceSize offset = 0;
+    for (uint32_t l = level; l < oldLevel; l++) {
+        uploads.push_back(getLevelCopyRegion(info, l - level, offset));
+        offset += m_textureStreamer.getLevelSize(texture, l);
+    }
+
+    vk::ImageMemoryBarrier toTransfer = {};
+    toTransfer.oldLayout = vk::ImageLayout::eUndefined;
+    toTransfer.newLayout = vk::ImageLayout::eTransferDstOptimal;
+    toTransfer.image = image;
+    toTransfer.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, oldLevel - level, 0, 1);
+    toTransfer.srcAccessMask = vk::AccessFlagBits::eNone;
+    toTransfer.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, toTransfer);
+
+    cmd.copyBufferToImage(staging, image, vk::ImageLayout::eTransferDstOptimal, uploads);
+
+    //On the transfer queue this is the release half of the ownership transfer, and recordStreamedTextureSwap() records
+    //the acquire half with the same layouts. The layout changes once, between the two.
+    vk::ImageMemoryBarrier toReadable = toTransfer;
+    toReadable.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    toReadable.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    toReadable.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    if (queueFamily != m_textureUpload.graphicsFamily) {
+        toReadable.srcQueueFamilyIndex = queueFamily;
+        toReadable.dstQueueFamilyIndex = m_textureUpload.graphicsFamily;
+        toReadable.dstAccessMask = vk::AccessFlagBits::eNone;
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, nullptr, nullptr, toReadable);
+    }
+    else {
+        toReadable.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, toReadable);
+    }
+}
+
+void VulkanEngine::recordStreamedTextureSwap(vk::CommandBuffer cmd, uint32_t texture, uint32_t level, vk::Image image, bool acquire) {
+    const StreamedTextureSource & source = m_streamedTextures[texture];
+    const Texture & old = m_textures[texture];
+    uint32_t oldLevel = old.image.image ? m_textureStreamer.getResidentLevel(texture) : source.info.mipLevels;
+    //Levels from here on are already in the old image
+    uint32_t keptLevel = std::max(level, oldLevel);
+
+    if (acquire && level < keptLevel && m_textureUpload.queueFamily != m_textureUpload.graphicsFamily) {
+        vk::ImageMemoryBarrier acquireBarrier = {};
+        acquireBarrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        acquireBarrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        acquireBarrier.srcQueueFamilyIndex = m_textureUpload.queueFamily;
+        acquireBarrier.dstQueueFamilyIndex = m_textureUpload.graphicsFamily;
+        acquireBarrier.image = image;
+        acquireBarrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, keptLevel - level, 0, 1);
+        acquireBarrier.srcAccessMask = vk::AccessFlagBits::eNone;
+        acquireBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        //Chained to the semaphore wait, which is at the transfer stage
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, acquireBarrier);
+    }
+    if (keptLevel == source.info.mipLevels) {
+        return;
+    }
+
+    std::vector<vk::ImageCopy> copies;
+    for (uint32_t l = keptLevel; l < source.info.mipLevels; l++) {
+        vk::ImageCopy copy = {};
+        copy.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, l - oldLevel, 0, 1);
+        copy.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, l - level, 0, 1);
+        copy.extent = vk::Extent3D(std::max(source.info.extent.width >> l, 1u), std::max(source.info.extent.height >> l, 1u), 1);
+        copies.push_back(copy);
+    }
+
+    vk::ImageMemoryBarrier toTransfer = {};
+    toTransfer.oldLayout = vk::ImageLayout::eUndefined;
+    toTransfer.newLayout = vk::ImageLayout::eTransferDstOptimal;
+    toTransfer.image = image;
+    toTransfer.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, keptLevel - level,
+                                                            source.info.mipLevels - keptLevel, 0, 1);
+    toTransfer.srcAccessMask = vk::AccessFlagBits::eNone;
+    toTransfer.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+    //The previous frame may still be sampling the old image. It isn't used again after this, so it's left in the
+    //transfer layout.
+    vk::ImageMemoryBarrier toSource = {};
+    toSource.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    toSource.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+    toSource.image = old.image.image;
+    toSource.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, keptLevel - oldLevel,
+                                                          source.info.mipLevels - keptLevel, 0, 1);
+    toSource.srcAccessMask = vk::AccessFlagBits::eNone;
+    toSource.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    std::vector<vk::ImageMemoryBarrier> barriers = {toTransfer, toSource};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, barriers);
+
+    cmd.copyImage(old.image.image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, copies);
+
+    vk::ImageMemoryBarrier toReadable = toTransfer;
+    toReadable.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    toReadable.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    toReadable.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    toReadable.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, toReadable);
+}
+
+void VulkanEngine::installStreamedTexture(uint32_t texture, uint32_t level, AllocatedImage image, DeletionQueue &deletionQueue) {
+    const StreamedTextureSource & source = m_streamedTextures[texture];
+    Texture old = m_textures[texture];
+    vk::ImageCreateInfo info = getStreamedImageInfo(source.info, level);
+
+    Texture replacement;
+    replacement.image = image;
+    vk::ImageViewCreateInfo viewInfo = vkinit::imageViewCreateInfo(info.format, image.image, vk::ImageAspectFlagBits::eColor);
+    viewInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    replacement.imageView = m_vkDevice.createImageView(viewInfo);
+    m_textures[texture] = replacement;
+    m_textureStreamer.setResidentLevel(texture, level);
+    m_textureDescriptorVersion++;
+
+    if (old.image.image) {
+        deletionQueue.pushFunction([=]() {
+            m_vkDevice.destroyImageView(old.imageView);
+            destroyImage(old.image);
+        });
+        std::cout << "Texture " << source.file << " is now " << info.extent.width << "x" << info.extent.height << ", streamed textures use "
+                  << m_textureStreamer.getResidentSize() / (1024 * 1024) << " MiB" << std::endl;
+    }
+}
+
+void VulkanEngine::startTextureUpload(uint32_t texture, uint32_t level, const std::vector<unsigned char> &levelData) {
+    PROFILE_FUNCTION();
+    //The previous upload is done by now, so its staging memory and command buffer can be reused
+    if (levelData.size() > m_textureUpload.stagingCapacity) {
+        if (m_textureUpload.stagingBuffer.buffer) {
+            destroyBuffer(m_textureUpload.stagingBuffer);
+        }
+        vk::DeviceSize capacity = UPLOAD_STAGING_SIZE;
+        while (capacity < levelData.size()) {
+            capacity *= 2;
+        }
+        m_textureUpload.stagingBuffer = createStagingBuffer(capacity, m_textureUpload.stagingData);
+        m_textureUpload.stagingCapacity = capacity;
+    }
+    memcpy(m_textureUpload.stagingData, levelData.data(), levelData.size());
+    m_vkDevice.resetCommandPool(m_textureUpload.commandPool);
+
+    m_textureUpload.image = createStreamedTextureImage(texture, level);
+    m_textureUpload.texture = texture;
+    m_textureUpload.level = level;
+    m_textureUpload.pending = true;
+
+    auto cmd = m_textureUpload.commandBuffer;
+    vk::CommandBufferBeginInfo cmdBeginInfo = {};
+    cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    cmd.begin(cmdBeginInfo);
+    recordStreamedTextureUpload(cmd, m_textureUpload.queueFamily, m_textureUpload.stagingBuffer.buffer, texture, level, m_textureUpload.image.image);
+    cmd.end();
+
+    vk::SubmitInfo submitInfo = {};
+    submitInfo.setCommandBuffers(cmd);
+    submitInfo.setSignalSemaphores(m_textureUpload.semaphore);
+    m_textureUpload.queue.submit(submitInfo, m_textureUpload.fence);
+}
+
+vk::Semaphore VulkanEngine::updateTextureStreaming(FrameData &frame, vk::CommandBuffer cmd) {
+    PROFILE_FUNCTION();
+    vk::Semaphore uploadSemaphore;
+    if (!m_streamedTextures.empty()) {
+        //Feedback: the level each textured object samples, from how big its bounding sphere is on screen. The texture
+        //is wrapped around the object, so the half of it facing the camera covers the sphere's diameter.
+        float pixelsPerUnit = static_cast<float>(m_swapChainExtent.height) / (2.0f * std::tan(glm::radians(m_camera.m_fov) / 2.0f));
+        for (const auto & object : m_renderables) {
+            if (!usesDescriptorSet(object.material, "texture") || object.textureId >= m_streamedTextures.size()) {
+                continue;
+            }
+            const glm::mat4 & transform = object.transformMatrix;
+            float scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))});
+            float radius = object.mesh->boundingRadius * scale;
+            float distance = glm::length(glm::vec3(transform[3]) - m_camera.m_position);
+            float level = 0.0f;
+            if (distance > radius) {
+                float texelsOnScreen = 2.0f * (2.0f * radius / distance) * pixelsPerUnit;
+                const vk::Extent3D & extent = m_streamedTextures[object.textureId].info.extent;
+                level = std::log2(static_cast<float>(std::max(extent.width, extent.height)) / std::max(texelsOnScreen, 1.0f));
+            }
+            m_textureStreamer.requestLevel(static_cast<uint32_t>(object.textureId), level, m_frameNumber);
+        }
+        m_textureStreamer.update(m_frameNumber);
+
+        //An upload is never waited for: the first frame that finds it done takes the image over and fills in the
+        //coarser levels from the old one
+        if (m_textureUpload.pending && m_vkDevice.getFenceStatus(m_textureUpload.fence) == vk::Result::eSuccess) {
+            m_vkDevice.resetFences(m_textureUpload.fence);
+            m_textureUpload.pending = false;
+            uint32_t texture = m_textureUpload.texture;
+            AllocatedImage image = m_textureUpload.image;
+            //The budget may have shrunk while it was uploading
+            if (m_textureStreamer.getWantedLevel(texture) <= m_textureUpload.level) {
+                recordStreamedTextureSwap(cmd, texture, m_textureUpload.level, image.image, true);
+                installStreamedTexture(texture, m_textureUpload.level, image, frame.frameDeletionQueue);
+            }
+            else {
+                frame.frameDeletionQueue.pushFunction([=]() {
+                    destroyImage(image);
+                });
+            }
+            //Waited on even if the image isn't used, so the semaphore can be signalled again
+            uploadSemaphore = m_textureUpload.semaphore;
+        }
+
+        bool reading = m_textureUpload.pending;
+        for (uint32_t i = 0; i < m_streamedTextures.size(); i++) {
+            StreamedTextureSource & source = m_streamedTextures[i];
+            if (source.pendingLevels.valid()) {
+                if (source.pendingLevels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    reading = true;
+                    continue;
+                }
+                //Levels that were read in are only used if the budget still has room for them
+                std::vector<unsigned char> levels = source.pendingLevels.get();
+                if (!levels.empty() && m_textureStreamer.getWantedLevel(i) <= source.pendingLevel) {
+                    startTextureUpload(i, source.pendingLevel, levels);
+                    reading = true;
+                    //Benchmarks take the upload over on the next frame every time, so runs stay comparable
+                    if (m_benchmarkSettings.enabled) {
+                        auto waitResult = m_vkDevice.waitForFences(m_textureUpload.fence, true, S_TO_NS(5));
+                        if (waitResult == vk::Result::eTimeout) {
+                            std::cout << "Waiting for a texture upload timed out!" << std::endl;
+                        }
+                    }
+                    continue;
+                }
+            }
+            //Dropping levels is only a copy on the GPU, so it's recorded into the frame right away. The texture being
+            //uploaded keeps its levels until the upload is swapped in, as the upload depends on them.
+            bool uploading = m_textureUpload.pending && m_textureUpload.texture == i;
+            if (!uploading && m_textureStreamer.getWantedLevel(i) > m_textureStreamer.getResidentLevel(i)) {
+                uint32_t level = m_textureStreamer.getWantedLevel(i);
+                AllocatedImage image = createStreamedTextureImage(i, level);
+                recordStreamedTextureSwap(cmd, i, level, image.image, false);
+                installStreamedTexture(i, level, image, frame.frameDeletionQueue);
+            }
+        }
+
+        //One texture is read in at a time, so streaming doesn't crowd out the other jobs
+        std::optional<uint32_t> next = m_textureStreamer.pickStreamIn();
+        if (!reading && next.has_value()) {
+            StreamedTextureSource & source = m_streamedTextures[next.value()];
+            uint32_t first = m_textureStreamer.getWantedLevel(next.value());
+            uint32_t end = m_textureStreamer.getResidentLevel(next.value());
+            source.pendingLevel = first;
+            source.pendingLevels = m_jobSystem.submit([this, &source, first, end]() {
+                return readTextureLevels(source, first, end);
+            });
+            //Benchmarks start the upload on the next frame every time, so runs stay comparable
+            if (m_benchmarkSettings.enabled) {
+                source.pendingLevels.wait();
+            }
+        }
+    }
+    updateTextureDescriptors(frame);
+    return uploadSemaphore;
+}
+
+void VulkanEngine::updateTextureDescriptors(FrameData &frame) {
+    //Only called once the frame's fence has been waited on, so nothing uses its set anymore
+    if (frame.textureDescriptorVersion != m_textureDescriptorVersion) {
+        vk::DescriptorImageInfo imgInfos[TEXTURE_ARRAY_SIZE];
+        for (size_t i = 0; i < TEXTURE_ARRAY_SIZE; i++) {
+            auto& info = imgInfos[i];
+            info.sampler = m_linearSampler;
+            info.imageView = m_textures[i].imageView;
+            info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        }
+        vk::WriteDescriptorSet write = vkinit::writeDescriptorSet(vk::DescriptorType::eCombinedImageSampler,
+                                                                  frame.textureDescriptor, imgInfos, 0, TEXTURE_ARRAY_SIZE);
+        m_vkDevice.updateDescriptorSets(write, nullptr);
+        frame.textureDescriptorVersion = m_textureDescriptorVersion;
+    }
+    assignTextureSets(frame);
+}
+
+void VulkanEngine::assignTextureSets(const FrameData &frame) {
+    for (MaterialHandle handle = 0; handle < m_materials.size(); handle++) {
+        Material & material = m_materials[handle];
+        material.textureSet.reset();
+        const auto & setNames = m_materialDescriptions[handle].descriptorSets;
+        for (uint32_t i = 0; i < setNames.size(); i++) {
+            if (setNames[i] == "texture") {
+                material.textureSet = frame.textureDescriptor;
+                material.textureSetIndex = i;
+            }
+            else if (setNames[i] == "terrain_texture" && m_terrainTextureDescriptorSet) {
+                material.textureSet = m_terrainTextureDescriptorSet;
+                material.textureSetIndex = i;
+            }
+        }
+    }
+}
+
+bool VulkanEngine::usesDescriptorSet(MaterialHandle handle, const std::string &setName) const {
+    const auto & setNames = m_materialDescriptions[handle].descriptorSets;
+    return std::find(setNames.begin(), setNames.end(), setName) != setNames.end();
+}
+
 void VulkanEngine::generateTerrainChunk(int x, int z) {
+    PROFILE_FUNCTION();
     Mesh mesh;
-    mesh.sampleFromNoise(x, z, m_terrainChunkSize, m_noiseSource);
-    uploadMesh(mesh, false);
+    uint32_t vertexCount = Mesh::getGridVertexCount(m_terrainChunkSize);
+    uint32_t indexCount = Mesh::getGridIndexCount(m_terrainChunkSize);
+    uploadMesh(mesh, vertexCount, indexCount, [&](Vertex * vertices, uint16_t * indices) {
+        PROFILE_ZONE("sampleFromNoise");
+        Mesh::writeNoiseSamples(x, z, m_terrainChunkSize, m_noiseSource, vertices);
+        Mesh::writeGridIndices(m_terrainChunkSize, indices, m_benchmarkSettings.optimizeMeshes);
+    }, false, MemoryCategory::Terrain);
     auto result = m_terrainMeshes.insert({std::make_pair(x, z), mesh});
     if (!result.second) {
         std::cout << "Failed to insert terrain mesh at " << x << ", " << z << std::endl;
@@ -1833,15 +3822,17 @@ void VulkanEngine::generateTerrainChunk(int x, int z) {
     Mesh * meshPtr = &(result.first->second);
     RenderObject terrain = {};
     terrain.mesh = meshPtr;
-    terrain.material = getMaterial("terrain");
+    terrain.material = m_terrainMaterial;
     terrain.transformMatrix = glm::translate(glm::vec3{x * (m_terrainChunkSize - 1), 0, z * (m_terrainChunkSize - 1)});
     terrain.textureId = 0;
     m_terrainRenderables[std::make_pair(x, z)] = terrain;
 
     //Water to go with the terrain
     Mesh waterMesh;
-    waterMesh.flatPlane(x, z, m_terrainChunkSize);
-    uploadMesh(waterMesh, false);
+    uploadMesh(waterMesh, vertexCount, indexCount, [&](Vertex * vertices, uint16_t * indices) {
+        Mesh::writeFlatPlane(m_terrainChunkSize, vertices);
+        Mesh::writeGridIndices(m_terrainChunkSize, indices, m_benchmarkSettings.optimizeMeshes);
+    }, false, MemoryCategory::Water);
     auto waterResult = m_waterMeshes.insert({std::make_pair(x, z), waterMesh});
     if (!waterResult.second) {
         std::cout << "Failed to insert water mesh at " << x << ", " << z << std::endl;
@@ -1850,14 +3841,16 @@ void VulkanEngine::generateTerrainChunk(int x, int z) {
     Mesh * waterMeshPtr = &(waterResult.first->second);
     RenderObject water = {};
     water.mesh = waterMeshPtr;
-    water.material = getMaterial("water");
+    water.material = m_waterMaterial;
     water.transformMatrix = glm::translate(glm::vec3{x * (m_terrainChunkSize - 1), 16, z * (m_terrainChunkSize - 1)});
     m_waterRenderables[std::make_pair(x, z)] = water;
+    m_frameStats.chunksGenerated++;
 
     std::cout << "Generated terrain chunk at " << x << ", " << z << std::endl;
 }
 
 void VulkanEngine::deleteTerrainChunk(int x, int z, DeletionQueue& deletionQueue) {
+    PROFILE_FUNCTION();
     auto pair = std::make_pair(x, z);
     m_terrainRenderables.erase(pair);
     m_waterRenderables.erase(pair);
@@ -1891,11 +3884,13 @@ void VulkanEngine::deleteTerrainChunk(int x, int z, DeletionQueue& deletionQueue
         }
         m_waterMeshes.erase(waterIt);
     }
+    m_frameStats.chunksDeleted++;
 
     std::cout << "Deleted terrain chunk at " << x << ", " << z << std::endl;
 }
 
 void VulkanEngine::updateTerrainChunks(DeletionQueue& deletionQueue) {
+    PROFILE_FUNCTION();
     auto camPos = m_camera.m_position;
     int camX = static_cast<int>(camPos.x / m_terrainChunkSize);
     int camZ = static_cast<int>(camPos.z / m_terrainChunkSize);
@@ -1933,53 +3928,3 @@ void VulkanEngine::deleteAllTerrainChunks() {
         deleteTerrainChunk(pair.first, pair.second, m_mainDeletionQueue);
     }
 }
-
-vk::Pipeline PipelineBuilder::buildPipeline(vk::Device device, vk::RenderPass pass) {
-    //Create viewportstate from the stored viewport and scissor.
-    //At the moment we don't support multiple viewports or scissors.
-    vk::PipelineViewportStateCreateInfo viewportInfo = {};
-    viewportInfo.viewportCount = 1;
-    viewportInfo.setViewports(m_viewport);
-    viewportInfo.scissorCount = 1;
-    viewportInfo.setScissors(m_scissor);
-
-    //Set up dummy color blending. As we aren't yet using transparent objects, we don't do blending,
-    //but we do write to the color attachment.
-    vk::PipelineColorBlendStateCreateInfo colorBlendInfo = {};
-    colorBlendInfo.logicOpEnable = VK_FALSE;
-    colorBlendInfo.logicOp = vk::LogicOp::eCopy;
-    colorBlendInfo.setAttachments(m_colorBlendAttachmentState);
-
-    //The actual pipeline
-    vk::GraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.stageCount = m_shaderStageInfos.size();
-    pipelineInfo.setStages(m_shaderStageInfos);
-    pipelineInfo.pVertexInputState = &m_vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &m_inputAssemblyInfo;
-    pipelineInfo.pViewportState = &viewportInfo;
-    pipelineInfo.pRasterizationState = &m_rasterizerInfo;
-    pipelineInfo.pMultisampleState = &m_multisampleInfo;
-    pipelineInfo.pColorBlendState = &colorBlendInfo;
-    pipelineInfo.layout = m_pipelineLayout;
-    pipelineInfo.renderPass = pass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.pDepthStencilState = &m_depthStencil;
-
-    //Dynamic scissor and viewport
-    vk::PipelineDynamicStateCreateInfo dynInfo = {};
-    vk::DynamicState dynamicStates[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
-    dynInfo.setDynamicStates(dynamicStates);
-    pipelineInfo.setPDynamicState(&dynInfo);
-
-    auto pipeline = device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineInfo);
-    switch (pipeline.result) {
-        case vk::Result::eSuccess:
-            return pipeline.value;
-        default:
-            std::cout << "Pipeline create failed." << std::endl;
-            return VK_NULL_HANDLE;
-    }
-
-    return vk::Pipeline();
-}
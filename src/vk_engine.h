@@ -3,23 +3,59 @@
 
 
 #include <optional>
+#include <future>
 #include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <glm/glm.hpp>
 #include <chrono>
 #include <functional>
+#include <filesystem>
 #include <PerlinNoise.hpp>
 #include "vk_types.h"
 #include "vk_mesh.h"
 #include "camera.h"
+#include "vk_benchmark.h"
+#include "vk_gpu_profiler.h"
+#include "vk_memory_stats.h"
+#include "vk_frame_capture.h"
+#include "vk_pipeline_cache.h"
+#include "vk_pipelines.h"
+#include "vk_materials.h"
+#include "vk_descriptors.h"
+#include "vk_reflection.h"
+#include "shader_archive.h"
+#include "job_system.h"
+#include "shader_watcher.h"
+#include "light_clusters.h"
+#include "ktx_texture.h"
+#include "texture_streaming.h"
+#include "asset_pack.h"
+#include "mesh_cache.h"
 
 constexpr int FRAMES_IN_FLIGHT = 2;
 
 constexpr size_t TEXTURE_ARRAY_SIZE = 5;
-constexpr size_t TERRAIN_TEXTURE_ARRAY_SIZE = 3;
+
+//constant_id of the specialization constants in the fragment shaders
+enum SpecializationConstant : uint32_t {
+    SPEC_TEXTURE_COUNT = 0,
+    SPEC_SPECULAR = 2,
+    SPEC_TERRAIN_HEIGHT_RANGE = 3, //two floats, 3 and 4: the heights the terrain blend lookup covers
+    SPEC_TERRAIN_BLENDING = 5,
+};
+
+//Shading options baked into the pipelines as specialization constants. Changing them builds another variant of
+//each affected pipeline, or switches back to one built earlier.
+struct ShaderFeatures {
+    bool specular = true;
+    bool terrainBlending = true; //blend between the terrain layers instead of switching halfway
+};
 
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; //a family that only does transfers, if the device has one
 
     bool isComplete() const {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -52,14 +88,20 @@ struct SwapChainSupportDetails {
 };
 
 struct Material {
-    std::optional<vk::DescriptorSet> textureSet;
+    std::string name;
+    std::optional<vk::DescriptorSet> textureSet; //the texture or terrain texture set, if the material lists one
+    uint32_t textureSetIndex = 0; //where it's listed
     vk::Pipeline pipeline;
     vk::PipelineLayout pipelineLayout;
+    uint64_t pipelineKey = 0; //the pipeline this material should use with the current shader features
+    //Stages reading the pushed MeshPushConstants and texture index, from the shaders. Nothing is pushed if they're empty.
+    vk::ShaderStageFlags meshConstantStages;
+    vk::ShaderStageFlags textureIndexStages;
 };
 
 struct RenderObject {
     Mesh * mesh;
-    Material * material;
+    MaterialHandle material;
     size_t textureId;
     glm::mat4 transformMatrix;
 };
@@ -81,10 +123,19 @@ struct FrameData {
 
     AllocatedBuffer cameraBuffer;
     AllocatedBuffer objectBuffer;
+    //Point lights and their clusters, see light_clusters.h. The light and index buffers grow as needed.
     AllocatedBuffer lightBuffer;
+    AllocatedBuffer clusterBuffer;
+    AllocatedBuffer lightIndexBuffer;
+    size_t lightCapacity = 0;
+    size_t lightIndexCapacity = 0;
 
     vk::DescriptorSet globalDescriptor;
     vk::DescriptorSet objectDescriptor;
+    //The textured material's textures. Streaming replaces images, so each frame has its own set, rewritten when it's
+    //behind m_textureDescriptorVersion.
+    vk::DescriptorSet textureDescriptor;
+    uint64_t textureDescriptorVersion = 0;
 
     DeletionQueue frameDeletionQueue;
 };
@@ -93,6 +144,33 @@ struct UploadContext {
     vk::Fence uploadFence;
     vk::CommandPool commandPool;
     vk::CommandBuffer commandBuffer;
+    //Persistently mapped staging memory that uploads write their data into, reused by every submission
+    AllocatedBuffer stagingBuffer;
+    unsigned char * stagingData = nullptr;
+    vk::DeviceSize stagingCapacity = 0;
+};
+
+//Streamed texture levels are uploaded on a dedicated transfer queue if the device has one, else on the graphics queue,
+//while frames keep rendering. One upload is in flight at a time, and the first frame that finds it done takes the image
+//over, waiting on the semaphore and acquiring the uploaded levels from the transfer queue's family.
+struct TextureUploadContext {
+    vk::Queue queue;
+    uint32_t queueFamily = 0;
+    uint32_t graphicsFamily = 0;
+    vk::CommandPool commandPool;
+    vk::CommandBuffer commandBuffer;
+    vk::Fence fence; //polled by the frames, only waited on in benchmarks
+    vk::Semaphore semaphore;
+    //Mapped staging memory the levels are copied from. Kept apart from m_uploadContext's, which is reused every frame.
+    AllocatedBuffer stagingBuffer;
+    unsigned char * stagingData = nullptr;
+    vk::DeviceSize stagingCapacity = 0;
+
+    //The upload in flight: the texture's image from level on, with the levels finer than its resident ones filled in
+    bool pending = false;
+    uint32_t texture = 0;
+    uint32_t level = 0;
+    AllocatedImage image;
 };
 
 struct MeshPushConstants {
@@ -112,16 +190,27 @@ struct GPUObjectData {
     glm::mat4 modelMatrix;
 };
 
-struct PointLightData {
-    glm::vec4 worldPosition;
-    glm::vec4 lightColor; //w is shininess
-};
-
 struct Texture {
     AllocatedImage image;
     vk::ImageView imageView;
 };
 
+//Where a streamed texture's levels are read from, see texture_streaming.h
+struct StreamedTextureSource {
+    std::string file;
+    KtxTexture compressed; //open if the levels are copied from the compressed version, else file is decoded
+    vk::ImageCreateInfo info; //the whole texture, with every level
+    //Levels being read in on the job system, packed one after another from pendingLevel down to the resident ones
+    std::future<std::vector<unsigned char>> pendingLevels;
+    uint32_t pendingLevel = 0;
+};
+
+//A texture for loadTextureBatch: one source image per array layer, all the same size
+struct TextureLoadRequest {
+    std::vector<std::string> layerFiles;
+    vk::ImageViewType viewType;
+};
+
 class VulkanEngine {
 public:
     //
@@ -140,16 +229,24 @@ public:
     //Main loop
     void run();
 
+    //Configure benchmark mode / camera path recording. Must be called before init().
+    void configureBenchmark(const BenchmarkSettings & settings);
+
+    //Number of captured frames that failed to write or didn't match their reference image
+    uint32_t getCaptureFailures();
+
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
             VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
             VkDebugUtilsMessageTypeFlagsEXT messageType,
             const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
             void* pUserData);
 
-    Material * createMaterial(vk::Pipeline pipeline, vk::PipelineLayout layout, const std::string& name);
+    //Creating a material that already exists updates its description and keeps its handle and texture set
+    MaterialHandle createMaterial(const MaterialDescription & description);
 
     //TODO: make these return a Result struct instead of nullptr on failure
     //https://github.com/bitwizeshift/result
+    MaterialHandle getMaterialHandle(const std::string& name) const;
     Material * getMaterial(const std::string& name);
     Mesh * getMesh(const std::string& name);
 
@@ -170,6 +267,7 @@ private:
 
     vma::Allocator m_allocator;
     UploadContext m_uploadContext; //context for uploading data (meshes, textures) to GPU memory
+    TextureUploadContext m_textureUpload; //context for uploading streamed texture levels without waiting on them
 
     // Vulkan members and handles
     vk::Extent2D m_windowExtent{1024, 768};
@@ -180,7 +278,8 @@ private:
     vk::SurfaceKHR m_vkSurface;
     vk::Queue m_graphicsQueue;
     vk::Queue m_presentQueue;
-    vk::RenderPass m_renderPass;
+    vk::RenderPass m_renderPass; //null when rendering dynamically
+    bool m_dynamicRenderingEnabled = false; //vkCmdBeginRendering instead of m_renderPass and framebuffers
     vk::PhysicalDeviceProperties m_gpuProperties;
     vk::SampleCountFlagBits m_msaaSamples;
 
@@ -205,32 +304,82 @@ private:
     vk::Format m_colorFormat;
 
 
-    vk::PipelineLayout m_meshPipelineLayout;
-
-    vk::Pipeline m_meshPipeline;
+    JobSystem m_jobSystem;
+
+    PipelineCache m_pipelineCache;
+    PipelineCompiler m_pipelineCompiler;
+    //Compiled shaders packed at build time; shaders it doesn't have are read from their own files
+    ShaderArchive m_shaderArchive;
+    //When the file the archive came from was written, unknown if it's embedded
+    std::optional<std::filesystem::file_time_type> m_shaderArchiveTime;
+    AssetPack m_assetPack;
+    //One module per shader file, shared by every pipeline using it and kept until shutdown
+    std::unordered_map<std::string, vk::ShaderModule> m_shaderModules;
+    std::vector<vk::ShaderModule> m_retiredShaderModules; //replaced by a reload, destroyed once no build uses them
+    bool m_pipelineBatchActive = false;
+    std::chrono::high_resolution_clock::time_point m_pipelineBatchStart;
+    bool m_pipelineBatchWarmCache = false;
+    bool m_pipelineBatchIsReload = false;
+
+    PipelineLayoutCache m_pipelineLayoutCache;
+    ShaderFeatures m_shaderFeatures;
+    struct PipelineVariant {
+        vk::Pipeline pipeline;
+        MaterialHandle builtFor; //one of the materials sharing it, for its shaders
+    };
+    //Every pipeline built so far, keyed by getPipelineKey(). Materials with the same state and specialization
+    //constants share one. Owns the pipelines the materials use.
+    std::unordered_map<uint64_t, PipelineVariant> m_pipelineVariants;
+    std::unordered_multiset<uint64_t> m_pendingPipelineKeys; //submitted and not finished yet
+    ShaderWatcher m_shaderWatcher;
+    bool m_hotReloadEnabled = false;
+    //Rebuilt pipelines are held here until the whole reload is done, then swapped in together
+    std::vector<CompiledPipeline> m_stagedPipelines;
+    //Replaced pipelines, destroyed once the frame number reaches the first value (the last frame using them is done)
+    std::vector<std::pair<uint64_t, vk::Pipeline>> m_retiredPipelines;
 
     //Vector of objects in the scene
     std::vector<RenderObject> m_renderables;
     RenderObject m_mine;
-    //Materials, indexed by material name
-    //TODO: these should not be stringly typed
-    std::unordered_map<std::string, Material> m_materials;
+    //Materials and what they were created from, both indexed by MaterialHandle
+    std::vector<Material> m_materials;
+    std::vector<MaterialDescription> m_materialDescriptions;
+    std::unordered_map<std::string, MaterialHandle> m_materialHandles;
+    MaterialHandle m_terrainMaterial = INVALID_MATERIAL;
+    MaterialHandle m_waterMaterial = INVALID_MATERIAL;
     //Meshes, indexed by mesh name
     std::unordered_map<std::string, Mesh> m_meshes;
     //Textures, indexed by texture name
     std::vector<Texture> m_textures;
-    //Terrain textures
-    std::vector<Texture> m_terrainTextures;
+    //With streaming on, the textures in m_textures are replaced as their levels come and go
+    TextureStreamer m_textureStreamer;
+    std::vector<StreamedTextureSource> m_streamedTextures;
+    uint64_t m_textureDescriptorVersion = 1;
+    MaterialHandle m_texturedMaterial = INVALID_MATERIAL;
+    //Terrain layers in one array texture, and the lookup giving the layers to blend at each height
+    Texture m_terrainLayers;
+    Texture m_terrainBlend;
+    vk::Sampler m_terrainBlendSampler;
 
     GPUSceneData m_sceneParameters;
+
+    //Point lights where they start; each frame's moved copy is binned into clusters and uploaded
+    std::vector<PointLightData> m_pointLights;
+    std::vector<PointLightData> m_frameLights;
+    LightClusterBuilder m_lightClusters;
+    const float m_lightAreaSize = 400.0f; //side of the square around the origin the lights are scattered in
     AllocatedBuffer m_sceneParameterBuffer;
 
     //Descriptor sets
     vk::DescriptorPool m_descriptorPool;
+    DescriptorSetLayoutCache m_descriptorLayoutCache;
+    //Bindings of each named set ("global", "object", ...) as reflected from the shaders using it
+    std::unordered_map<std::string, std::vector<vk::DescriptorSetLayoutBinding>> m_descriptorSetBindings;
+    //Reflected shader interfaces by SPIR-V path, updated when a shader is reloaded
+    std::unordered_map<std::string, ShaderReflection> m_shaderReflections;
     vk::DescriptorSetLayout m_globalDescriptorSetLayout;
     vk::DescriptorSetLayout m_objectDescriptorSetLayout;
     vk::DescriptorSetLayout m_textureDescriptorSetLayout;
-    vk::DescriptorSet m_textureDescriptorSet;
     vk::DescriptorSetLayout m_terrainTextureDescriptorSetLayout;
     vk::DescriptorSet m_terrainTextureDescriptorSet;
 
@@ -239,6 +388,23 @@ private:
 
     camera m_camera;
 
+    //Benchmark mode
+    BenchmarkSettings m_benchmarkSettings;
+    BenchmarkRecorder m_benchmarkRecorder;
+    CameraPath m_cameraPath;
+    FrameStats m_frameStats; //stats of the frame currently being drawn
+
+    GpuProfiler m_gpuProfiler;
+    bool m_pipelineStatisticsSupported = false;
+    bool m_samplerAnisotropyEnabled = false;
+    bool m_textureCompressionBCEnabled = false;
+
+    MemoryTelemetry m_memoryTelemetry;
+    bool m_memoryBudgetSupported = false;
+
+    FrameCapture m_frameCapture;
+    bool m_captureSupported = false; //swap chain images can be used as a transfer source
+
     //
     //Terrain rendering stuff. This is here because this code is horrible.
     //splitting it into a separate class would be a pain because mesh allocation and uploading
@@ -285,6 +451,9 @@ private:
     void initVulkan();
 
     void initScene();
+    void createPointLights();
+    //Moves the lights for this frame, bins them into clusters and copies both into the frame's buffers
+    void updatePointLights(FrameData & frame, const glm::mat4 & view, const glm::mat4 & projection, float nearPlane, float farPlane);
 
     bool checkValidationLayerSupport();
 
@@ -320,12 +489,69 @@ private:
 
     void createFramebuffers();
 
+    //Dynamic rendering counterparts of beginRenderPass/endRenderPass. They do the layout transitions the render
+    //pass would do, so the swap chain image ends up in present layout either way.
+    void beginDynamicRendering(vk::CommandBuffer cmd, uint32_t swapChainImgIndex);
+
+    void endDynamicRendering(vk::CommandBuffer cmd, uint32_t swapChainImgIndex);
+
     void createSyncStructures();
+    void createTextureUploadContext();
+
+    void createProfiler();
+
+    void collectGpuTimings(uint32_t frameSlot);
+
+    void createFrameCapture();
+
+    void finishCaptures();
 
     void createDescriptors();
+    //Makes sure the frame's light and light index buffers have room, replacing them and their descriptors if not
+    void reserveLightBuffers(FrameData & frame, size_t lightCount, size_t lightIndexCount);
+
+    void createPipelineCache();
 
     void createPipelines();
 
+    void installCompiledPipelines();
+
+    void waitForPipelines();
+
+    void startShaderHotReload();
+
+    //Switches every material to the variant for these features, building the ones that don't exist yet
+    void setShaderFeatures(const ShaderFeatures & features);
+
+    //The specialization constants a material's fragment shader is built with for the current features
+    ShaderSpecialization getSpecialization(MaterialHandle handle) const;
+
+    //Identifies the pipeline a material needs: its state, layout and specialization constants
+    uint64_t getPipelineKey(MaterialHandle handle) const;
+
+    PipelineBuilder makePipelineBuilder(MaterialHandle handle, vk::ShaderModule vertexShader, vk::ShaderModule fragmentShader) const;
+
+    vk::DescriptorSetLayout getDescriptorSetLayout(const std::string & name) const;
+
+    //Creates the named set layouts from the bindings the shaders of the materials using each set declare
+    void createDescriptorSetLayouts(const std::vector<MaterialDescription> & descriptions);
+
+    //A material's vertex and fragment shader interfaces together. Shaders not reflected yet are loaded from disk.
+    ShaderReflection getMaterialReflection(const MaterialDescription & description);
+
+    //Sets the material's pipeline layout and push constant stages from its shaders. Returns false, printing why,
+    //if the shaders use bindings its descriptor sets don't have.
+    bool createMaterialLayout(const MaterialDescription & description, Material & material);
+
+    //Submits builds of the pipelines these materials need, once per distinct pipeline
+    void rebuildPipelines(const std::vector<MaterialHandle> & handles);
+
+    //Rebuilds the pipelines of materials using shaders the watcher saw change. Doesn't wait for the builds.
+    void reloadChangedShaders();
+
+    //Destroys retired pipelines the GPU is done with, or all of them if force is set
+    void destroyRetiredPipelines(bool force);
+
     void recreatePipelines();
 
     void recreateSwapChain();
@@ -333,41 +559,99 @@ private:
     void cleanupSwapChain();
 
 
-    //This will throw if the shader modules fail to load.
-    vk::ShaderModule loadShaderModule(const char * filePath);
+    //Maps the asset pack, if there is one. Assets it doesn't have are loaded from their source files.
+    void loadAssetPack();
 
-    void loadMeshes();
-    void uploadMesh(Mesh &mesh, bool addToDeletionQueue = true);
+    //Opens the shader archive: the one embedded in the executable if it was built with one, else the one in the asset
+    //pack, else shaders.pak
+    void loadShaderArchive();
+
+    //The cached module for a shader, created on first use. Throws if the shader can't be loaded.
+    vk::ShaderModule getShaderModule(const std::string & path);
+    //The archive's copy of a shader, or an empty blob if it doesn't have one or the shader's own file was written after
+    //the archive: a hot reload session or a rebuild without repacking leaves the archive stale until it's rebuilt.
+    ShaderBlob findArchivedShader(const std::string & path);
 
-    AllocatedBuffer createBuffer(size_t size, vk::BufferUsageFlags usageFlags, vma::MemoryUsage memoryUsage);
+    void loadMeshes();
+    //Uploads the mesh at path (an OBJ file or a heightmap) from the asset pack, else from the cache next to it (see
+    //mesh_cache.h), else from the source, writing the cache for next time. Returns false, printing why, if the source
+    //can't be loaded.
+    bool loadMesh(const std::string & path, Mesh & mesh);
+    //Uploads a mesh cache from the pack or a cache file
+    void uploadMeshCache(const MeshCacheView & cache, Mesh & mesh);
+    //Uploads the mesh's vectors and clears them
+    void uploadMesh(Mesh &mesh, bool addToDeletionQueue = true, MemoryCategory category = MemoryCategory::Meshes);
+    //Uploads a mesh that write puts straight into staging memory, with room for vertexCount vertices and indexCount
+    //indices. It should only write to the memory, which may be uncached.
+    void uploadMesh(Mesh &mesh, uint32_t vertexCount, uint32_t indexCount, const std::function<void(Vertex *, uint16_t *)> &write,
+                    bool addToDeletionQueue, MemoryCategory category);
+
+    AllocatedBuffer createBuffer(size_t size, vk::BufferUsageFlags usageFlags, vma::MemoryUsage memoryUsage,
+                                 MemoryCategory category = MemoryCategory::Other);
     void destroyBuffer(AllocatedBuffer buffer);
 
+    AllocatedImage createImage(const vk::ImageCreateInfo & info, const vma::AllocationCreateInfo & allocInfo, MemoryCategory category);
+    void destroyImage(AllocatedImage image);
+
     size_t padUniformBufferSize(size_t originalSize);
 
     void submitImmediateCommand(std::function<void(vk::CommandBuffer cmd)> && function);
+    //A persistently mapped staging buffer of capacity bytes, host cached if possible
+    AllocatedBuffer createStagingBuffer(vk::DeviceSize capacity, unsigned char *& data);
+    //Mapped staging memory for the next submitImmediateCommand to copy from m_uploadContext.stagingBuffer. Grows to
+    //fit, so it's only valid until the next call, and the data only until the submission.
+    unsigned char * getUploadStaging(vk::DeviceSize size);
+    //Frees the staging memory if a big upload grew it past the default size
+    void trimUploadStaging();
 
-    Texture loadTexture(std::string file);
     void loadTextures();
-    AllocatedImage loadImageFromFile(const char * filename);
-};
-
-//sweet lord what is happening in here??
-//Thank you vkguide.dev
-class PipelineBuilder {
-public:
-    std::vector<vk::PipelineShaderStageCreateInfo> m_shaderStageInfos;
-    vk::PipelineVertexInputStateCreateInfo m_vertexInputInfo;
-    vk::PipelineInputAssemblyStateCreateInfo m_inputAssemblyInfo;
-    vk::Viewport m_viewport;
-    vk::Rect2D m_scissor;
-    vk::PipelineRasterizationStateCreateInfo m_rasterizerInfo;
-    vk::PipelineColorBlendAttachmentState m_colorBlendAttachmentState;
-    vk::PipelineMultisampleStateCreateInfo m_multisampleInfo;
-    vk::PipelineLayout m_pipelineLayout;
-    vk::PipelineDepthStencilStateCreateInfo m_depthStencil;
-
-    vk::Pipeline buildPipeline(vk::Device device, vk::RenderPass pass);
-
+    //Loads textures together: the job system decodes the files straight into their parts of one staging buffer, and
+    //all the uploads go into one submission. The textures are destroyed with the main deletion queue.
+    std::vector<Texture> loadTextureBatch(const std::vector<TextureLoadRequest> & requests);
+    //Maps the compressed textures built from source images. Returns false if they're turned off, haven't been built
+    //or the device can't sample them, so the sources should be loaded instead.
+    bool openCompressedTextures(const std::vector<std::string> & sourceFiles, std::vector<KtxTexture> & files) const;
+    //Whether mip levels of the format can be blitted down from the first one on the GPU
+    bool canBlitMips(vk::Format format) const;
+    //Creates a sampled image from the first mip level in data, array layers one after another. The other mip levels
+    //are generated from it.
+    AllocatedImage uploadImage(const vk::ImageCreateInfo & info, const void * data, vk::DeviceSize size);
+    //Mip levels loaded textures get, 1 if mipmapping is off
+    uint32_t getTextureMipLevels(uint32_t width, uint32_t height) const;
+    //Linear filtering across mip levels, with anisotropic filtering if it's on
+    vk::SamplerCreateInfo textureSamplerCreateInfo(vk::SamplerAddressMode addressMode = vk::SamplerAddressMode::eRepeat) const;
+    void createTerrainBlendLookup();
+
+    //Loads the textured material's textures with only their tails and registers them with the streamer
+    void loadStreamedTextures(const std::vector<std::string> & files);
+    //Reads levels [first, end) of a streamed texture, packed one after another. Safe to call from jobs. Returns an
+    //empty vector, printing why, if the source can't be read.
+    std::vector<unsigned char> readTextureLevels(const StreamedTextureSource & source, uint32_t first, uint32_t end) const;
+    //Replaces a streamed texture's image with one starting at level and waits for it. Levels finer than the old image's
+    //come from levelData, the others are copied from the old image on the GPU. The old image goes into deletionQueue.
+    void setStreamedTextureLevel(uint32_t texture, uint32_t level, const std::vector<unsigned char> & levelData, DeletionQueue & deletionQueue);
+    //An image for a streamed texture's levels from level on
+    AllocatedImage createStreamedTextureImage(uint32_t texture, uint32_t level);
+    //Records copying the levels of image finer than the texture's resident ones from staging and making them readable.
+    //If the command buffer is for another queue family than the graphics queue's, ownership of them is released to it.
+    void recordStreamedTextureUpload(vk::CommandBuffer cmd, uint32_t queueFamily, vk::Buffer staging, uint32_t texture, uint32_t level, vk::Image image);
+    //Records filling the rest of image from the texture's current image, and acquiring the uploaded levels if they were
+    //released by the transfer queue. The frame's fence has to be waited on, as the current image is read.
+    void recordStreamedTextureSwap(vk::CommandBuffer cmd, uint32_t texture, uint32_t level, vk::Image image, bool acquire);
+    //Makes image the texture's image. The old one goes into deletionQueue.
+    void installStreamedTexture(uint32_t texture, uint32_t level, AllocatedImage image, DeletionQueue & deletionQueue);
+    //Submits uploading levels [level, resident level) of a texture to the texture upload queue. Nothing waits for it.
+    void startTextureUpload(uint32_t texture, uint32_t level, const std::vector<unsigned char> & levelData);
+    //Reports how big the textured objects are on screen, evicts levels, starts or finishes reading levels in, and swaps
+    //in finished uploads, recording into the frame's command buffer. Returns a semaphore the frame's submission has to
+    //wait on, or a null one.
+    vk::Semaphore updateTextureStreaming(FrameData & frame, vk::CommandBuffer cmd);
+    //Points the frame's texture set at the current textures if they've changed since it was last written
+    void updateTextureDescriptors(FrameData & frame);
+    //Points each material at the texture set its description lists, by name. Done every frame, since the texture set
+    //is per frame and a reload can change which sets a material lists.
+    void assignTextureSets(const FrameData & frame);
+    bool usesDescriptorSet(MaterialHandle handle, const std::string & setName) const;
 };
 
 #endif //VKENG_VK_ENGINE_H
@@ -0,0 +1,368 @@
+#include "vk_frame_capture.h"
+#include "png_writer.h"
+#include "cpu_profiler.h"
+
+#include <stb_image.h>
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+ImageDiff compareImages(const uint8_t *a, const uint8_t *b, uint32_t width, uint32_t height, uint32_t tolerance) {
+    ImageDiff diff;
+    diff.compared = true;
+    diff.totalPixels = static_cast<uint64_t>(width) * height;
+    uint64_t deltaSum = 0;
+    for (uint64_t i = 0; i < diff.totalPixels; i++) {
+        uint32_t pixelMax = 0;
+        for (int c = 0; c < 4; c++) {
+            auto delta = static_cast<uint32_t>(std::abs(static_cast<int>(a[i * 4 + c]) - static_cast<int>(b[i * 4 + c])));
+            deltaSum += delta;
+            pixelMax = std::max(pixelMax, delta);
+        }
+        diff.maxChannelDelta = std::max(diff.maxChannelDelta, pixelMax);
+        if (pixelMax > tolerance) {
+            diff.differingPixels++;
+        }
+    }
+    if (diff.totalPixels > 0) {
+        diff.meanChannelDelta = static_cast<double>(deltaSum) / static_cast<double>(diff.totalPixels * 4);
+    }
+    return diff;
+}
+
+void FrameCapture::init(vma::Allocator allocator, MemoryTelemetry *telemetry, uint32_t frameSlots) {
+    m_allocator = allocator;
+    m_telemetry = telemetry;
+    m_slots.resize(frameSlots);
+    m_worker = std::thread(&FrameCapture::workerLoop, this);
+}
+
+void FrameCapture::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopWorker = true;
+    }
+    m_wakeWorker.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    for (auto & slot : m_slots) {
+        destroyBuffer(slot);
+    }
+    m_slots.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_droppedFrames > 0) {
+        std::cout << "Frame capture dropped " << m_droppedFrames << " frames because the encoder fell behind." << std::endl;
+    }
+}
+
+void FrameCapture::requestScreenshot(const std::string &filename) {
+    m_screenshotFile = filename;
+}
+
+void FrameCapture::setContinuous(const std::string &directory, uint32_t interval) {
+    m_directory = directory;
+    m_interval = std::max(interval, 1u);
+}
+
+void FrameCapture::setReference(const std::string &directory, uint32_t tolerance, double maxDifferingFraction) {
+    m_referenceDirectory = directory;
+    m_tolerance = tolerance;
+    m_maxDifferingFraction = maxDifferingFraction;
+}
+
+bool FrameCapture::shouldCapture(uint64_t frameNumber) const {
+    return !m_screenshotFile.empty() || (!m_directory.empty() && frameNumber % m_interval == 0);
+}
+
+std::string FrameCapture::filenameForFrame(uint64_t frameNumber) const {
+    std::ostringstream name;
+    name << "frame_" << std::setw(6) << std::setfill('0') << frameNumber << ".png";
+    return name.str();
+}
+
+void FrameCapture::ensureBuffer(Slot &slot, vk::DeviceSize size) {
+    if (slot.size >= size) {
+        return;
+    }
+    destroyBuffer(slot);
+
+    vk::BufferCreateInfo info = {};
+    info.size = size;
+    info.usage = vk::BufferUsageFlagBits::eTransferDst;
+
+    //Persistently mapped, and cached on the host if possible since we read from it
+    vma::AllocationCreateInfo allocInfo = {};
+    allocInfo.usage = vma::MemoryUsage::eGpuToCpu;
+    allocInfo.flags = vma::AllocationCreateFlagBits::eMapped;
+    allocInfo.preferredFlags = vk::MemoryPropertyFlagBits::eHostCached;
+
+    auto pair = m_allocator.createBuffer(info, allocInfo);
+    slot.buffer.buffer = pair.first;
+    slot.buffer.allocation = pair.second;
+    slot.mapped = static_cast<const uint8_t *>(m_allocator.getAllocationInfo(slot.buffer.allocation).pMappedData);
+    slot.size = size;
+    if (m_telemetry) {
+        m_telemetry->trackAllocation(slot.buffer.allocation, MemoryCategory::Readback);
+    }
+}
+
+void FrameCapture::destroyBuffer(Slot &slot) {
+    if (!slot.buffer.buffer) {
+        return;
+    }
+    if (m_telemetry) {
+        m_telemetry->untrackAllocation(slot.buffer.allocation);
+    }
+    m_allocator.destroyBuffer(slot.buffer.buffer, slot.buffer.allocation);
+    slot.buffer = {};
+    slot.mapped = nullptr;
+    slot.size = 0;
+}
+
+void FrameCapture::recordCopy(vk::CommandBuffer cmd, uint32_t frameSlot, uint64_t frameNumber, vk::Image image, vk::Extent2D extent, vk::Format format) {
+    std::string filename;
+    if (!m_screenshotFile.empty()) {
+        filename = m_screenshotFile;
+        m_screenshotFile.clear();
+    }
+    else if (!m_directory.empty()) {
+        filename = m_directory + "/" + filenameForFrame(frameNumber);
+    }
+    else {
+        return;
+    }
+
+    bool swizzle;
+    if (format == vk::Format::eB8G8R8A8Srgb || format == vk::Format::eB8G8R8A8Unorm) {
+        swizzle = true;
+    }
+    else if (format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eR8G8B8A8Unorm) {
+        swizzle = false;
+    }
+    else {
+        std::cout << "Can't capture swap chain format " << vk::to_string(format) << "." << std::endl;
+        return;
+    }
+
+    auto & slot = m_slots[frameSlot];
+    ensureBuffer(slot, static_cast<vk::DeviceSize>(extent.width) * extent.height * 4);
+    slot.width = extent.width;
+    slot.height = extent.height;
+    slot.swizzle = swizzle;
+    slot.frameNumber = frameNumber;
+    slot.filename = filename;
+    slot.pending = true;
+
+    vk::ImageSubresourceRange range = {};
+    range.aspectMask = vk::ImageAspectFlagBits::eColor;
+    range.levelCount = 1;
+    range.layerCount = 1;
+
+    vk::ImageMemoryBarrier toTransfer = {};
+    toTransfer.oldLayout = vk::ImageLayout::ePresentSrcKHR;
+    toTransfer.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+    toTransfer.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+    toTransfer.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    toTransfer.image = image;
+    toTransfer.subresourceRange = range;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, toTransfer);
+
+    vk::BufferImageCopy region = {};
+    region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = vk::Extent3D{extent.width, extent.height, 1};
+    cmd.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer.buffer, region);
+
+    //Make the copy visible to the host once the fence has signalled
+    vk::BufferMemoryBarrier toHost = {};
+    toHost.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    toHost.dstAccessMask = vk::AccessFlagBits::eHostRead;
+    toHost.buffer = slot.buffer.buffer;
+    toHost.size = VK_WHOLE_SIZE;
+
+    vk::ImageMemoryBarrier toPresent = toTransfer;
+    toPresent.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+    toPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
+    toPresent.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+    toPresent.dstAccessMask = {};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eBottomOfPipe,
+                        {}, nullptr, toHost, toPresent);
+}
+
+void FrameCapture::resolve(uint32_t frameSlot) {
+    if (frameSlot >= m_slots.size()) {
+        return;
+    }
+    auto & slot = m_slots[frameSlot];
+    if (!slot.pending) {
+        return;
+    }
+    PROFILE_FUNCTION();
+    slot.pending = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.size() >= FRAME_CAPTURE_MAX_QUEUED) {
+            m_droppedFrames++;
+            return;
+        }
+    }
+
+    m_allocator.invalidateAllocation(slot.buffer.allocation, 0, VK_WHOLE_SIZE);
+
+    //This thread only pays for the copy out of the mapped buffer, swizzling and encoding happen on the worker
+    Job job;
+    job.frameNumber = slot.frameNumber;
+    job.filename = slot.filename;
+    job.width = slot.width;
+    job.height = slot.height;
+    job.swizzle = slot.swizzle;
+    job.pixels.assign(slot.mapped, slot.mapped + static_cast<size_t>(slot.width) * slot.height * 4);
+    if (!m_referenceDirectory.empty() && !m_directory.empty()) {
+        job.referenceFile = m_referenceDirectory + "/" + filenameForFrame(job.frameNumber);
+    }
+    job.tolerance = m_tolerance;
+    job.maxDifferingFraction = m_maxDifferingFraction;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(job));
+    }
+    m_wakeWorker.notify_one();
+}
+
+void FrameCapture::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_queueDrained.wait(lock, [&]() { return m_queue.empty() && !m_workerBusy; });
+}
+
+void FrameCapture::workerLoop() {
+    PROFILE_THREAD_NAME("capture encoder");
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wakeWorker.wait(lock, [&]() { return m_stopWorker || !m_queue.empty(); });
+        if (m_queue.empty()) {
+            //Only get here when stopping, and everything queued has been written
+            return;
+        }
+        Job job = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_workerBusy = true;
+
+        lock.unlock();
+        CaptureResult result = processJob(job);
+        lock.lock();
+
+        m_results.push_back(result);
+        m_workerBusy = false;
+        if (m_queue.empty()) {
+            m_queueDrained.notify_all();
+        }
+    }
+}
+
+CaptureResult FrameCapture::processJob(Job &job) {
+    PROFILE_FUNCTION();
+    if (job.swizzle) {
+        for (size_t i = 0; i < job.pixels.size(); i += 4) {
+            std::swap(job.pixels[i], job.pixels[i + 2]);
+        }
+    }
+
+    CaptureResult result = {};
+    result.frameNumber = job.frameNumber;
+    result.filename = job.filename;
+    result.written = writePng(job.filename, job.width, job.height, job.pixels.data());
+    result.passed = true;
+
+    if (!job.referenceFile.empty()) {
+        const std::string & referenceFile = job.referenceFile;
+        int width, height, channels;
+        stbi_uc * reference = stbi_load(referenceFile.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (reference == nullptr) {
+            std::cout << "No reference image " << referenceFile << std::endl;
+            result.passed = false;
+        }
+        else if (static_cast<uint32_t>(width) != job.width || static_cast<uint32_t>(height) != job.height) {
+            std::cout << "Reference image " << referenceFile << " is " << width << "x" << height << ", capture is "
+                      << job.width << "x" << job.height << std::endl;
+            result.passed = false;
+        }
+        else {
+            result.diff = compareImages(job.pixels.data(), reference, job.width, job.height, job.tolerance);
+            double fraction = static_cast<double>(result.diff.differingPixels) / static_cast<double>(result.diff.totalPixels);
+            result.passed = fraction <= job.maxDifferingFraction;
+        }
+        if (reference != nullptr) {
+            stbi_image_free(reference);
+        }
+    }
+    return result;
+}
+
+std::vector<CaptureResult> FrameCapture::getResults() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_results;
+}
+
+uint32_t FrameCapture::getFailureCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t failures = 0;
+    for (const auto & result : m_results) {
+        if (!result.written || !result.passed) {
+            failures++;
+        }
+    }
+    return failures;
+}
+
+bool FrameCapture::writeReport(const std::string &filename) {
+    std::vector<CaptureResult> results;
+    uint64_t droppedFrames;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results = m_results;
+        droppedFrames = m_droppedFrames;
+    }
+    std::sort(results.begin(), results.end(), [](const CaptureResult & a, const CaptureResult & b) {
+        return a.frameNumber < b.frameNumber;
+    });
+
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    uint32_t failures = 0;
+    file << std::fixed << std::setprecision(6);
+    file << "{" << std::endl;
+    file << "  \"reference\": \"" << m_referenceDirectory << "\"," << std::endl;
+    file << "  \"tolerance\": " << m_tolerance << "," << std::endl;
+    file << "  \"maxDifferingFraction\": " << m_maxDifferingFraction << "," << std::endl;
+    file << "  \"droppedFrames\": " << droppedFrames << "," << std::endl;
+    file << "  \"frames\": [" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto & r = results[i];
+        failures += (!r.written || !r.passed) ? 1 : 0;
+        file << "    {\"frame\": " << r.frameNumber << ", \"file\": \"" << r.filename << "\", \"written\": " << (r.written ? "true" : "false")
+             << ", \"passed\": " << (r.passed ? "true" : "false");
+        if (r.diff.compared) {
+            file << ", \"maxChannelDelta\": " << r.diff.maxChannelDelta << ", \"meanChannelDelta\": " << r.diff.meanChannelDelta
+                 << ", \"differingPixels\": " << r.diff.differingPixels;
+        }
+        file << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    file << "  ]," << std::endl;
+    file << "  \"failures\": " << failures << std::endl;
+    file << "}" << std::endl;
+
+    std::cout << "Wrote capture report to " << filename << ": " << results.size() << " frames, " << failures << " failed" << std::endl;
+    return true;
+}
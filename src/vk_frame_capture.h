@@ -0,0 +1,127 @@
+#ifndef VKENG_VK_FRAME_CAPTURE_H
+#define VKENG_VK_FRAME_CAPTURE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "vk_types.h"
+#include "vk_memory_stats.h"
+
+constexpr size_t FRAME_CAPTURE_MAX_QUEUED = 8; //frames waiting for the encoder before new captures are dropped
+
+//Result of comparing a captured frame against a reference image
+struct ImageDiff {
+    bool compared = false; //false if the reference was missing or had a different size
+    uint32_t maxChannelDelta = 0;
+    double meanChannelDelta = 0.0;
+    uint64_t differingPixels = 0; //pixels with a channel delta above the tolerance
+    uint64_t totalPixels = 0;
+};
+
+//Compares two RGBA8 images of the same size. A pixel only counts as different if one of its channels is off by more than tolerance.
+ImageDiff compareImages(const uint8_t * a, const uint8_t * b, uint32_t width, uint32_t height, uint32_t tolerance);
+
+struct CaptureResult {
+    uint64_t frameNumber;
+    std::string filename;
+    bool written;
+    ImageDiff diff;
+    bool passed; //true when there was nothing to compare against
+};
+
+/*
+ * Asynchronous frame readback. The presented image is copied into a host-visible buffer (one per frame in flight)
+ * at the end of the frame, and the buffer is only read once the frame slot comes around again and its fence has
+ * signalled, so a capture never stalls rendering. PNG encoding, and the optional comparison against reference
+ * images, happens on a worker thread.
+ */
+class FrameCapture {
+public:
+    void init(vma::Allocator allocator, MemoryTelemetry * telemetry, uint32_t frameSlots);
+    //Waits for the encoder to finish everything that's queued
+    void cleanup();
+
+    //Capture the next frame into filename
+    void requestScreenshot(const std::string & filename);
+    //Capture every interval-th frame into directory/frame_<number>.png, an empty directory stops it
+    void setContinuous(const std::string & directory, uint32_t interval);
+    bool isContinuous() const { return !m_directory.empty(); }
+    //Compare continuous captures against the same-named files in this directory
+    void setReference(const std::string & directory, uint32_t tolerance, double maxDifferingFraction);
+
+    bool shouldCapture(uint64_t frameNumber) const;
+
+    //Records a copy of image, which must be in the present layout, and leaves it in the present layout again.
+    //The image must have been created with the transfer source usage.
+    void recordCopy(vk::CommandBuffer cmd, uint32_t frameSlot, uint64_t frameNumber, vk::Image image, vk::Extent2D extent, vk::Format format);
+
+    //Hands the capture of the retired frame in this slot to the encoder. Only call once the slot's fence has signalled.
+    void resolve(uint32_t frameSlot);
+
+    //Blocks until the encoder queue is empty
+    void flush();
+
+    std::vector<CaptureResult> getResults();
+    uint32_t getFailureCount();
+    bool writeReport(const std::string & filename);
+
+private:
+    struct Slot {
+        AllocatedBuffer buffer;
+        const uint8_t * mapped = nullptr;
+        vk::DeviceSize size = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool swizzle = false; //BGRA source
+        uint64_t frameNumber = 0;
+        std::string filename;
+        bool pending = false;
+    };
+
+    struct Job {
+        uint64_t frameNumber;
+        std::string filename;
+        uint32_t width;
+        uint32_t height;
+        bool swizzle; //pixels are BGRA
+        std::vector<uint8_t> pixels;
+        //Comparison settings when the frame was captured, so the worker never reads the ones the main thread changes
+        std::string referenceFile; //empty = don't compare
+        uint32_t tolerance;
+        double maxDifferingFraction;
+    };
+
+    vma::Allocator m_allocator;
+    MemoryTelemetry * m_telemetry = nullptr;
+    std::vector<Slot> m_slots;
+
+    //Capture settings, only used on the main thread
+    std::string m_screenshotFile;
+    std::string m_directory;
+    uint32_t m_interval = 1;
+    std::string m_referenceDirectory;
+    uint32_t m_tolerance = 0;
+    double m_maxDifferingFraction = 0.0;
+
+    //Encoder thread state, guarded by m_mutex
+    std::mutex m_mutex;
+    uint64_t m_droppedFrames = 0;
+    std::condition_variable m_wakeWorker;
+    std::condition_variable m_queueDrained;
+    std::deque<Job> m_queue;
+    bool m_workerBusy = false;
+    bool m_stopWorker = false;
+    std::vector<CaptureResult> m_results;
+    std::thread m_worker;
+
+    void ensureBuffer(Slot & slot, vk::DeviceSize size);
+    void destroyBuffer(Slot & slot);
+    std::string filenameForFrame(uint64_t frameNumber) const;
+    void workerLoop();
+    CaptureResult processJob(Job & job);
+};
+
+#endif //VKENG_VK_FRAME_CAPTURE_H
@@ -0,0 +1,276 @@
+#include "vk_gpu_profiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+//The order of these bits is also the order the results come back in
+static const vk::QueryPipelineStatisticFlags STATISTIC_FLAGS =
+        vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+        vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+        vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+static const uint32_t STATISTIC_COUNT = 5;
+
+void GpuProfiler::init(vk::Device device, vk::PhysicalDevice gpu, uint32_t queueFamilyIndex, uint32_t frameSlots, bool pipelineStatistics) {
+    m_device = device;
+
+    uint32_t validBits = gpu.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+    m_supported = validBits > 0;
+    if (!m_supported) {
+        std::cout << "GPU timestamps are not supported on the graphics queue, GPU profiling is disabled." << std::endl;
+        return;
+    }
+    m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+    m_timestampPeriod = gpu.getProperties().limits.timestampPeriod;
+    m_pipelineStatistics = pipelineStatistics;
+
+    m_slots.resize(frameSlots);
+    for (auto & slot : m_slots) {
+        vk::QueryPoolCreateInfo timestampInfo = {};
+        timestampInfo.queryType = vk::QueryType::eTimestamp;
+        timestampInfo.queryCount = GPU_PROFILER_MAX_TIMESTAMPS;
+        slot.timestampPool = m_device.createQueryPool(timestampInfo);
+
+        if (m_pipelineStatistics) {
+            vk::QueryPoolCreateInfo statisticsInfo = {};
+            statisticsInfo.queryType = vk::QueryType::ePipelineStatistics;
+            statisticsInfo.queryCount = GPU_PROFILER_MAX_STATISTICS;
+            statisticsInfo.pipelineStatistics = STATISTIC_FLAGS;
+            slot.statisticsPool = m_device.createQueryPool(statisticsInfo);
+        }
+    }
+
+    std::cout << "GPU profiler enabled" << (m_pipelineStatistics ? " with pipeline statistics." : ".") << std::endl;
+}
+
+void GpuProfiler::cleanup() {
+    for (auto & slot : m_slots) {
+        m_device.destroyQueryPool(slot.timestampPool);
+        if (slot.statisticsPool) {
+            m_device.destroyQueryPool(slot.statisticsPool);
+        }
+    }
+    m_slots.clear();
+}
+
+bool GpuProfiler::resolveFrame(uint32_t frameSlot) {
+    if (!m_supported) {
+        return false;
+    }
+    auto & slot = m_slots[frameSlot];
+    if (!slot.pending) {
+        return false;
+    }
+    slot.pending = false;
+    if (slot.timestampCount == 0) {
+        return false;
+    }
+
+    //No wait flag: if the results aren't there yet we drop the frame rather than stall
+    uint64_t timestamps[GPU_PROFILER_MAX_TIMESTAMPS];
+    auto result = m_device.getQueryPoolResults(slot.timestampPool, 0, slot.timestampCount, sizeof(uint64_t) * slot.timestampCount,
+                                               timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return false;
+    }
+
+    uint64_t statistics[GPU_PROFILER_MAX_STATISTICS * STATISTIC_COUNT];
+    bool haveStatistics = false;
+    if (slot.statisticsCount > 0) {
+        auto statsResult = m_device.getQueryPoolResults(slot.statisticsPool, 0, slot.statisticsCount,
+                                                        sizeof(uint64_t) * STATISTIC_COUNT * slot.statisticsCount, statistics,
+                                                        sizeof(uint64_t) * STATISTIC_COUNT, vk::QueryResultFlagBits::e64);
+        haveStatistics = statsResult == vk::Result::eSuccess;
+    }
+
+    //A zone opened more than once in the frame, like a material drawn in several batches, adds up to one sample
+    std::vector<double> frameMs(m_zones.size(), -1.0);
+    std::vector<GpuPipelineStatistics> frameStatistics(m_zones.size());
+    std::vector<bool> frameHasStatistics(m_zones.size(), false);
+    for (const auto & record : slot.zones) {
+        if (record.endQuery == INVALID_ZONE) {
+            continue; //zone was never closed
+        }
+        uint64_t ticks = (timestamps[record.endQuery] - timestamps[record.startQuery]) & m_timestampMask;
+        frameMs[record.zoneIndex] = std::max(frameMs[record.zoneIndex], 0.0) + static_cast<double>(ticks) * m_timestampPeriod / 1000000.0;
+
+        if (haveStatistics && record.statisticsQuery != INVALID_ZONE) {
+            const uint64_t * s = &statistics[record.statisticsQuery * STATISTIC_COUNT];
+            GpuPipelineStatistics & stats = frameStatistics[record.zoneIndex];
+            stats.inputAssemblyVertices += s[0];
+            stats.inputAssemblyPrimitives += s[1];
+            stats.vertexShaderInvocations += s[2];
+            stats.clippingPrimitives += s[3];
+            stats.fragmentShaderInvocations += s[4];
+            frameHasStatistics[record.zoneIndex] = true;
+        }
+    }
+
+    for (size_t i = 0; i < m_zones.size(); i++) {
+        if (frameMs[i] < 0.0) {
+            continue;
+        }
+        auto & zone = m_zones[i];
+        addSample(zone, frameMs[i]);
+        if (frameHasStatistics[i]) {
+            const GpuPipelineStatistics & stats = frameStatistics[i];
+            zone.hasStatistics = true;
+            zone.lastStatistics = stats;
+            zone.totalStatistics.inputAssemblyVertices += stats.inputAssemblyVertices;
+            zone.totalStatistics.inputAssemblyPrimitives += stats.inputAssemblyPrimitives;
+            zone.totalStatistics.vertexShaderInvocations += stats.vertexShaderInvocations;
+            zone.totalStatistics.clippingPrimitives += stats.clippingPrimitives;
+            zone.totalStatistics.fragmentShaderInvocations += stats.fragmentShaderInvocations;
+        }
+    }
+
+    m_lastResolvedFrame = slot.frameNumber;
+    return true;
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer cmd, uint32_t frameSlot, uint64_t frameNumber) {
+    if (!m_supported) {
+        return;
+    }
+    m_currentSlot = frameSlot;
+    auto & slot = m_slots[frameSlot];
+    slot.zones.clear();
+    slot.timestampCount = 0;
+    slot.reservedTimestamps = 0;
+    slot.statisticsCount = 0;
+    slot.frameNumber = frameNumber;
+    slot.pending = true;
+
+    cmd.resetQueryPool(slot.timestampPool, 0, GPU_PROFILER_MAX_TIMESTAMPS);
+    if (slot.statisticsPool) {
+        cmd.resetQueryPool(slot.statisticsPool, 0, GPU_PROFILER_MAX_STATISTICS);
+    }
+}
+
+uint32_t GpuProfiler::beginZone(vk::CommandBuffer cmd, const std::string &name, bool statistics) {
+    if (!m_supported) {
+        return INVALID_ZONE;
+    }
+    auto & slot = m_slots[m_currentSlot];
+    //Reserve both the start and the end query up front so nested zones can always be closed
+    if (slot.reservedTimestamps + 2 > GPU_PROFILER_MAX_TIMESTAMPS) {
+        return INVALID_ZONE;
+    }
+    slot.reservedTimestamps += 2;
+
+    ZoneRecord record = {};
+    record.zoneIndex = getZoneIndex(name);
+    record.startQuery = slot.timestampCount++;
+    record.endQuery = INVALID_ZONE;
+    record.statisticsQuery = INVALID_ZONE;
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, slot.timestampPool, record.startQuery);
+
+    if (statistics && m_pipelineStatistics && slot.statisticsCount < GPU_PROFILER_MAX_STATISTICS) {
+        record.statisticsQuery = slot.statisticsCount++;
+        cmd.beginQuery(slot.statisticsPool, record.statisticsQuery, {});
+    }
+
+    slot.zones.push_back(record);
+    return static_cast<uint32_t>(slot.zones.size() - 1);
+}
+
+void GpuProfiler::endZone(vk::CommandBuffer cmd, uint32_t zone) {
+    if (zone == INVALID_ZONE) {
+        return;
+    }
+    auto & slot = m_slots[m_currentSlot];
+    auto & record = slot.zones[zone];
+
+    if (record.statisticsQuery != INVALID_ZONE) {
+        cmd.endQuery(slot.statisticsPool, record.statisticsQuery);
+    }
+    //beginZone reserved room for the end query already
+    record.endQuery = slot.timestampCount++;
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, slot.timestampPool, record.endQuery);
+}
+
+const GpuZoneTiming *GpuProfiler::getZone(const std::string &name) const {
+    auto it = m_zoneIndices.find(name);
+    if (it == m_zoneIndices.end()) {
+        return nullptr;
+    }
+    return &m_zones[it->second];
+}
+
+uint32_t GpuProfiler::getZoneIndex(const std::string &name) {
+    auto it = m_zoneIndices.find(name);
+    if (it != m_zoneIndices.end()) {
+        return it->second;
+    }
+    GpuZoneTiming zone;
+    zone.name = name;
+    zone.window.resize(GPU_PROFILER_AVERAGE_WINDOW, 0.0);
+    m_zones.push_back(zone);
+    auto index = static_cast<uint32_t>(m_zones.size() - 1);
+    m_zoneIndices[name] = index;
+    return index;
+}
+
+void GpuProfiler::addSample(GpuZoneTiming &zone, double ms) {
+    zone.lastMs = ms;
+    zone.totalMs += ms;
+    zone.minMs = zone.sampleCount == 0 ? ms : std::min(zone.minMs, ms);
+    zone.maxMs = zone.sampleCount == 0 ? ms : std::max(zone.maxMs, ms);
+    zone.sampleCount++;
+
+    //Rolling average over the last GPU_PROFILER_AVERAGE_WINDOW samples
+    zone.windowSum += ms - zone.window[zone.windowPos];
+    zone.window[zone.windowPos] = ms;
+    zone.windowPos = (zone.windowPos + 1) % zone.window.size();
+    size_t filled = std::min<size_t>(zone.sampleCount, zone.window.size());
+    zone.rollingAverageMs = zone.windowSum / static_cast<double>(filled);
+}
+
+void GpuProfiler::printSummary() const {
+    std::cout << "GPU zones (rolling average over " << GPU_PROFILER_AVERAGE_WINDOW << " frames):" << std::endl;
+    for (const auto & zone : m_zones) {
+        std::cout << "  " << std::setw(24) << std::left << zone.name << std::right << std::fixed << std::setprecision(3)
+                  << zone.rollingAverageMs << " ms";
+        if (zone.hasStatistics) {
+            std::cout << "  vs: " << zone.lastStatistics.vertexShaderInvocations
+                      << "  fs: " << zone.lastStatistics.fragmentShaderInvocations;
+        }
+        std::cout << std::endl;
+    }
+}
+
+bool GpuProfiler::writeJson(const std::string &filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(4);
+    file << "{" << std::endl;
+    file << "  \"zones\": [" << std::endl;
+    for (size_t i = 0; i < m_zones.size(); i++) {
+        const auto & zone = m_zones[i];
+        double average = zone.sampleCount > 0 ? zone.totalMs / static_cast<double>(zone.sampleCount) : 0.0;
+        file << "    {\"name\": \"" << zone.name << "\", \"samples\": " << zone.sampleCount << ", \"averageMs\": " << average
+             << ", \"rollingAverageMs\": " << zone.rollingAverageMs << ", \"minMs\": " << zone.minMs << ", \"maxMs\": " << zone.maxMs;
+        if (zone.hasStatistics && zone.sampleCount > 0) {
+            auto perFrame = [&](uint64_t total) { return static_cast<double>(total) / static_cast<double>(zone.sampleCount); };
+            const auto & t = zone.totalStatistics;
+            file << ", \"statisticsPerFrame\": {\"inputAssemblyVertices\": " << perFrame(t.inputAssemblyVertices)
+                 << ", \"inputAssemblyPrimitives\": " << perFrame(t.inputAssemblyPrimitives)
+                 << ", \"vertexShaderInvocations\": " << perFrame(t.vertexShaderInvocations)
+                 << ", \"clippingPrimitives\": " << perFrame(t.clippingPrimitives)
+                 << ", \"fragmentShaderInvocations\": " << perFrame(t.fragmentShaderInvocations) << "}";
+        }
+        file << "}" << (i + 1 < m_zones.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl;
+    file << "}" << std::endl;
+
+    std::cout << "Wrote GPU profile to " << filename << std::endl;
+    return true;
+}
@@ -0,0 +1,110 @@
+#ifndef VKENG_VK_GPU_PROFILER_H
+#define VKENG_VK_GPU_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "vk_types.h"
+
+constexpr uint32_t GPU_PROFILER_MAX_TIMESTAMPS = 128; //per frame, two per zone
+constexpr uint32_t GPU_PROFILER_MAX_STATISTICS = 32; //per frame, one per statistics zone
+constexpr size_t GPU_PROFILER_AVERAGE_WINDOW = 120; //frames in the rolling average
+
+struct GpuPipelineStatistics {
+    uint64_t inputAssemblyVertices = 0;
+    uint64_t inputAssemblyPrimitives = 0;
+    uint64_t vertexShaderInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentShaderInvocations = 0;
+};
+
+//Accumulated timings of one named zone (e.g. "frame", "renderpass", "material:terrain"), one sample per frame. A zone
+//opened several times in a frame is summed over the frame.
+struct GpuZoneTiming {
+    std::string name;
+    double lastMs = 0.0;
+    double rollingAverageMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double totalMs = 0.0;
+    uint64_t sampleCount = 0;
+
+    bool hasStatistics = false;
+    GpuPipelineStatistics lastStatistics;
+    GpuPipelineStatistics totalStatistics;
+
+    std::vector<double> window; //last GPU_PROFILER_AVERAGE_WINDOW samples, used as a ring buffer
+    size_t windowPos = 0;
+    double windowSum = 0.0;
+};
+
+/*
+ * Query-pool based GPU profiler. Each frame in flight gets its own timestamp (and optionally pipeline statistics)
+ * query pool. Zones are written into the frame's command buffer and read back when the same frame slot comes
+ * around again, after its fence has been waited on, so reading them never stalls.
+ */
+class GpuProfiler {
+public:
+    static const uint32_t INVALID_ZONE = ~0u;
+
+    void init(vk::Device device, vk::PhysicalDevice gpu, uint32_t queueFamilyIndex, uint32_t frameSlots, bool pipelineStatistics);
+    void cleanup();
+
+    bool isSupported() const { return m_supported; }
+    bool pipelineStatisticsEnabled() const { return m_pipelineStatistics; }
+
+    //Reads back the results of the retired frame in this slot. Only call once the slot's fence has signalled.
+    //Returns true if a frame was resolved; its number is then available from getLastResolvedFrame().
+    bool resolveFrame(uint32_t frameSlot);
+
+    //Resets the slot's queries. Must be recorded outside a render pass, at the start of the frame.
+    void beginFrame(vk::CommandBuffer cmd, uint32_t frameSlot, uint64_t frameNumber);
+
+    //Opens a timestamp zone. With statistics = true it also collects pipeline statistics; such zones can't nest.
+    uint32_t beginZone(vk::CommandBuffer cmd, const std::string & name, bool statistics = false);
+    void endZone(vk::CommandBuffer cmd, uint32_t zone);
+
+    const std::vector<GpuZoneTiming> & getZones() const { return m_zones; }
+    const GpuZoneTiming * getZone(const std::string & name) const;
+    uint64_t getLastResolvedFrame() const { return m_lastResolvedFrame; }
+
+    void printSummary() const;
+    bool writeJson(const std::string & filename) const;
+
+private:
+    struct ZoneRecord {
+        uint32_t zoneIndex;
+        uint32_t startQuery;
+        uint32_t endQuery;
+        uint32_t statisticsQuery; //INVALID_ZONE if the zone has no statistics
+    };
+
+    struct FrameSlot {
+        vk::QueryPool timestampPool;
+        vk::QueryPool statisticsPool;
+        std::vector<ZoneRecord> zones;
+        uint32_t timestampCount = 0; //queries written so far
+        uint32_t reservedTimestamps = 0; //queries written or reserved for zones that are still open
+        uint32_t statisticsCount = 0;
+        uint64_t frameNumber = 0;
+        bool pending = false;
+    };
+
+    vk::Device m_device;
+    bool m_supported = false;
+    bool m_pipelineStatistics = false;
+    double m_timestampPeriod = 1.0; //nanoseconds per tick
+    uint64_t m_timestampMask = ~0ull;
+
+    std::vector<FrameSlot> m_slots;
+    uint32_t m_currentSlot = 0;
+    uint64_t m_lastResolvedFrame = 0;
+
+    std::vector<GpuZoneTiming> m_zones;
+    std::unordered_map<std::string, uint32_t> m_zoneIndices;
+
+    uint32_t getZoneIndex(const std::string & name);
+    static void addSample(GpuZoneTiming & zone, double ms);
+};
+
+#endif //VKENG_VK_GPU_PROFILER_H
@@ -189,6 +189,9 @@ vk::SamplerCreateInfo vkinit::samplerCreateInfo(vk::Filter filters, vk::SamplerA
     info.addressModeU = addressMode;
     info.addressModeV = addressMode;
     info.addressModeW = addressMode;
+    //Use every mip level the image has
+    info.mipmapMode = filters == vk::Filter::eLinear ? vk::SamplerMipmapMode::eLinear : vk::SamplerMipmapMode::eNearest;
+    info.maxLod = VK_LOD_CLAMP_NONE;
 
     return info;
 }
@@ -0,0 +1,168 @@
+#include "vk_materials.h"
+#include "vk_pipelines.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+static bool parseCompareOp(const std::string & token, vk::CompareOp & op) {
+    static const std::pair<const char *, vk::CompareOp> ops[] = {
+            {"never", vk::CompareOp::eNever},
+            {"less", vk::CompareOp::eLess},
+            {"equal", vk::CompareOp::eEqual},
+            {"less_or_equal", vk::CompareOp::eLessOrEqual},
+            {"greater", vk::CompareOp::eGreater},
+            {"not_equal", vk::CompareOp::eNotEqual},
+            {"greater_or_equal", vk::CompareOp::eGreaterOrEqual},
+            {"always", vk::CompareOp::eAlways},
+    };
+    for (const auto & [name, value] : ops) {
+        if (token == name) {
+            op = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+//Applies one "key values..." line to the material. Returns false if the key or a value isn't recognized.
+static bool parseProperty(const std::string & key, std::istringstream & values, MaterialDescription & material) {
+    std::string value;
+    if (key == "vertex_shader") {
+        return static_cast<bool>(values >> material.vertexShader);
+    }
+    if (key == "fragment_shader") {
+        return static_cast<bool>(values >> material.fragmentShader);
+    }
+    if (key == "vertex_layout") {
+        values >> value;
+        material.meshVertexLayout = value == "mesh";
+        return value == "mesh" || value == "none";
+    }
+    if (key == "descriptor_sets") {
+        material.descriptorSets.clear();
+        while (values >> value) {
+            if (value != "global" && value != "object" && value != "texture" && value != "terrain_texture") {
+                return false;
+            }
+            material.descriptorSets.push_back(value);
+        }
+        return true;
+    }
+    if (key == "depth") {
+        //"depth off", or any of "test", "write" and a compare op
+        material.depthTest = false;
+        material.depthWrite = false;
+        while (values >> value) {
+            if (value == "test") {
+                material.depthTest = true;
+            }
+            else if (value == "write") {
+                material.depthWrite = true;
+            }
+            else if (value != "off" && !parseCompareOp(value, material.depthCompare)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (key == "blend") {
+        values >> value;
+        if (value == "none") material.blend = BlendMode::None;
+        else if (value == "alpha") material.blend = BlendMode::Alpha;
+        else if (value == "additive") material.blend = BlendMode::Additive;
+        else return false;
+        return true;
+    }
+    if (key == "cull") {
+        values >> value;
+        if (value == "none") material.cullMode = vk::CullModeFlagBits::eNone;
+        else if (value == "back") material.cullMode = vk::CullModeFlagBits::eBack;
+        else if (value == "front") material.cullMode = vk::CullModeFlagBits::eFront;
+        else return false;
+        return true;
+    }
+    if (key == "polygon") {
+        values >> value;
+        if (value == "fill") material.polygonMode = vk::PolygonMode::eFill;
+        else if (value == "line") material.polygonMode = vk::PolygonMode::eLine;
+        else return false;
+        return true;
+    }
+    if (key == "textures") {
+        return static_cast<bool>(values >> material.textureCount);
+    }
+    if (key == "features") {
+        while (values >> value) {
+            if (value == "lighting") {
+                material.lighting = true;
+            }
+            else if (value == "terrain") {
+                material.terrain = true;
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool loadMaterialDescriptions(const char *filename, std::vector<MaterialDescription> &descriptions) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open material descriptions " << filename << std::endl;
+        return false;
+    }
+
+    descriptions.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream stream(line);
+        std::string key;
+        if (!(stream >> key) || key[0] == '#') {
+            continue;
+        }
+
+        if (key == "material") {
+            MaterialDescription material;
+            if (!(stream >> material.name)) {
+                std::cout << "Material without a name on line " << lineNumber << " of " << filename << std::endl;
+                return false;
+            }
+            descriptions.push_back(material);
+            continue;
+        }
+        if (descriptions.empty() || !parseProperty(key, stream, descriptions.back())) {
+            std::cout << "Malformed material property on line " << lineNumber << " of " << filename << ": " << line << std::endl;
+            return false;
+        }
+    }
+
+    for (const auto & material : descriptions) {
+        if (material.vertexShader.empty() || material.fragmentShader.empty()) {
+            std::cout << "Material " << material.name << " in " << filename << " is missing a shader." << std::endl;
+            return false;
+        }
+    }
+    std::cout << "Loaded " << descriptions.size() << " material descriptions from " << filename << std::endl;
+    return true;
+}
+
+uint64_t MaterialDescription::getStateHash() const {
+    uint64_t hash = HASH_SEED;
+    hash = hashBytes(hash, vertexShader.data(), vertexShader.size() + 1);
+    hash = hashBytes(hash, fragmentShader.data(), fragmentShader.size() + 1);
+    hash = hashBytes(hash, &meshVertexLayout, sizeof(meshVertexLayout));
+    hash = hashBytes(hash, &depthTest, sizeof(depthTest));
+    hash = hashBytes(hash, &depthWrite, sizeof(depthWrite));
+    hash = hashBytes(hash, &depthCompare, sizeof(depthCompare));
+    hash = hashBytes(hash, &blend, sizeof(blend));
+    VkCullModeFlags cull = static_cast<VkCullModeFlags>(cullMode);
+    hash = hashBytes(hash, &cull, sizeof(cull));
+    hash = hashBytes(hash, &polygonMode, sizeof(polygonMode));
+    return hash;
+}
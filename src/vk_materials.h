@@ -0,0 +1,49 @@
+#ifndef VKENG_VK_MATERIALS_H
+#define VKENG_VK_MATERIALS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include "vk_types.h"
+
+//Index into the engine's material list. Names are resolved to handles once, when the scene is set up.
+using MaterialHandle = uint32_t;
+constexpr MaterialHandle INVALID_MATERIAL = std::numeric_limits<MaterialHandle>::max();
+
+enum class BlendMode {
+    None,
+    Alpha,
+    Additive,
+};
+
+//One material from the material description file, see data/materials.txt for the format
+struct MaterialDescription {
+    std::string name;
+    std::string vertexShader;
+    std::string fragmentShader;
+    bool meshVertexLayout = true; //false = no vertex buffers, the vertex shader generates its vertices
+    //"global", "object", "texture" or "terrain_texture", in set order. Their layouts come from the shaders.
+    std::vector<std::string> descriptorSets;
+
+    bool depthTest = true;
+    bool depthWrite = true;
+    vk::CompareOp depthCompare = vk::CompareOp::eLessOrEqual;
+    BlendMode blend = BlendMode::None;
+    vk::CullModeFlags cullMode = vk::CullModeFlagBits::eNone;
+    vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+
+    //Which specialization constants the fragment shader takes
+    uint32_t textureCount = 0; //0 = no texture array
+    bool lighting = false;
+    bool terrain = false;
+
+    //Hash of the fixed-function state and shaders, i.e. everything that goes into the pipeline except the
+    //layout and specialization constants. Two materials with the same hash can share a pipeline.
+    uint64_t getStateHash() const;
+};
+
+//Parses a material description file. Prints the offending line and returns false if it's malformed.
+bool loadMaterialDescriptions(const char * filename, std::vector<MaterialDescription> & descriptions);
+
+#endif //VKENG_VK_MATERIALS_H
@@ -0,0 +1,191 @@
+#include "vk_memory_stats.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+static const size_t CATEGORY_COUNT = static_cast<size_t>(MemoryCategory::Count);
+
+const char *memoryCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::Terrain: return "terrain";
+        case MemoryCategory::Water: return "water";
+        case MemoryCategory::Meshes: return "meshes";
+        case MemoryCategory::Textures: return "textures";
+        case MemoryCategory::FrameBuffers: return "frameBuffers";
+        case MemoryCategory::Staging: return "staging";
+        case MemoryCategory::RenderTargets: return "renderTargets";
+        case MemoryCategory::Readback: return "readback";
+        case MemoryCategory::Other: return "other";
+        default: return "unknown";
+    }
+}
+
+void MemoryTelemetry::init(vma::Allocator allocator, bool budgetExtension) {
+    m_allocator = allocator;
+    m_budgetExtension = budgetExtension;
+    m_heapHighWaterMarks.assign(m_allocator.getMemoryProperties()->memoryHeapCount, 0);
+    if (!m_budgetExtension) {
+        std::cout << "VK_EXT_memory_budget is not available, memory budgets will be estimates." << std::endl;
+    }
+}
+
+void MemoryTelemetry::trackAllocation(vma::Allocation allocation, MemoryCategory category) {
+    if (!allocation) {
+        return;
+    }
+    //The allocation's size includes alignment padding, which is what we actually pay for
+    uint64_t size = m_allocator.getAllocationInfo(allocation).size;
+    m_allocator.setAllocationName(allocation, memoryCategoryName(category));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_allocations[static_cast<VmaAllocation>(allocation)] = {category, size};
+    auto & usage = m_categories[static_cast<size_t>(category)];
+    usage.bytes += size;
+    usage.peakBytes = std::max(usage.peakBytes, usage.bytes);
+    usage.allocationCount++;
+    usage.totalAllocations++;
+}
+
+void MemoryTelemetry::untrackAllocation(vma::Allocation allocation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_allocations.find(static_cast<VmaAllocation>(allocation));
+    if (it == m_allocations.end()) {
+        return;
+    }
+    auto & usage = m_categories[static_cast<size_t>(it->second.category)];
+    usage.bytes -= it->second.size;
+    usage.allocationCount--;
+    m_allocations.erase(it);
+}
+
+MemorySnapshot MemoryTelemetry::snapshot(uint64_t frameNumber) {
+    MemorySnapshot snap;
+    snap.frameNumber = frameNumber;
+
+    const vk::PhysicalDeviceMemoryProperties * memoryProperties = m_allocator.getMemoryProperties();
+    vma::TotalStatistics totals = m_allocator.calculateStatistics();
+    std::vector<vma::Budget> budgets = m_allocator.getHeapBudgets();
+
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+        const auto & heapStats = totals.memoryHeap[i];
+        MemoryHeapUsage heap;
+        heap.deviceLocal = static_cast<bool>(memoryProperties->memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        heap.size = memoryProperties->memoryHeaps[i].size;
+        heap.budget = budgets[i].budget;
+        heap.usage = budgets[i].usage;
+        heap.blockCount = heapStats.statistics.blockCount;
+        heap.allocationCount = heapStats.statistics.allocationCount;
+        heap.blockBytes = heapStats.statistics.blockBytes;
+        heap.allocationBytes = heapStats.statistics.allocationBytes;
+        heap.unusedRangeCount = heapStats.unusedRangeCount;
+        heap.largestUnusedRange = heapStats.unusedRangeCount > 0 ? heapStats.unusedRangeSizeMax : 0;
+
+        uint64_t freeBytes = heap.blockBytes - heap.allocationBytes;
+        if (freeBytes > 0) {
+            heap.fragmentation = 1.0f - static_cast<float>(heap.largestUnusedRange) / static_cast<float>(freeBytes);
+        }
+
+        m_heapHighWaterMarks[i] = std::max(m_heapHighWaterMarks[i], heap.usage);
+        heap.highWaterMark = m_heapHighWaterMarks[i];
+        snap.heaps.push_back(heap);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::copy(std::begin(m_categories), std::end(m_categories), std::begin(snap.categories));
+    return snap;
+}
+
+void MemoryTelemetry::printSummary(uint64_t frameNumber) {
+    auto snap = snapshot(frameNumber);
+    auto mib = [](uint64_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Memory heaps (frame " << frameNumber << "):" << std::endl;
+    for (size_t i = 0; i < snap.heaps.size(); i++) {
+        const auto & heap = snap.heaps[i];
+        std::cout << "  heap " << i << (heap.deviceLocal ? " (device)" : " (host)  ")
+                  << "  usage " << mib(heap.usage) << " / " << mib(heap.budget) << " MiB"
+                  << "  peak " << mib(heap.highWaterMark) << " MiB"
+                  << "  blocks " << heap.blockCount << " (" << mib(heap.blockBytes) << " MiB)"
+                  << "  allocations " << heap.allocationCount
+                  << "  fragmentation " << heap.fragmentation << std::endl;
+    }
+    std::cout << "Memory by category:" << std::endl;
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        const auto & usage = snap.categories[i];
+        std::cout << "  " << std::setw(16) << std::left << memoryCategoryName(static_cast<MemoryCategory>(i)) << std::right
+                  << mib(usage.bytes) << " MiB  peak " << mib(usage.peakBytes) << " MiB  "
+                  << usage.allocationCount << " allocations (" << usage.totalAllocations << " total)" << std::endl;
+    }
+}
+
+void MemoryTelemetry::update(uint64_t frameNumber) {
+    if (m_dumpInterval == 0 || frameNumber % m_dumpInterval != 0) {
+        return;
+    }
+    m_history.push_back(snapshot(frameNumber));
+}
+
+void MemoryTelemetry::writeSnapshot(std::ostream &out, const MemorySnapshot &snapshot, const std::string &indent) {
+    out << indent << "{" << std::endl;
+    out << indent << "  \"frame\": " << snapshot.frameNumber << "," << std::endl;
+    out << indent << "  \"heaps\": [" << std::endl;
+    for (size_t i = 0; i < snapshot.heaps.size(); i++) {
+        const auto & heap = snapshot.heaps[i];
+        out << indent << "    {\"index\": " << i << ", \"deviceLocal\": " << (heap.deviceLocal ? "true" : "false")
+            << ", \"size\": " << heap.size << ", \"budget\": " << heap.budget << ", \"usage\": " << heap.usage
+            << ", \"highWaterMark\": " << heap.highWaterMark << ", \"blockCount\": " << heap.blockCount
+            << ", \"blockBytes\": " << heap.blockBytes << ", \"allocationCount\": " << heap.allocationCount
+            << ", \"allocationBytes\": " << heap.allocationBytes << ", \"unusedRangeCount\": " << heap.unusedRangeCount
+            << ", \"largestUnusedRange\": " << heap.largestUnusedRange << ", \"fragmentation\": " << heap.fragmentation << "}"
+            << (i + 1 < snapshot.heaps.size() ? "," : "") << std::endl;
+    }
+    out << indent << "  ]," << std::endl;
+    out << indent << "  \"categories\": {" << std::endl;
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        const auto & usage = snapshot.categories[i];
+        out << indent << "    \"" << memoryCategoryName(static_cast<MemoryCategory>(i)) << "\": {\"bytes\": " << usage.bytes
+            << ", \"peakBytes\": " << usage.peakBytes << ", \"allocationCount\": " << usage.allocationCount
+            << ", \"totalAllocations\": " << usage.totalAllocations << "}" << (i + 1 < CATEGORY_COUNT ? "," : "") << std::endl;
+    }
+    out << indent << "  }" << std::endl;
+    out << indent << "}";
+}
+
+bool MemoryTelemetry::writeJson(const std::string &filename, uint64_t frameNumber) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+    file << std::fixed << std::setprecision(4);
+    writeSnapshot(file, snapshot(frameNumber), "");
+    file << std::endl;
+
+    std::cout << "Wrote memory snapshot to " << filename << std::endl;
+    return true;
+}
+
+bool MemoryTelemetry::writeHistoryJson(const std::string &filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        std::cout << "Failed to open " << filename << " for writing." << std::endl;
+        return false;
+    }
+    file << std::fixed << std::setprecision(4);
+    file << "{" << std::endl;
+    file << "  \"budgetExtension\": " << (m_budgetExtension ? "true" : "false") << "," << std::endl;
+    file << "  \"interval\": " << m_dumpInterval << "," << std::endl;
+    file << "  \"snapshots\": [" << std::endl;
+    for (size_t i = 0; i < m_history.size(); i++) {
+        writeSnapshot(file, m_history[i], "    ");
+        file << (i + 1 < m_history.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl;
+    file << "}" << std::endl;
+
+    std::cout << "Wrote " << m_history.size() << " memory snapshots to " << filename << std::endl;
+    return true;
+}
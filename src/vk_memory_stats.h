@@ -0,0 +1,98 @@
+#ifndef VKENG_VK_MEMORY_STATS_H
+#define VKENG_VK_MEMORY_STATS_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "vk_types.h"
+
+//What an allocation is used for. Every allocation made through the engine is tagged with one of these.
+enum class MemoryCategory : uint32_t {
+    Terrain,
+    Water,
+    Meshes,
+    Textures,
+    FrameBuffers, //per-frame uniform and storage buffers
+    Staging,
+    RenderTargets, //depth and MSAA images
+    Readback, //frame capture buffers
+    Other,
+    Count
+};
+
+const char * memoryCategoryName(MemoryCategory category);
+
+struct MemoryCategoryUsage {
+    uint64_t bytes = 0;
+    uint64_t peakBytes = 0;
+    uint32_t allocationCount = 0;
+    uint64_t totalAllocations = 0; //allocations made over the whole run, shows churn
+};
+
+struct MemoryHeapUsage {
+    bool deviceLocal = false;
+    uint64_t size = 0;
+    uint64_t budget = 0; //how much the driver says we can use, the heap size if VK_EXT_memory_budget isn't available
+    uint64_t usage = 0; //how much the whole process uses, including memory not allocated through VMA
+    uint64_t highWaterMark = 0; //highest usage seen in any snapshot
+    uint32_t blockCount = 0;
+    uint32_t allocationCount = 0;
+    uint64_t blockBytes = 0; //device memory allocated by VMA
+    uint64_t allocationBytes = 0; //bytes of that actually handed out
+    uint32_t unusedRangeCount = 0;
+    uint64_t largestUnusedRange = 0;
+    float fragmentation = 0.0f; //0 when all free space in the blocks is one range, approaches 1 as it gets split up
+};
+
+struct MemorySnapshot {
+    uint64_t frameNumber = 0;
+    std::vector<MemoryHeapUsage> heaps;
+    MemoryCategoryUsage categories[static_cast<size_t>(MemoryCategory::Count)];
+};
+
+/*
+ * Memory telemetry built on VMA's statistics and budget queries. Allocations are tagged with a category when they
+ * are created so usage can be split up by what it is for; heap level numbers (budget, usage, fragmentation) come
+ * from VMA. Budgets are only accurate if the allocator was created with VK_EXT_memory_budget enabled.
+ */
+class MemoryTelemetry {
+public:
+    void init(vma::Allocator allocator, bool budgetExtension);
+
+    //Thread safe, so uploads running off the main thread can track their allocations too
+    void trackAllocation(vma::Allocation allocation, MemoryCategory category);
+    void untrackAllocation(vma::Allocation allocation);
+
+    //Queries VMA for heap statistics. Walks every block, so don't call this every frame.
+    MemorySnapshot snapshot(uint64_t frameNumber);
+
+    //Takes and prints a snapshot
+    void printSummary(uint64_t frameNumber);
+    bool writeJson(const std::string & filename, uint64_t frameNumber);
+
+    //Appends a snapshot to the periodic dump every interval frames; 0 turns periodic dumps off
+    void setDumpInterval(uint32_t interval) { m_dumpInterval = interval; }
+    void update(uint64_t frameNumber);
+    bool writeHistoryJson(const std::string & filename) const;
+
+private:
+    vma::Allocator m_allocator;
+    bool m_budgetExtension = false;
+    uint32_t m_dumpInterval = 0;
+
+    std::mutex m_mutex; //guards the tracking maps
+    struct TrackedAllocation {
+        MemoryCategory category;
+        uint64_t size;
+    };
+    std::unordered_map<VmaAllocation, TrackedAllocation> m_allocations;
+    MemoryCategoryUsage m_categories[static_cast<size_t>(MemoryCategory::Count)];
+
+    std::vector<uint64_t> m_heapHighWaterMarks;
+    std::vector<MemorySnapshot> m_history;
+
+    static void writeSnapshot(std::ostream & out, const MemorySnapshot & snapshot, const std::string & indent);
+};
+
+#endif //VKENG_VK_MEMORY_STATS_H
@@ -1,9 +1,12 @@
 #include "vk_mesh.h"
-#include <tiny_obj_loader.h>
+#include "obj_loader.h"
+#include "mesh_optimizer.h"
 #include <iostream>
 #include <stb_image.h>
 #include <glm/glm.hpp>
 #include <PerlinNoise.hpp>
+#include <map>
+#include <mutex>
 
 VertexInputDescription Vertex::getVertexDescription() {
     VertexInputDescription description;
@@ -50,90 +53,26 @@ VertexInputDescription Vertex::getVertexDescription() {
     return description;
 }
 
-bool Mesh::loadFromObj(const char *filename) {
-    tinyobj::ObjReaderConfig readerConfig;
-    readerConfig.mtl_search_path = "data/assets/";
-
-    tinyobj::ObjReader reader;
-
-    if (!reader.ParseFromFile(filename, readerConfig)) {
-        if (!reader.Error().empty()) {
-            std::cerr << "[ERR] TinyObjReader: " << reader.Error();
-        }
+bool Mesh::loadFromObj(const char *filename, JobSystem *jobs) {
+    ObjMesh obj;
+    if (!loadObj(filename, obj, jobs)) {
         return false;
     }
-    if (!reader.Warning().empty()) {
-        std::cout << "[WARN] TinyObjReader: " << reader.Warning();
-    }
-
-    auto & attrib = reader.GetAttrib();
-    auto & shapes = reader.GetShapes();
-    auto & materials = reader.GetMaterials();
-
-    //This is straight ripped off from the tinyobjloader examples and let me tell you it's kinda horrible
-    //Iterate over shapes
-    for (size_t s = 0; s < shapes.size(); s++) {
-        size_t index_offset = 0;
-
-        //Iterate over faces of the shape
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-            size_t fv = shapes[s].mesh.num_face_vertices[f];
-            if (fv != 3) {
-                std::cerr << "[ERR] TinyObjReader: too many vertices (" << fv << ") on face in mesh " << filename << std::endl;
-                return false;
-            }
-
-            //Iterate over vertices of the face
-            for (size_t v = 0; v < fv; v++) {
-                Vertex new_vertex;
-
-                //access to vertex
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-
-                tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-                tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-                tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-
-                new_vertex.position.x = vx;
-                new_vertex.position.y = vy;
-                new_vertex.position.z = vz;
-
-                //Check if normal_index is zero or positive. Negative = no normal data.
-                if (idx.normal_index >= 0) {
-                    tinyobj::real_t nx = attrib.normals[3 * idx.normal_index + 0];
-                    tinyobj::real_t ny = attrib.normals[3 * idx.normal_index + 1];
-                    tinyobj::real_t nz = attrib.normals[3 * idx.normal_index + 2];
-
-                    new_vertex.normal.x = nx;
-                    new_vertex.normal.y = ny;
-                    new_vertex.normal.z = nz;
-
-                    //Set the vertex color to normal coords for visualization purposes
-                    new_vertex.color = new_vertex.normal;
-                }
-
-                //Check if texcoord_index is zero or positive. Negative = no uv data.
-                if (idx.texcoord_index >= 0) {
-                    tinyobj::real_t tx = attrib.texcoords[2 * idx.texcoord_index + 0];
-                    tinyobj::real_t ty = attrib.texcoords[2 * idx.texcoord_index + 1];
-
-                    new_vertex.uv.x = tx;
-                    new_vertex.uv.y = 1 - ty;
-                }
-
-                // Optional: vertex colors
-                // tinyobj::real_t red   = attrib.colors[3 * idx.vertex_index + 0];
-                // tinyobj::real_t green = attrib.colors[3 * idx.vertex_index + 1];
-                // tinyobj::real_t blue  = attrib.colors[3 * idx.vertex_index + 2];
-
-                this->vertices.push_back(new_vertex);
-            }
-            index_offset += fv;
-            //Per-face material
-            //shapes[s].mesh.material_ids[f];
+    vertices.clear();
+    indices.clear();
+    if (obj.vertices.size() > UINT16_MAX + 1) {
+        //Index buffers are 16-bit, so meshes with more vertices are drawn without one
+        std::cout << "Mesh " << filename << " has " << obj.vertices.size() << " vertices, too many to index with 16 bits." << std::endl;
+        vertices.reserve(obj.indices.size());
+        for (uint32_t index : obj.indices) {
+            vertices.push_back(obj.vertices[index]);
         }
+        return true;
     }
-
+    vertices = std::move(obj.vertices);
+    indices.assign(obj.indices.begin(), obj.indices.end());
+    std::cout << "Loaded " << filename << ": " << indices.size() / 3 << " triangles, " << vertices.size() << " vertices ("
+              << obj.cornerCount << " without an index buffer)." << std::endl;
     return true;
 }
 
@@ -195,7 +134,61 @@ bool Mesh::loadFromHeightmap(const char *filename) {
     return true;
 }
 
-bool Mesh::flatPlane(int x, int z, int size) {
+uint32_t Mesh::getGridVertexCount(int size) {
+    return static_cast<uint32_t>(size * size);
+}
+
+uint32_t Mesh::getGridIndexCount(int size) {
+    return static_cast<uint32_t>((size - 1) * (size - 1) * 6);
+}
+
+void Mesh::optimize(const char *name) {
+    if (indices.empty()) {
+        return;
+    }
+    VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+    vertices.resize(optimizeVertexFetch(vertices.data(), indices.data(), indices.size(), vertices.size()));
+    VertexCacheStats after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    std::cout << "Optimized " << name << ": ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> "
+              << after.atvr << std::endl;
+}
+
+void Mesh::writeGridIndices(int size, uint16_t *indices, bool optimized) {
+    if (optimized) {
+        //Every chunk has the same triangles, so they're only put in cache order once
+        static std::mutex mutex;
+        static std::map<int, std::vector<uint16_t>> optimizedGrids;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = optimizedGrids.find(size);
+        if (it == optimizedGrids.end()) {
+            std::vector<uint16_t> grid(getGridIndexCount(size));
+            writeGridIndices(size, grid.data(), false);
+            VertexCacheStats before = analyzeVertexCache(grid.data(), grid.size(), getGridVertexCount(size));
+            optimizeVertexCache(grid.data(), grid.size(), getGridVertexCount(size));
+            VertexCacheStats after = analyzeVertexCache(grid.data(), grid.size(), getGridVertexCount(size));
+            std::cout << "Optimized " << size << "x" << size << " grids: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR "
+                      << before.atvr << " -> " << after.atvr << std::endl;
+            it = optimizedGrids.emplace(size, std::move(grid)).first;
+        }
+        std::copy(it->second.begin(), it->second.end(), indices);
+        return;
+    }
+    for (int i = 0; i < size - 1; i++) {
+        for (int j = 0; j < size - 1; j++) {
+            int start = i + j * size;
+            *indices++ = static_cast<uint16_t>(start);
+            *indices++ = static_cast<uint16_t>(start + 1);
+            *indices++ = static_cast<uint16_t>(start + size);
+            *indices++ = static_cast<uint16_t>(start + 1);
+            *indices++ = static_cast<uint16_t>(start + 1 + size);
+            *indices++ = static_cast<uint16_t>(start + size);
+        }
+    }
+}
+
+void Mesh::writeFlatPlane(int size, Vertex *vertices) {
     for (int i = 0; i < size; i++) {
         for (int j = 0; j < size; j++) {
             Vertex new_vertex;
@@ -210,27 +203,13 @@ bool Mesh::flatPlane(int x, int z, int size) {
             //Normals
             new_vertex.normal = {0.0f, 1.0f, 0.0f};
 
-            this->vertices.push_back(new_vertex);
-        }
-    }
-
-    //Indices
-    for (int i = 0; i < size - 1; i++) {
-        for (int j = 0; j < size - 1; j++) {
-            int start = i + j * size;
-            indices.push_back(start);
-            indices.push_back(start + 1);
-            indices.push_back(start + size);
-            indices.push_back(start + 1);
-            indices.push_back(start + 1 + size);
-            indices.push_back(start + size);
+            //Written whole and in order, since this can be uncached memory
+            *vertices++ = new_vertex;
         }
     }
-
-    return true;
 }
 
-bool Mesh::sampleFromNoise(int x, int z, int size, const siv::PerlinNoise& noiseSource) {
+void Mesh::writeNoiseSamples(int x, int z, int size, const siv::PerlinNoise &noiseSource, Vertex *vertices) {
     auto worldPosX = static_cast<float>(x * (size - 1));
     auto worldPosZ = static_cast<float>(z * (size - 1));
 
@@ -265,24 +244,9 @@ bool Mesh::sampleFromNoise(int x, int z, int size, const siv::PerlinNoise& noise
             glm::vec3 ver = {0.0f, bh - th, 2.0f};
             new_vertex.normal = glm::normalize(glm::cross(ver, hor));
 
-            this->vertices.push_back(new_vertex);
+            *vertices++ = new_vertex;
         }
     }
-
-    //Indices
-    for (int i = 0; i < size - 1; i++) {
-        for (int j = 0; j < size - 1; j++) {
-            int start = i + j * size;
-            indices.push_back(start);
-            indices.push_back(start + 1);
-            indices.push_back(start + size);
-            indices.push_back(start + 1);
-            indices.push_back(start + 1 + size);
-            indices.push_back(start + size);
-        }
-    }
-
-    return true;
 }
 
 
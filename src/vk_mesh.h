@@ -7,6 +7,8 @@
 #include <glm/vec2.hpp>
 #include <PerlinNoise.hpp>
 
+class JobSystem;
+
 struct VertexInputDescription {
     std::vector<vk::VertexInputBindingDescription> bindings;
     std::vector<vk::VertexInputAttributeDescription> attributes;
@@ -23,15 +25,30 @@ struct Vertex {
 };
 
 struct Mesh {
+    //Built by the loaders, then uploaded and cleared by VulkanEngine::uploadMesh
     std::vector<Vertex> vertices;
     std::vector<uint16_t> indices;
+    uint32_t vertexCount = 0; //in the vertex buffer
+    uint32_t indexCount = 0; //in the index buffer, 0 if the mesh isn't indexed
+    float boundingRadius = 0.0f; //distance of the farthest vertex from the origin, set by uploading the vectors
     AllocatedBuffer vertexBuffer;
     AllocatedBuffer indexBuffer;
 
-    bool loadFromObj(const char* filename);
+    //Loads an indexed mesh, see obj_loader.h. The job system, if there is one, parses big files in parallel.
+    bool loadFromObj(const char* filename, JobSystem * jobs = nullptr);
     bool loadFromHeightmap(const char* filename);
-    bool flatPlane(int x, int z, int size);
-    bool sampleFromNoise(int x, int z, int size, const siv::PerlinNoise& noiseSource);
+    //Reorders the triangles and vertices for the vertex cache and less overdraw (see mesh_optimizer.h), printing the
+    //ACMR and ATVR before and after
+    void optimize(const char* name);
+
+    //Square grids of size x size vertices, like the terrain chunks. Their size is known up front, so they're written
+    //straight into staging memory by VulkanEngine::uploadMesh instead of being built in the vectors first.
+    static uint32_t getGridVertexCount(int size);
+    static uint32_t getGridIndexCount(int size);
+    //The triangles are in vertex cache order unless optimized is false, the order being worked out once per size
+    static void writeGridIndices(int size, uint16_t * indices, bool optimized = true);
+    static void writeFlatPlane(int size, Vertex * vertices);
+    static void writeNoiseSamples(int x, int z, int size, const siv::PerlinNoise& noiseSource, Vertex * vertices);
 };
 
 
@@ -0,0 +1,135 @@
+#include "vk_pipeline_cache.h"
+#include "cpu_profiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <filesystem>
+
+static const uint32_t CACHE_FILE_MAGIC = 0x43504B56; //"VKPC"
+static const uint32_t CACHE_FILE_VERSION = 1;
+
+void PipelineCache::init(vk::Device device, const vk::PhysicalDeviceProperties &properties, const std::string &path) {
+    PROFILE_FUNCTION();
+    m_device = device;
+    m_properties = properties;
+    m_path = path;
+
+    std::vector<uint8_t> data;
+    std::ifstream file(m_path, std::ios::binary);
+    if (!m_path.empty() && file.is_open()) {
+        FileHeader header = {};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (file && header.dataSize < (1ull << 31)) {
+            data.resize(header.dataSize);
+            file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        }
+        if (!file || !validate(header, data)) {
+            std::cout << "Pipeline cache " << m_path << " is stale or corrupt, starting with an empty cache." << std::endl;
+            data.clear();
+        }
+    }
+
+    vk::PipelineCacheCreateInfo info = {};
+    info.initialDataSize = data.size();
+    info.pInitialData = data.empty() ? nullptr : data.data();
+    m_cache = m_device.createPipelineCache(info);
+    m_warm = !data.empty();
+
+    if (m_warm) {
+        std::cout << "Loaded " << data.size() << " bytes of pipeline cache from " << m_path << std::endl;
+    }
+}
+
+void PipelineCache::cleanup() {
+    save();
+    m_device.destroyPipelineCache(m_cache);
+    m_cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::save() {
+    if (!m_cache) {
+        return false;
+    }
+    PROFILE_FUNCTION();
+    std::vector<uint8_t> data = m_device.getPipelineCacheData(m_cache);
+    m_warm = !data.empty();
+    if (m_path.empty()) {
+        return false;
+    }
+
+    FileHeader header = {};
+    header.magic = CACHE_FILE_MAGIC;
+    header.version = CACHE_FILE_VERSION;
+    header.vendorID = m_properties.vendorID;
+    header.deviceID = m_properties.deviceID;
+    header.driverVersion = m_properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.dataHash = hash(data.data(), data.size());
+
+    //Write to a temporary file first and rename it over the old cache, which is atomic
+    std::string tempPath = m_path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Failed to open " << tempPath << " for writing." << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            std::cout << "Failed to write pipeline cache to " << tempPath << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, m_path, error);
+    if (error) {
+        std::cout << "Failed to replace " << m_path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool PipelineCache::validate(const FileHeader &header, const std::vector<uint8_t> &data) const {
+    if (header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION) {
+        return false;
+    }
+    //A driver update usually invalidates its caches, even if the device stays the same
+    if (header.vendorID != m_properties.vendorID || header.deviceID != m_properties.deviceID ||
+        header.driverVersion != m_properties.driverVersion ||
+        memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+        return false;
+    }
+    if (header.dataSize != data.size() || header.dataHash != hash(data.data(), data.size())) {
+        return false;
+    }
+
+    //The driver's own header (VkPipelineCacheHeaderVersionOne) should agree with ours
+    struct VulkanHeader {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    } vulkanHeader = {};
+    if (data.size() < sizeof(vulkanHeader)) {
+        return false;
+    }
+    memcpy(&vulkanHeader, data.data(), sizeof(vulkanHeader));
+    return vulkanHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           vulkanHeader.vendorID == m_properties.vendorID && vulkanHeader.deviceID == m_properties.deviceID &&
+           memcmp(vulkanHeader.pipelineCacheUUID, m_properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+//64-bit FNV-1a
+uint64_t PipelineCache::hash(const uint8_t *data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
@@ -0,0 +1,49 @@
+#ifndef VKENG_VK_PIPELINE_CACHE_H
+#define VKENG_VK_PIPELINE_CACHE_H
+
+#include <string>
+#include <vector>
+#include "vk_types.h"
+
+/*
+ * vk::PipelineCache that persists between runs. The driver's cache blob is stored behind our own header recording the
+ * device, driver version and a checksum, and is thrown away if any of them don't match, since drivers aren't required
+ * to reject stale or corrupt data themselves. Saving writes a temporary file and renames it over the old one, so a
+ * crash mid-write never leaves a truncated cache behind.
+ */
+class PipelineCache {
+public:
+    //Loads the cache from path if it's valid for this device, otherwise starts empty. An empty path disables saving.
+    void init(vk::Device device, const vk::PhysicalDeviceProperties & properties, const std::string & path);
+    //Saves and destroys the cache
+    void cleanup();
+
+    vk::PipelineCache get() const { return m_cache; }
+    //True if the cache already holds pipelines, either from a previous run or from earlier in this one
+    bool isWarm() const { return m_warm; }
+
+    bool save();
+
+private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    vk::Device m_device;
+    vk::PipelineCache m_cache;
+    vk::PhysicalDeviceProperties m_properties;
+    std::string m_path;
+    bool m_warm = false;
+
+    bool validate(const FileHeader & header, const std::vector<uint8_t> & data) const;
+    static uint64_t hash(const uint8_t * data, size_t size);
+};
+
+#endif //VKENG_VK_PIPELINE_CACHE_H
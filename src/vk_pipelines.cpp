@@ -0,0 +1,258 @@
+#include "vk_pipelines.h"
+#include "cpu_profiler.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t * bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void ShaderSpecialization::setInt(uint32_t constantID, int32_t value) {
+    set(constantID, &value, sizeof(value));
+}
+
+void ShaderSpecialization::setFloat(uint32_t constantID, float value) {
+    set(constantID, &value, sizeof(value));
+}
+
+void ShaderSpecialization::setBool(uint32_t constantID, bool value) {
+    //Boolean specialization constants are 32 bits wide
+    VkBool32 boolValue = value ? VK_TRUE : VK_FALSE;
+    set(constantID, &boolValue, sizeof(boolValue));
+}
+
+void ShaderSpecialization::set(uint32_t constantID, const void *value, size_t size) {
+    for (const auto & entry : m_entries) {
+        if (entry.constantID == constantID && entry.size == size) {
+            memcpy(m_data.data() + entry.offset, value, size);
+            return;
+        }
+    }
+    vk::SpecializationMapEntry entry = {};
+    entry.constantID = constantID;
+    entry.offset = static_cast<uint32_t>(m_data.size());
+    entry.size = size;
+    m_entries.push_back(entry);
+    m_data.resize(m_data.size() + size);
+    memcpy(m_data.data() + entry.offset, value, size);
+}
+
+uint64_t ShaderSpecialization::getKey() const {
+    uint64_t hash = HASH_SEED;
+    for (const auto & entry : m_entries) {
+        hash = hashBytes(hash, &entry.constantID, sizeof(entry.constantID));
+        hash = hashBytes(hash, m_data.data() + entry.offset, entry.size);
+    }
+    return hash;
+}
+
+vk::SpecializationInfo ShaderSpecialization::getInfo() const {
+    vk::SpecializationInfo info = {};
+    info.setMapEntries(m_entries);
+    info.dataSize = m_data.size();
+    info.pData = m_data.data();
+    return info;
+}
+
+void PipelineBuilder::setSpecialization(vk::ShaderStageFlagBits stage, const ShaderSpecialization &specialization) {
+    for (auto & [existingStage, existing] : m_specializations) {
+        if (existingStage == stage) {
+            existing = specialization;
+            return;
+        }
+    }
+    m_specializations.emplace_back(stage, specialization);
+}
+
+uint64_t PipelineBuilder::getVariantKey() const {
+    if (m_specializations.empty()) {
+        return 0;
+    }
+    uint64_t hash = HASH_SEED;
+    for (const auto & [stage, specialization] : m_specializations) {
+        uint64_t key = specialization.getKey();
+        hash = hashBytes(hash, &stage, sizeof(stage));
+        hash = hashBytes(hash, &key, sizeof(key));
+    }
+    return hash;
+}
+
+vk::Pipeline PipelineBuilder::buildPipeline(vk::Device device, vk::RenderPass pass, vk::PipelineCache cache) {
+    //Create viewportstate from the stored viewport and scissor.
+    //At the moment we don't support multiple viewports or scissors.
+    vk::PipelineViewportStateCreateInfo viewportInfo = {};
+    viewportInfo.viewportCount = 1;
+    viewportInfo.setViewports(m_viewport);
+    viewportInfo.scissorCount = 1;
+    viewportInfo.setScissors(m_scissor);
+
+    //Set up dummy color blending. As we aren't yet using transparent objects, we don't do blending,
+    //but we do write to the color attachment.
+    vk::PipelineColorBlendStateCreateInfo colorBlendInfo = {};
+    colorBlendInfo.logicOpEnable = VK_FALSE;
+    colorBlendInfo.logicOp = vk::LogicOp::eCopy;
+    colorBlendInfo.setAttachments(m_colorBlendAttachmentState);
+
+    vk::PipelineVertexInputStateCreateInfo vertexInputInfo = m_vertexInputInfo;
+    if (!m_vertexDescription.bindings.empty()) {
+        vertexInputInfo.setVertexBindingDescriptions(m_vertexDescription.bindings);
+        vertexInputInfo.setVertexAttributeDescriptions(m_vertexDescription.attributes);
+    }
+
+    //Hook up the specialization constants. The infos live until the pipeline is created; the stages point at them.
+    std::vector<vk::PipelineShaderStageCreateInfo> stageInfos = m_shaderStageInfos;
+    std::vector<vk::SpecializationInfo> specializationInfos;
+    specializationInfos.reserve(m_specializations.size());
+    for (auto & stageInfo : stageInfos) {
+        for (const auto & [stage, specialization] : m_specializations) {
+            if (stage == stageInfo.stage && !specialization.empty()) {
+                specializationInfos.push_back(specialization.getInfo());
+                stageInfo.pSpecializationInfo = &specializationInfos.back();
+            }
+        }
+    }
+
+    //The actual pipeline
+    vk::GraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.stageCount = stageInfos.size();
+    pipelineInfo.setStages(stageInfos);
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &m_inputAssemblyInfo;
+    pipelineInfo.pViewportState = &viewportInfo;
+    pipelineInfo.pRasterizationState = &m_rasterizerInfo;
+    pipelineInfo.pMultisampleState = &m_multisampleInfo;
+    pipelineInfo.pColorBlendState = &colorBlendInfo;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = pass;
+    pipelineInfo.subpass = 0;
+
+    //Without a render pass the attachment formats come from a chained struct instead
+    vk::PipelineRenderingCreateInfo renderingInfo = {};
+    if (!pass) {
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &m_colorAttachmentFormat;
+        renderingInfo.depthAttachmentFormat = m_depthAttachmentFormat;
+        pipelineInfo.pNext = &renderingInfo;
+    }
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.pDepthStencilState = &m_depthStencil;
+
+    //Dynamic scissor and viewport
+    vk::PipelineDynamicStateCreateInfo dynInfo = {};
+    vk::DynamicState dynamicStates[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    dynInfo.setDynamicStates(dynamicStates);
+    pipelineInfo.setPDynamicState(&dynInfo);
+
+    auto pipeline = device.createGraphicsPipeline(cache, pipelineInfo);
+    switch (pipeline.result) {
+        case vk::Result::eSuccess:
+            return pipeline.value;
+        default:
+            std::cout << "Pipeline create failed." << std::endl;
+            return VK_NULL_HANDLE;
+    }
+
+    return vk::Pipeline();
+}
+
+void PipelineLayoutCache::init(vk::Device device) {
+    m_device = device;
+}
+
+void PipelineLayoutCache::cleanup() {
+    for (const auto & [hash, info] : m_layouts) {
+        m_device.destroyPipelineLayout(info.layout);
+    }
+    m_layouts.clear();
+}
+
+vk::PipelineLayout PipelineLayoutCache::createPipelineLayout(const std::vector<vk::DescriptorSetLayout> &setLayouts,
+                                                             const std::vector<vk::PushConstantRange> &pushConstantRanges) {
+    uint64_t hash = HASH_SEED;
+    for (const auto & setLayout : setLayouts) {
+        VkDescriptorSetLayout handle = setLayout;
+        hash = hashBytes(hash, &handle, sizeof(handle));
+    }
+    for (const auto & range : pushConstantRanges) {
+        VkShaderStageFlags stages = static_cast<VkShaderStageFlags>(range.stageFlags);
+        hash = hashBytes(hash, &stages, sizeof(stages));
+        hash = hashBytes(hash, &range.offset, sizeof(range.offset));
+        hash = hashBytes(hash, &range.size, sizeof(range.size));
+    }
+
+    auto [first, last] = m_layouts.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        if (it->second.setLayouts == setLayouts && it->second.pushConstantRanges == pushConstantRanges) {
+            return it->second.layout;
+        }
+    }
+
+    vk::PipelineLayoutCreateInfo info = {};
+    info.setSetLayouts(setLayouts);
+    info.setPushConstantRanges(pushConstantRanges);
+    LayoutInfo layoutInfo = {setLayouts, pushConstantRanges, m_device.createPipelineLayout(info)};
+    m_layouts.emplace(hash, layoutInfo);
+    return layoutInfo.layout;
+}
+
+void PipelineCompiler::init(vk::Device device, JobSystem *jobs) {
+    m_device = device;
+    m_jobs = jobs;
+}
+
+void PipelineCompiler::submit(const std::string &name, uint64_t key, const PipelineBuilder &builder, vk::RenderPass pass, vk::PipelineCache cache) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending++;
+    }
+    m_jobs->submit([this, name, key, builder, pass, cache]() mutable {
+        PROFILE_ZONE("compilePipeline");
+        auto start = std::chrono::high_resolution_clock::now();
+        vk::Pipeline pipeline;
+        try {
+            pipeline = builder.buildPipeline(m_device, pass, cache);
+        }
+        catch (const std::exception & e) {
+            //Nobody waits on the job's future, so report it here and hand back a null pipeline
+            std::cout << "Failed to build pipeline for " << name << ": " << e.what() << std::endl;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_completed.push_back({name, key, pipeline, std::chrono::duration<double, std::milli>(end - start).count()});
+        m_pending--;
+        if (m_pending == 0) {
+            m_idleTime = end;
+            m_idle.notify_all();
+        }
+    });
+}
+
+std::vector<CompiledPipeline> PipelineCompiler::takeCompleted() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<CompiledPipeline> completed;
+    completed.swap(m_completed);
+    return completed;
+}
+
+uint32_t PipelineCompiler::getPendingCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
+
+std::chrono::high_resolution_clock::time_point PipelineCompiler::getIdleTime() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_idleTime;
+}
+
+void PipelineCompiler::waitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&]() { return m_pending == 0; });
+}
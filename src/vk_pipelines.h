@@ -0,0 +1,141 @@
+#ifndef VKENG_VK_PIPELINES_H
+#define VKENG_VK_PIPELINES_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_map>
+#include "vk_types.h"
+#include "vk_mesh.h"
+#include "job_system.h"
+
+//FNV-1a, for building keys out of pipeline state
+constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+uint64_t hashBytes(uint64_t hash, const void * data, size_t size);
+
+/*
+ * Values for a shader's specialization constants. The driver folds them into the shader when the pipeline is built,
+ * so loops over them unroll and branches on them disappear. Pipelines built with different values are different
+ * variants of the same material, told apart by getKey().
+ */
+class ShaderSpecialization {
+public:
+    //Setting a constant again replaces its value. Constants the shader doesn't declare are ignored by Vulkan.
+    void setInt(uint32_t constantID, int32_t value);
+    void setFloat(uint32_t constantID, float value);
+    void setBool(uint32_t constantID, bool value);
+
+    bool empty() const { return m_entries.empty(); }
+    //Hash of the constant IDs and values. Equal for specializations built by setting the same constants in the same order.
+    uint64_t getKey() const;
+    //Points into this object, so it's only valid while this isn't changed or moved
+    vk::SpecializationInfo getInfo() const;
+
+private:
+    std::vector<vk::SpecializationMapEntry> m_entries;
+    std::vector<uint8_t> m_data;
+
+    void set(uint32_t constantID, const void * value, size_t size);
+};
+
+//sweet lord what is happening in here??
+//Thank you vkguide.dev
+class PipelineBuilder {
+public:
+    std::vector<vk::PipelineShaderStageCreateInfo> m_shaderStageInfos;
+    vk::PipelineVertexInputStateCreateInfo m_vertexInputInfo;
+    //If this has bindings, m_vertexInputInfo is pointed at it when building. Owning the description rather than
+    //pointing at someone else's keeps a copied builder valid, which building on another thread relies on.
+    VertexInputDescription m_vertexDescription;
+    vk::PipelineInputAssemblyStateCreateInfo m_inputAssemblyInfo;
+    vk::Viewport m_viewport;
+    vk::Rect2D m_scissor;
+    vk::PipelineRasterizationStateCreateInfo m_rasterizerInfo;
+    vk::PipelineColorBlendAttachmentState m_colorBlendAttachmentState;
+    vk::PipelineMultisampleStateCreateInfo m_multisampleInfo;
+    vk::PipelineLayout m_pipelineLayout;
+    vk::PipelineDepthStencilStateCreateInfo m_depthStencil;
+    //Attachment formats, used instead of a render pass when building for dynamic rendering
+    vk::Format m_colorAttachmentFormat = vk::Format::eUndefined;
+    vk::Format m_depthAttachmentFormat = vk::Format::eUndefined;
+    //Specialization constants per stage. Kept here rather than in the stage infos for the same reason as m_vertexDescription.
+    std::vector<std::pair<vk::ShaderStageFlagBits, ShaderSpecialization>> m_specializations;
+
+    void setSpecialization(vk::ShaderStageFlagBits stage, const ShaderSpecialization & specialization);
+    //Identifies the variant this builder makes: 0 without specialization constants
+    uint64_t getVariantKey() const;
+
+    //With a null pass the pipeline is built for dynamic rendering with the attachment formats above
+    vk::Pipeline buildPipeline(vk::Device device, vk::RenderPass pass, vk::PipelineCache cache = VK_NULL_HANDLE);
+
+};
+
+/*
+ * Pipeline layouts by their set layouts and push constant ranges, so materials with the same shader interface
+ * share a layout. Materials sharing a layout don't have to rebind descriptor sets when switching between them.
+ */
+class PipelineLayoutCache {
+public:
+    void init(vk::Device device);
+    //Destroys every layout handed out
+    void cleanup();
+
+    vk::PipelineLayout createPipelineLayout(const std::vector<vk::DescriptorSetLayout> & setLayouts,
+                                            const std::vector<vk::PushConstantRange> & pushConstantRanges);
+    size_t getLayoutCount() const { return m_layouts.size(); }
+
+private:
+    struct LayoutInfo {
+        std::vector<vk::DescriptorSetLayout> setLayouts;
+        std::vector<vk::PushConstantRange> pushConstantRanges;
+        vk::PipelineLayout layout;
+    };
+    vk::Device m_device;
+    //Few layouts, so a hash and a linear search of the matches is plenty
+    std::unordered_multimap<uint64_t, LayoutInfo> m_layouts;
+};
+
+struct CompiledPipeline {
+    std::string name;
+    uint64_t key; //whatever the caller passed to submit(), to tell the results apart
+    vk::Pipeline pipeline; //null if the build failed
+    double compileMs;
+};
+
+/*
+ * Builds pipelines on the job system. Each submit is an independent job; finished pipelines are collected with
+ * takeCompleted() so the main thread can hand them to their materials between frames. The pipeline cache is shared
+ * by all jobs, which is fine because pipeline caches are internally synchronized unless created otherwise.
+ */
+class PipelineCompiler {
+public:
+    void init(vk::Device device, JobSystem * jobs);
+
+    //The builder is copied, so it can be changed and submitted again straight away. The name is only for logging.
+    //A null pass builds for dynamic rendering.
+    void submit(const std::string & name, uint64_t key, const PipelineBuilder & builder, vk::RenderPass pass, vk::PipelineCache cache);
+
+    //Pipelines finished since the last call, in the order they finished
+    std::vector<CompiledPipeline> takeCompleted();
+
+    uint32_t getPendingCount();
+    //When the last build finished, i.e. when the pending count last dropped to 0. Pipelines are installed whenever
+    //the main thread gets around to it, so batch timings are taken from here rather than from then.
+    std::chrono::high_resolution_clock::time_point getIdleTime();
+    //Blocks until every submitted pipeline has finished building
+    void waitIdle();
+
+private:
+    vk::Device m_device;
+    JobSystem * m_jobs = nullptr;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::vector<CompiledPipeline> m_completed;
+    uint32_t m_pending = 0;
+    std::chrono::high_resolution_clock::time_point m_idleTime;
+};
+
+#endif //VKENG_VK_PIPELINES_H
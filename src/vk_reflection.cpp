@@ -0,0 +1,371 @@
+#include "vk_reflection.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+//The bits of the SPIR-V spec this needs. The numbers are from the unified SPIR-V specification.
+namespace spv {
+    constexpr uint32_t MAGIC = 0x07230203;
+    constexpr uint32_t HEADER_WORDS = 5;
+
+    enum Op : uint32_t {
+        OpName = 5,
+        OpEntryPoint = 15,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpSpecConstant = 50,
+        OpFunction = 54,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+    };
+
+    enum Decoration : uint32_t {
+        SpecId = 1,
+        BufferBlock = 3,
+        ArrayStride = 6,
+        MatrixStride = 7,
+        Binding = 33,
+        DescriptorSet = 34,
+        Offset = 35,
+    };
+
+    enum StorageClass : uint32_t {
+        UniformConstant = 0,
+        Uniform = 2,
+        PushConstant = 9,
+        StorageBuffer = 12,
+    };
+
+    enum Dim : uint32_t {
+        DimBuffer = 5,
+        DimSubpassData = 6,
+    };
+}
+
+namespace {
+    constexpr uint32_t UNSET = std::numeric_limits<uint32_t>::max();
+
+    //Everything known about one SPIR-V id
+    struct SpirvId {
+        uint32_t opcode = 0;
+        uint32_t typeID = 0; //result type, for constants and variables
+        std::vector<uint32_t> operands; //operands after the result id
+        std::string name;
+
+        uint32_t set = UNSET;
+        uint32_t binding = UNSET;
+        uint32_t specID = NO_SPECIALIZATION;
+        uint32_t arrayStride = 0;
+        bool bufferBlock = false;
+        std::vector<uint32_t> memberOffsets;
+        std::vector<uint32_t> memberMatrixStrides;
+    };
+
+    class SpirvModule {
+    public:
+        SpirvModule(const uint32_t * code, size_t codeWords);
+
+        ShaderReflection reflect() const;
+
+    private:
+        std::vector<SpirvId> m_ids;
+        std::unordered_set<uint32_t> m_usedIDs; //every id appearing as an operand inside a function
+        vk::ShaderStageFlagBits m_stage = vk::ShaderStageFlagBits::eVertex;
+
+        const SpirvId & get(uint32_t id) const;
+        uint32_t getConstant(uint32_t id) const;
+        uint32_t getSize(uint32_t typeID, uint32_t matrixStride) const;
+        void addBinding(uint32_t variableID, ShaderReflection & reflection) const;
+        void addPushConstants(uint32_t variableID, ShaderReflection & reflection) const;
+    };
+
+    vk::ShaderStageFlagBits toStage(uint32_t executionModel) {
+        switch (executionModel) {
+            case 0: return vk::ShaderStageFlagBits::eVertex;
+            case 1: return vk::ShaderStageFlagBits::eTessellationControl;
+            case 2: return vk::ShaderStageFlagBits::eTessellationEvaluation;
+            case 3: return vk::ShaderStageFlagBits::eGeometry;
+            case 4: return vk::ShaderStageFlagBits::eFragment;
+            case 5: return vk::ShaderStageFlagBits::eCompute;
+            default: throw std::runtime_error("Unsupported SPIR-V execution model " + std::to_string(executionModel));
+        }
+    }
+}
+
+SpirvModule::SpirvModule(const uint32_t *code, size_t codeWords) {
+    if (codeWords < spv::HEADER_WORDS || code[0] != spv::MAGIC) {
+        throw std::runtime_error("Not a SPIR-V module.");
+    }
+    m_ids.resize(code[3]); //the id bound
+
+    bool foundEntryPoint = false;
+    bool inFunction = false;
+    size_t offset = spv::HEADER_WORDS;
+    while (offset < codeWords) {
+        uint32_t wordCount = code[offset] >> 16;
+        uint32_t opcode = code[offset] & 0xffff;
+        if (wordCount == 0 || offset + wordCount > codeWords) {
+            throw std::runtime_error("Truncated SPIR-V instruction.");
+        }
+        const uint32_t * words = &code[offset];
+        offset += wordCount;
+
+        //Inside functions only the references to globals matter
+        if (opcode == spv::OpFunction) {
+            inFunction = true;
+        }
+        if (inFunction) {
+            for (uint32_t i = 1; i < wordCount; i++) {
+                m_usedIDs.insert(words[i]);
+            }
+            continue;
+        }
+
+        //Ids are range checked once here so the rest of the parser can index freely
+        auto id = [&](uint32_t index) -> SpirvId & {
+            if (index >= wordCount || words[index] >= m_ids.size()) {
+                throw std::runtime_error("Malformed SPIR-V instruction.");
+            }
+            return m_ids[words[index]];
+        };
+        switch (opcode) {
+            case spv::OpName:
+                if (wordCount > 2) {
+                    id(1).name = reinterpret_cast<const char *>(&words[2]);
+                }
+                break;
+            case spv::OpEntryPoint:
+                //Only the first entry point is reflected; glslc emits one per module
+                if (!foundEntryPoint && wordCount > 1) {
+                    m_stage = toStage(words[1]);
+                    foundEntryPoint = true;
+                }
+                break;
+            case spv::OpDecorate:
+                if (wordCount > 2) {
+                    SpirvId & target = id(1);
+                    uint32_t value = wordCount > 3 ? words[3] : 0;
+                    switch (words[2]) {
+                        case spv::SpecId: target.specID = value; break;
+                        case spv::BufferBlock: target.bufferBlock = true; break;
+                        case spv::ArrayStride: target.arrayStride = value; break;
+                        case spv::Binding: target.binding = value; break;
+                        case spv::DescriptorSet: target.set = value; break;
+                        default: break;
+                    }
+                }
+                break;
+            case spv::OpMemberDecorate:
+                if (wordCount > 4) {
+                    SpirvId & target = id(1);
+                    uint32_t member = words[2];
+                    if (words[3] == spv::Offset || words[3] == spv::MatrixStride) {
+                        auto & values = words[3] == spv::Offset ? target.memberOffsets : target.memberMatrixStrides;
+                        if (values.size() <= member) {
+                            values.resize(member + 1, 0);
+                        }
+                        values[member] = words[4];
+                    }
+                }
+                break;
+            case spv::OpConstant:
+            case spv::OpSpecConstant:
+            case spv::OpVariable:
+                if (wordCount > 2) {
+                    SpirvId & target = id(2);
+                    target.opcode = opcode;
+                    target.typeID = words[1];
+                    target.operands.assign(words + 3, words + wordCount);
+                }
+                break;
+            default:
+                if (opcode >= spv::OpTypeInt && opcode <= spv::OpTypePointer && wordCount > 1) {
+                    SpirvId & target = id(1);
+                    target.opcode = opcode;
+                    target.operands.assign(words + 2, words + wordCount);
+                }
+                break;
+        }
+    }
+    if (!foundEntryPoint) {
+        throw std::runtime_error("SPIR-V module has no entry point.");
+    }
+}
+
+const SpirvId &SpirvModule::get(uint32_t id) const {
+    if (id >= m_ids.size()) {
+        throw std::runtime_error("SPIR-V id out of range.");
+    }
+    return m_ids[id];
+}
+
+uint32_t SpirvModule::getConstant(uint32_t id) const {
+    const SpirvId & constant = get(id);
+    if ((constant.opcode != spv::OpConstant && constant.opcode != spv::OpSpecConstant) || constant.operands.empty()) {
+        throw std::runtime_error("Array size isn't a constant.");
+    }
+    return constant.operands[0];
+}
+
+//Size in bytes of a type inside a block. Matrices need the stride their member was decorated with.
+uint32_t SpirvModule::getSize(uint32_t typeID, uint32_t matrixStride) const {
+    const SpirvId & type = get(typeID);
+    const auto & ops = type.operands;
+    switch (type.opcode) {
+        case spv::OpTypeInt:
+        case spv::OpTypeFloat:
+            return ops.at(0) / 8;
+        case spv::OpTypeVector:
+            return ops.at(1) * getSize(ops.at(0), 0);
+        case spv::OpTypeMatrix:
+            return ops.at(1) * (matrixStride != 0 ? matrixStride : getSize(ops.at(0), 0));
+        case spv::OpTypeArray:
+            return getConstant(ops.at(1)) * (type.arrayStride != 0 ? type.arrayStride : getSize(ops.at(0), matrixStride));
+        case spv::OpTypeRuntimeArray:
+            return 0;
+        case spv::OpTypeStruct: {
+            uint32_t size = 0;
+            for (uint32_t i = 0; i < ops.size() && i < type.memberOffsets.size(); i++) {
+                uint32_t stride = i < type.memberMatrixStrides.size() ? type.memberMatrixStrides[i] : 0;
+                size = std::max(size, type.memberOffsets[i] + getSize(ops[i], stride));
+            }
+            return size;
+        }
+        default:
+            throw std::runtime_error("Unsupported type in a SPIR-V block.");
+    }
+}
+
+void SpirvModule::addBinding(uint32_t variableID, ShaderReflection &reflection) const {
+    const SpirvId & variable = m_ids[variableID];
+    uint32_t storageClass = variable.operands.at(0);
+    ReflectedBinding binding = {};
+    binding.set = variable.set;
+    binding.binding = variable.binding;
+    binding.count = 1;
+    binding.stages = m_stage;
+    binding.name = variable.name;
+
+    //Variables are pointers; arrays of descriptors are arrays of the descriptor type
+    const SpirvId * type = &get(get(variable.typeID).operands.at(1));
+    if (type->opcode == spv::OpTypeArray) {
+        const SpirvId & length = get(type->operands.at(1));
+        binding.count = getConstant(type->operands.at(1));
+        if (length.opcode == spv::OpSpecConstant) {
+            binding.countSpecializationID = length.specID;
+        }
+        type = &get(type->operands.at(0));
+    }
+    else if (type->opcode == spv::OpTypeRuntimeArray) {
+        throw std::runtime_error("Unsized descriptor array " + binding.name + " isn't supported.");
+    }
+
+    if (storageClass == spv::StorageBuffer || (storageClass == spv::Uniform && type->bufferBlock)) {
+        binding.type = vk::DescriptorType::eStorageBuffer;
+    }
+    else if (storageClass == spv::Uniform) {
+        binding.type = vk::DescriptorType::eUniformBuffer;
+    }
+    else if (type->opcode == spv::OpTypeSampledImage) {
+        binding.type = vk::DescriptorType::eCombinedImageSampler;
+    }
+    else if (type->opcode == spv::OpTypeSampler) {
+        binding.type = vk::DescriptorType::eSampler;
+    }
+    else if (type->opcode == spv::OpTypeImage) {
+        //Operands: sampled type, dim, depth, arrayed, multisampled, sampled (1 = sampled, 2 = storage)
+        uint32_t dim = type->operands.at(1);
+        bool storage = type->operands.at(5) == 2;
+        if (dim == spv::DimSubpassData) {
+            binding.type = vk::DescriptorType::eInputAttachment;
+        }
+        else if (dim == spv::DimBuffer) {
+            binding.type = storage ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer;
+        }
+        else {
+            binding.type = storage ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+        }
+    }
+    else {
+        throw std::runtime_error("Unsupported descriptor type for " + binding.name + ".");
+    }
+    reflection.bindings.push_back(binding);
+}
+
+void SpirvModule::addPushConstants(uint32_t variableID, ShaderReflection &reflection) const {
+    const SpirvId & block = get(get(m_ids[variableID].typeID).operands.at(1));
+    if (block.opcode != spv::OpTypeStruct || block.memberOffsets.empty()) {
+        throw std::runtime_error("Push constant block without member offsets.");
+    }
+    vk::PushConstantRange range;
+    range.stageFlags = m_stage;
+    range.offset = *std::min_element(block.memberOffsets.begin(), block.memberOffsets.end());
+    range.size = getSize(get(m_ids[variableID].typeID).operands.at(1), 0) - range.offset;
+    reflection.pushConstantRanges.push_back(range);
+}
+
+ShaderReflection SpirvModule::reflect() const {
+    ShaderReflection reflection;
+    reflection.stages = m_stage;
+    for (uint32_t id = 0; id < m_ids.size(); id++) {
+        const SpirvId & variable = m_ids[id];
+        if (variable.opcode != spv::OpVariable || variable.operands.empty() || m_usedIDs.count(id) == 0) {
+            continue;
+        }
+        uint32_t storageClass = variable.operands[0];
+        if (storageClass == spv::PushConstant) {
+            addPushConstants(id, reflection);
+        }
+        else if (storageClass == spv::UniformConstant || storageClass == spv::Uniform || storageClass == spv::StorageBuffer) {
+            if (variable.set == UNSET || variable.binding == UNSET) {
+                throw std::runtime_error("Descriptor " + variable.name + " has no set or binding.");
+            }
+            addBinding(id, reflection);
+        }
+    }
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ReflectedBinding & a, const ReflectedBinding & b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+    return reflection;
+}
+
+ShaderReflection reflectShader(const uint32_t *code, size_t wordCount) {
+    return SpirvModule(code, wordCount).reflect();
+}
+
+void ShaderReflection::merge(const ShaderReflection &other) {
+    stages |= other.stages;
+    for (const auto & binding : other.bindings) {
+        auto it = std::find_if(bindings.begin(), bindings.end(), [&](const ReflectedBinding & existing) {
+            return existing.set == binding.set && existing.binding == binding.binding;
+        });
+        if (it == bindings.end()) {
+            bindings.push_back(binding);
+            continue;
+        }
+        if (it->type != binding.type) {
+            throw std::runtime_error("Stages disagree on the type of set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) + ".");
+        }
+        it->stages |= binding.stages;
+        it->count = std::max(it->count, binding.count);
+        if (it->countSpecializationID == NO_SPECIALIZATION) {
+            it->countSpecializationID = binding.countSpecializationID;
+        }
+    }
+    std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding & a, const ReflectedBinding & b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+    pushConstantRanges.insert(pushConstantRanges.end(), other.pushConstantRanges.begin(), other.pushConstantRanges.end());
+}
@@ -0,0 +1,40 @@
+#ifndef VKENG_VK_REFLECTION_H
+#define VKENG_VK_REFLECTION_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include "vk_types.h"
+
+constexpr uint32_t NO_SPECIALIZATION = std::numeric_limits<uint32_t>::max();
+
+//A descriptor declared by a shader, from its set and binding decorations
+struct ReflectedBinding {
+    uint32_t set;
+    uint32_t binding;
+    //SPIR-V doesn't say whether a buffer is dynamic, so uniform and storage buffers always come out as the plain types
+    vk::DescriptorType type;
+    uint32_t count; //array size, 1 if it isn't an array
+    uint32_t countSpecializationID = NO_SPECIALIZATION; //constant_id if the array size is a specialization constant; count is its default then
+    vk::ShaderStageFlags stages;
+    std::string name; //the variable's name, if the compiler kept it
+};
+
+/*
+ * The resource interface of one or more shader stages: descriptor bindings and push constant ranges. Declarations
+ * the shader code never touches are left out, so the result is what a pipeline layout actually has to provide.
+ */
+struct ShaderReflection {
+    vk::ShaderStageFlags stages;
+    std::vector<ReflectedBinding> bindings; //sorted by set, then binding
+    std::vector<vk::PushConstantRange> pushConstantRanges; //at most one per stage before merging
+
+    //Adds another stage's interface. A binding both declare gets both stages; they must agree on its type.
+    void merge(const ShaderReflection & other);
+};
+
+//Parses a SPIR-V module. Throws std::runtime_error if it's malformed or declares descriptors this can't describe.
+ShaderReflection reflectShader(const uint32_t * code, size_t wordCount);
+
+#endif //VKENG_VK_REFLECTION_H
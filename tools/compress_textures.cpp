@@ -0,0 +1,376 @@
+//Compresses an image into a KTX2 texture with a full mip chain for the engine, see src/ktx_texture.h for what it reads.
+//Usage: compress_textures [--linear] [--normal-map] <input image> <output.ktx2>
+//Opaque images become BC1 and ones with any transparency BC3, sRGB unless --linear is given. --normal-map keeps only
+//red and green, as BC5, for tangent space normal maps.
+
+#include "ktx_texture.h"
+#include "mip_chain.h"
+
+#include <stb_image.h>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//Data format descriptor values from the Khronos Data Format specification
+constexpr uint32_t KHR_DF_MODEL_BC1A = 128;
+constexpr uint32_t KHR_DF_MODEL_BC3 = 130;
+constexpr uint32_t KHR_DF_MODEL_BC5 = 132;
+constexpr uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+constexpr uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+constexpr uint32_t KHR_DF_TRANSFER_SRGB = 2;
+constexpr uint32_t KHR_DF_CHANNEL_COLOR = 0; //also red in BC5
+constexpr uint32_t KHR_DF_CHANNEL_GREEN = 1;
+constexpr uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+constexpr uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+struct Texel {
+    float r, g, b;
+};
+
+static uint16_t packColor565(const Texel & color) {
+    auto quantize = [](float value, float maximum) {
+        return static_cast<uint16_t>(std::clamp(value / 255.0f * maximum + 0.5f, 0.0f, maximum));
+    };
+    return static_cast<uint16_t>(quantize(color.r, 31.0f) << 11 | quantize(color.g, 63.0f) << 5 | quantize(color.b, 31.0f));
+}
+
+//The color the GPU decodes from a 565 endpoint
+static Texel unpackColor565(uint16_t color) {
+    uint32_t r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+    return {static_cast<float>(r << 3 | r >> 2), static_cast<float>(g << 2 | g >> 4), static_cast<float>(b << 3 | b >> 2)};
+}
+
+static float distanceSquared(const Texel & a, const Texel & b) {
+    return (a.r - b.r) * (a.r - b.r) + (a.g - b.g) * (a.g - b.g) + (a.b - b.b) * (a.b - b.b);
+}
+
+//Picks the closest of the four palette colors for every texel. Returns the total squared error.
+static float fitColorIndices(const Texel texels[16], uint16_t color0, uint16_t color1, uint32_t & indices) {
+    Texel palette[4] = {unpackColor565(color0), unpackColor565(color1)};
+    palette[2] = {(2 * palette[0].r + palette[1].r) / 3, (2 * palette[0].g + palette[1].g) / 3, (2 * palette[0].b + palette[1].b) / 3};
+    palette[3] = {(palette[0].r + 2 * palette[1].r) / 3, (palette[0].g + 2 * palette[1].g) / 3, (palette[0].b + 2 * palette[1].b) / 3};
+    indices = 0;
+    float error = 0.0f;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t best = 0;
+        float bestDistance = distanceSquared(texels[i], palette[0]);
+        for (uint32_t candidate = 1; candidate < 4; candidate++) {
+            float distance = distanceSquared(texels[i], palette[candidate]);
+            if (distance < bestDistance) {
+                best = candidate;
+                bestDistance = distance;
+            }
+        }
+        indices |= best << (2 * i);
+        error += bestDistance;
+    }
+    return error;
+}
+
+//Endpoints in the order that selects the four color mode, which BC3 assumes anyway
+static void orderEndpoints(uint16_t & color0, uint16_t & color1) {
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+}
+
+//BC1 color block: the endpoints start at the ends of the colors' principal axis, then get one least squares refit
+//to the indices they produced
+static void encodeColorBlock(const uint8_t rgba[16][4], uint8_t * output) {
+    Texel texels[16];
+    Texel mean = {0.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i < 16; i++) {
+        texels[i] = {static_cast<float>(rgba[i][0]), static_cast<float>(rgba[i][1]), static_cast<float>(rgba[i][2])};
+        mean.r += texels[i].r / 16;
+        mean.g += texels[i].g / 16;
+        mean.b += texels[i].b / 16;
+    }
+    float covariance[6] = {}; //rr, rg, rb, gg, gb, bb
+    for (const Texel & texel : texels) {
+        Texel d = {texel.r - mean.r, texel.g - mean.g, texel.b - mean.b};
+        covariance[0] += d.r * d.r;
+        covariance[1] += d.r * d.g;
+        covariance[2] += d.r * d.b;
+        covariance[3] += d.g * d.g;
+        covariance[4] += d.g * d.b;
+        covariance[5] += d.b * d.b;
+    }
+    //Power iteration for the principal axis
+    Texel axis = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        Texel next = {covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+                      covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+                      covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b};
+        float length = std::sqrt(next.r * next.r + next.g * next.g + next.b * next.b);
+        if (length < 1e-6f) {
+            break; //all texels are the same color
+        }
+        axis = {next.r / length, next.g / length, next.b / length};
+    }
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    for (const Texel & texel : texels) {
+        float projection = (texel.r - mean.r) * axis.r + (texel.g - mean.g) * axis.g + (texel.b - mean.b) * axis.b;
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    uint16_t color0 = packColor565({mean.r + axis.r * maxProjection, mean.g + axis.g * maxProjection, mean.b + axis.b * maxProjection});
+    uint16_t color1 = packColor565({mean.r + axis.r * minProjection, mean.g + axis.g * minProjection, mean.b + axis.b * minProjection});
+    orderEndpoints(color0, color1);
+    uint32_t indices = 0;
+    float error = color0 == color1 ? 0.0f : fitColorIndices(texels, color0, color1, indices);
+
+    if (color0 != color1) {
+        //How much of endpoint 0 each index mixes in
+        const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        Texel ax = {0.0f, 0.0f, 0.0f}, bx = {0.0f, 0.0f, 0.0f};
+        for (uint32_t i = 0; i < 16; i++) {
+            float a = weights[indices >> (2 * i) & 3];
+            float b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax = {ax.r + a * texels[i].r, ax.g + a * texels[i].g, ax.b + a * texels[i].b};
+            bx = {bx.r + b * texels[i].r, bx.g + b * texels[i].g, bx.b + b * texels[i].b};
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) > 1e-6f) {
+            Texel end0 = {(bb * ax.r - ab * bx.r) / determinant, (bb * ax.g - ab * bx.g) / determinant, (bb * ax.b - ab * bx.b) / determinant};
+            Texel end1 = {(aa * bx.r - ab * ax.r) / determinant, (aa * bx.g - ab * ax.g) / determinant, (aa * bx.b - ab * ax.b) / determinant};
+            uint16_t refit0 = packColor565(end0);
+            uint16_t refit1 = packColor565(end1);
+            orderEndpoints(refit0, refit1);
+            uint32_t refitIndices;
+            if (refit0 != refit1 && fitColorIndices(texels, refit0, refit1, refitIndices) < error) {
+                color0 = refit0;
+                color1 = refit1;
+                indices = refitIndices;
+            }
+        }
+    }
+
+    memcpy(output, &color0, 2);
+    memcpy(output + 2, &color1, 2);
+    memcpy(output + 4, &indices, 4);
+}
+
+//BC4 block of one channel: the block's minimum and maximum with six values interpolated between them
+static void encodeChannelBlock(const uint8_t rgba[16][4], uint32_t channel, uint8_t * output) {
+    uint8_t minimum = 255, maximum = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        minimum = std::min(minimum, rgba[i][channel]);
+        maximum = std::max(maximum, rgba[i][channel]);
+    }
+    output[0] = maximum;
+    output[1] = minimum;
+    uint64_t indices = 0;
+    if (maximum != minimum) {
+        float palette[8] = {static_cast<float>(maximum), static_cast<float>(minimum)};
+        for (uint32_t i = 2; i < 8; i++) {
+            palette[i] = (static_cast<float>(8 - i) * maximum + static_cast<float>(i - 1) * minimum) / 7.0f;
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+            uint64_t best = 0;
+            for (uint32_t candidate = 1; candidate < 8; candidate++) {
+                if (std::abs(palette[candidate] - rgba[i][channel]) < std::abs(palette[best] - rgba[i][channel])) {
+                    best = candidate;
+                }
+            }
+            indices |= best << (3 * i);
+        }
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+        output[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+    }
+}
+
+static std::vector<uint8_t> compressLevel(const uint8_t * pixels, uint32_t width, uint32_t height, VkFormat format) {
+    uint32_t blockSize = getBlockSize(format);
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * blockSize);
+    uint8_t * output = blocks.data();
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            //Blocks over the edge of levels smaller than 4x4 repeat the last row or column
+            uint8_t rgba[16][4];
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+                uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+                memcpy(rgba[i], pixels + (static_cast<size_t>(y) * width + x) * 4, 4);
+            }
+            if (format == VK_FORMAT_BC5_UNORM_BLOCK) {
+                encodeChannelBlock(rgba, 0, output);
+                encodeChannelBlock(rgba, 1, output + 8);
+            }
+            else if (blockSize == 16) {
+                encodeChannelBlock(rgba, 3, output);
+                encodeColorBlock(rgba, output + 8);
+            }
+            else {
+                encodeColorBlock(rgba, output);
+            }
+            output += blockSize;
+        }
+    }
+    return blocks;
+}
+
+static void appendWord(std::vector<uint8_t> & data, uint32_t word) {
+    data.insert(data.end(), reinterpret_cast<const uint8_t *>(&word), reinterpret_cast<const uint8_t *>(&word) + 4);
+}
+
+//The basic data format descriptor block, which KTX2 requires even though the engine goes by vkFormat
+static std::vector<uint8_t> buildDataFormatDescriptor(VkFormat format, bool srgb) {
+    struct Sample {
+        uint32_t channel;
+        uint32_t bitOffset;
+    };
+    uint32_t model = KHR_DF_MODEL_BC1A;
+    std::vector<Sample> samples = {{KHR_DF_CHANNEL_COLOR, 0}};
+    if (format == VK_FORMAT_BC3_UNORM_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK) {
+        model = KHR_DF_MODEL_BC3;
+        samples = {{KHR_DF_CHANNEL_ALPHA, 0}, {KHR_DF_CHANNEL_COLOR, 64}};
+    }
+    else if (format == VK_FORMAT_BC5_UNORM_BLOCK) {
+        model = KHR_DF_MODEL_BC5;
+        samples = {{KHR_DF_CHANNEL_COLOR, 0}, {KHR_DF_CHANNEL_GREEN, 64}};
+    }
+    uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+    std::vector<uint8_t> descriptor;
+    appendWord(descriptor, 4 + blockSize); //total size
+    appendWord(descriptor, 0); //Khronos vendor, basic descriptor type
+    appendWord(descriptor, 2 | blockSize << 16); //version 1.3
+    appendWord(descriptor, model | KHR_DF_PRIMARIES_BT709 << 8 | (srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16);
+    appendWord(descriptor, 3 | 3 << 8); //4x4 texel blocks, stored as size - 1
+    appendWord(descriptor, getBlockSize(format)); //bytes in plane 0
+    appendWord(descriptor, 0);
+    for (const Sample & sample : samples) {
+        //Alpha is never sRGB encoded
+        uint32_t channelType = sample.channel | (srgb && sample.channel == KHR_DF_CHANNEL_ALPHA ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0);
+        appendWord(descriptor, sample.bitOffset | 63 << 16 | channelType << 24);
+        appendWord(descriptor, 0); //sample position
+        appendWord(descriptor, 0); //lower
+        appendWord(descriptor, 0xFFFFFFFF); //upper
+    }
+    return descriptor;
+}
+
+static bool writeKtx2(const std::string & filename, VkFormat format, bool srgb, uint32_t width, uint32_t height,
+                      const std::vector<std::vector<uint8_t>> & levels) {
+    std::vector<uint8_t> descriptor = buildDataFormatDescriptor(format, srgb);
+    std::vector<uint8_t> keyValues;
+    const char writer[] = "KTXwriter\0vkeng compress_textures";
+    appendWord(keyValues, sizeof(writer));
+    keyValues.insert(keyValues.end(), writer, writer + sizeof(writer));
+    keyValues.resize((keyValues.size() + 3) / 4 * 4);
+
+    Ktx2Header header = {};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = format;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+
+    Ktx2Index index = {};
+    index.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + sizeof(Ktx2Index) + levels.size() * sizeof(Ktx2LevelIndex));
+    index.dfdByteLength = static_cast<uint32_t>(descriptor.size());
+    index.kvdByteOffset = index.dfdByteOffset + index.dfdByteLength;
+    index.kvdByteLength = static_cast<uint32_t>(keyValues.size());
+
+    //The level data is stored smallest first, each level aligned to a block
+    uint64_t blockSize = getBlockSize(format);
+    uint64_t offset = index.kvdByteOffset + index.kvdByteLength;
+    std::vector<Ktx2LevelIndex> levelIndex(levels.size());
+    for (size_t level = levels.size(); level-- > 0;) {
+        offset = (offset + blockSize - 1) / blockSize * blockSize;
+        levelIndex[level] = {offset, levels[level].size(), levels[level].size()};
+        offset += levels[level].size();
+    }
+
+    std::vector<uint8_t> file(offset);
+    memcpy(file.data(), &header, sizeof(header));
+    memcpy(file.data() + sizeof(header), &index, sizeof(index));
+    memcpy(file.data() + sizeof(header) + sizeof(index), levelIndex.data(), levelIndex.size() * sizeof(Ktx2LevelIndex));
+    memcpy(file.data() + index.dfdByteOffset, descriptor.data(), descriptor.size());
+    memcpy(file.data() + index.kvdByteOffset, keyValues.data(), keyValues.size());
+    for (size_t level = 0; level < levels.size(); level++) {
+        memcpy(file.data() + levelIndex[level].byteOffset, levels[level].data(), levels[level].size());
+    }
+
+    std::ofstream output(filename, std::ios::binary);
+    output.write(reinterpret_cast<const char *>(file.data()), static_cast<std::streamsize>(file.size()));
+    return static_cast<bool>(output);
+}
+
+int main(int argc, char ** argv) {
+    bool linear = false;
+    bool normalMap = false;
+    int first = 1;
+    for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+        if (strcmp(argv[first], "--linear") == 0) {
+            linear = true;
+        }
+        else if (strcmp(argv[first], "--normal-map") == 0) {
+            normalMap = true;
+        }
+        else {
+            first = argc;
+        }
+    }
+    if (argc - first != 2) {
+        std::cout << "Usage: " << argv[0] << " [--linear] [--normal-map] <input image> <output.ktx2>" << std::endl;
+        return 1;
+    }
+
+    int width, height, channels;
+    unsigned char * pixels = stbi_load(argv[first], &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        std::cout << "Failed to load " << argv[first] << std::endl;
+        return 1;
+    }
+    bool srgb = !linear && !normalMap;
+    bool opaque = true;
+    for (size_t i = 3; i < static_cast<size_t>(width) * height * 4; i += 4) {
+        opaque = opaque && pixels[i] == 255;
+    }
+    VkFormat format = VK_FORMAT_BC5_UNORM_BLOCK;
+    if (!normalMap) {
+        format = opaque ? (srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+                        : (srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK);
+    }
+
+    uint32_t levelCount = getMipLevelCount(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    std::vector<unsigned char> mips = buildMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1, levelCount, srgb);
+    std::vector<std::vector<uint8_t>> levels;
+    size_t mipOffset = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        uint32_t levelWidth = std::max(static_cast<uint32_t>(width) >> level, 1u);
+        uint32_t levelHeight = std::max(static_cast<uint32_t>(height) >> level, 1u);
+        const unsigned char * levelPixels = level == 0 ? pixels : mips.data() + mipOffset;
+        levels.push_back(compressLevel(levelPixels, levelWidth, levelHeight, format));
+        if (level > 0) {
+            mipOffset += getMipLevelSize(static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1, level);
+        }
+    }
+    stbi_image_free(pixels);
+
+    if (!writeKtx2(argv[first + 1], format, srgb, static_cast<uint32_t>(width), static_cast<uint32_t>(height), levels)) {
+        std::cout << "Failed to write " << argv[first + 1] << std::endl;
+        return 1;
+    }
+    size_t compressedSize = 0;
+    for (const auto & level : levels) {
+        compressedSize += level.size();
+    }
+    std::cout << "Compressed " << argv[first] << " (" << width << "x" << height << ", " << levelCount << " levels) to "
+              << compressedSize << " bytes" << std::endl;
+    return 0;
+}
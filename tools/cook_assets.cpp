@@ -0,0 +1,139 @@
+//Cooks meshes, compressed textures and the shader archive into one asset pack, see src/asset_pack.h for the format.
+//Usage: cook_assets <output> [--obj <file>] [--heightmap <file>] [--texture <source> <ktx2>] [--shaders <archive>] ...
+//Meshes are loaded and optimized the way the engine would load their sources and stored as mesh caches (see
+//src/mesh_cache.h), ready-made vertex and index blobs.
+//Entries are named by the path given, so it should be run from the directory the engine loads assets relative to.
+
+#include "asset_pack.h"
+#include "mesh_cache.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+struct InputAsset {
+    std::string path; //pack path
+    AssetType type;
+    std::vector<uint8_t> data;
+};
+
+static bool readFile(const std::string & filename, std::vector<uint8_t> & data) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+static std::vector<uint8_t> buildPack(std::vector<InputAsset> & assets) {
+    //Sorted so the engine can binary search the entries
+    std::sort(assets.begin(), assets.end(), [](const InputAsset & a, const InputAsset & b) {
+        return strcmp(a.path.c_str(), b.path.c_str()) < 0;
+    });
+
+    AssetPackHeader header = {};
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(assets.size());
+
+    auto align = [](uint64_t offset) {
+        return (offset + ASSET_PACK_ALIGNMENT - 1) & ~(ASSET_PACK_ALIGNMENT - 1);
+    };
+    std::vector<AssetPackEntry> entries(assets.size());
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(AssetPackEntry);
+    for (size_t i = 0; i < assets.size(); i++) {
+        memset(&entries[i], 0, sizeof(entries[i]));
+        memcpy(entries[i].path, assets[i].path.c_str(), assets[i].path.size());
+        entries[i].type = assets[i].type;
+        entries[i].offset = align(offset);
+        entries[i].size = assets[i].data.size();
+        offset = entries[i].offset + entries[i].size;
+    }
+
+    std::vector<uint8_t> pack(static_cast<size_t>(offset));
+    memcpy(pack.data(), &header, sizeof(header));
+    memcpy(pack.data() + sizeof(header), entries.data(), entries.size() * sizeof(AssetPackEntry));
+    for (size_t i = 0; i < assets.size(); i++) {
+        memcpy(pack.data() + entries[i].offset, assets[i].data.data(), assets[i].data.size());
+    }
+    return pack;
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <output> [--obj <file>] [--heightmap <file>] [--texture <source> <ktx2>] [--shaders <archive>] ..." << std::endl;
+        return 1;
+    }
+    std::string output = argv[1];
+
+    std::vector<InputAsset> assets;
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        InputAsset asset;
+        if ((strcmp(argv[i], "--obj") == 0 || strcmp(argv[i], "--heightmap") == 0) && hasValue) {
+            bool obj = strcmp(argv[i], "--obj") == 0;
+            asset.path = argv[++i];
+            asset.type = AssetType::Mesh;
+            Mesh mesh;
+            if (!(obj ? mesh.loadFromObj(asset.path.c_str()) : mesh.loadFromHeightmap(asset.path.c_str()))) {
+                std::cout << "Failed to load mesh " << asset.path << std::endl;
+                return 1;
+            }
+            mesh.optimize(asset.path.c_str());
+            std::vector<uint8_t> source;
+            if (!readFile(asset.path, source)) {
+                std::cout << "Failed to read " << asset.path << std::endl;
+                return 1;
+            }
+            asset.data = buildMeshCache(mesh, hashMeshSource(source.data(), source.size()), MESH_CACHE_OPTIMIZED);
+        }
+        else if (strcmp(argv[i], "--texture") == 0 && i + 2 < argc) {
+            asset.path = argv[++i];
+            asset.type = AssetType::Texture;
+            if (!readFile(argv[++i], asset.data)) {
+                std::cout << "Failed to read " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--shaders") == 0 && hasValue) {
+            //The engine looks for the archive by its file name, like it would next to the executable
+            asset.path = std::filesystem::path(argv[++i]).filename().generic_string();
+            asset.type = AssetType::ShaderArchive;
+            if (!readFile(argv[i], asset.data)) {
+                std::cout << "Failed to read " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else {
+            std::cout << "Unknown or incomplete option " << argv[i] << std::endl;
+            return 1;
+        }
+        if (asset.path.empty() || asset.path.size() >= ASSET_PACK_MAX_PATH) {
+            std::cout << asset.path << " is too long for an asset pack path." << std::endl;
+            return 1;
+        }
+        for (const auto & other : assets) {
+            if (other.path == asset.path) {
+                std::cout << asset.path << " is in the pack twice." << std::endl;
+                return 1;
+            }
+        }
+        assets.push_back(std::move(asset));
+    }
+
+    std::vector<uint8_t> pack = buildPack(assets);
+    std::ofstream file(output, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(pack.data()), static_cast<std::streamsize>(pack.size()));
+    if (!file) {
+        std::cout << "Failed to write " << output << std::endl;
+        return 1;
+    }
+    std::cout << "Cooked " << assets.size() << " assets (" << pack.size() << " bytes) into " << output << std::endl;
+    return 0;
+}
@@ -0,0 +1,125 @@
+//Packs compiled SPIR-V into one archive for ShaderArchive, see src/shader_archive.h for the format.
+//Usage: pack_shaders [--cpp] <output> <base directory> <spv files...>
+//Entries are named by their path relative to the base directory. With --cpp the archive is written as a C++ source
+//defining g_embeddedShaderArchive instead, to be compiled into the executable.
+
+#include "shader_archive.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+struct InputShader {
+    std::string path; //archive path
+    std::vector<uint8_t> code;
+};
+
+static bool readFile(const std::string & filename, std::vector<uint8_t> & data) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+static std::vector<uint8_t> buildArchive(std::vector<InputShader> & shaders) {
+    //Sorted so the engine can binary search the entries
+    std::sort(shaders.begin(), shaders.end(), [](const InputShader & a, const InputShader & b) {
+        return strcmp(a.path.c_str(), b.path.c_str()) < 0;
+    });
+
+    ShaderArchiveHeader header = {};
+    header.magic = SHADER_ARCHIVE_MAGIC;
+    header.version = SHADER_ARCHIVE_VERSION;
+    header.entryCount = static_cast<uint32_t>(shaders.size());
+
+    std::vector<ShaderArchiveEntry> entries(shaders.size());
+    size_t offset = sizeof(header) + entries.size() * sizeof(ShaderArchiveEntry);
+    for (size_t i = 0; i < shaders.size(); i++) {
+        memset(&entries[i], 0, sizeof(entries[i]));
+        memcpy(entries[i].path, shaders[i].path.c_str(), shaders[i].path.size());
+        entries[i].offset = static_cast<uint32_t>(offset);
+        entries[i].size = static_cast<uint32_t>(shaders[i].code.size());
+        offset += shaders[i].code.size();
+    }
+
+    std::vector<uint8_t> archive(offset);
+    memcpy(archive.data(), &header, sizeof(header));
+    memcpy(archive.data() + sizeof(header), entries.data(), entries.size() * sizeof(ShaderArchiveEntry));
+    for (size_t i = 0; i < shaders.size(); i++) {
+        memcpy(archive.data() + entries[i].offset, shaders[i].code.data(), shaders[i].code.size());
+    }
+    return archive;
+}
+
+//As 32-bit words, so the array is aligned for reading the SPIR-V in place
+static bool writeCpp(const std::string & filename, const std::vector<uint8_t> & archive) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "//Generated by pack_shaders from the compiled shaders, don't edit\n"
+         << "#include <cstdint>\n#include <cstddef>\n\n"
+         << "extern const uint32_t g_embeddedShaderArchive[];\n"
+         << "extern const size_t g_embeddedShaderArchiveSize;\n\n"
+         << "const uint32_t g_embeddedShaderArchive[] = {";
+    for (size_t i = 0; i < archive.size(); i += 4) {
+        uint32_t word;
+        memcpy(&word, archive.data() + i, sizeof(word));
+        file << (i % 32 == 0 ? "\n    " : " ") << "0x" << std::hex << word << std::dec << ",";
+    }
+    file << "\n};\nconst size_t g_embeddedShaderArchiveSize = " << archive.size() << ";\n";
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char ** argv) {
+    int first = 1;
+    bool cpp = argc > 1 && strcmp(argv[1], "--cpp") == 0;
+    if (cpp) {
+        first++;
+    }
+    if (argc - first < 2) {
+        std::cout << "Usage: " << argv[0] << " [--cpp] <output> <base directory> <spv files...>" << std::endl;
+        return 1;
+    }
+    std::string output = argv[first];
+    std::filesystem::path base = argv[first + 1];
+
+    std::vector<InputShader> shaders;
+    for (int i = first + 2; i < argc; i++) {
+        InputShader shader;
+        shader.path = std::filesystem::path(argv[i]).lexically_relative(base).generic_string();
+        if (!readFile(argv[i], shader.code)) {
+            std::cout << "Failed to read " << argv[i] << std::endl;
+            return 1;
+        }
+        if (shader.path.empty() || shader.path.size() >= SHADER_ARCHIVE_MAX_PATH || shader.code.size() % 4 != 0) {
+            std::cout << argv[i] << " has a path that's too long or isn't SPIR-V." << std::endl;
+            return 1;
+        }
+        shaders.push_back(std::move(shader));
+    }
+
+    std::vector<uint8_t> archive = buildArchive(shaders);
+    bool written = false;
+    if (cpp) {
+        written = writeCpp(output, archive);
+    }
+    else {
+        std::ofstream file(output, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(archive.data()), static_cast<std::streamsize>(archive.size()));
+        written = static_cast<bool>(file);
+    }
+    if (!written) {
+        std::cout << "Failed to write " << output << std::endl;
+        return 1;
+    }
+    std::cout << "Packed " << shaders.size() << " shaders (" << archive.size() << " bytes) into " << output << std::endl;
+    return 0;
+}